@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,22 +8,68 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <pthread.h>
+#include "IPC.h"
+#include "IPC_transport.h"
 
-#define MAX_PROCESSES 64
-#define SOCKET_DIR "/tmp/distributed_cache_sockets"
+//The state below is per thread: a process is a single node, but with IPC_TRANSPORT=thread every node is a thread of
+//the manager and keeps its own queues and counters. Only the peer addresses are shared, they are the same for everyone
+static __thread int sender_sockets[MAX_PROCESSES + 1];
+static __thread int sender_sockets_initialized = 0;
+static struct sockaddr_un peer_addrs[MAX_PROCESSES + 1];
+static __thread int batch_socket = -1;
+static __thread int own_fd = -1;
 
-static int sender_sockets[MAX_PROCESSES];
-static int sender_sockets_initialized = 0;
+static __thread int epoll_fd = -1;
 
-static void init_sender_sockets(){
+//Selected with the IPC_TRANSPORT environment variable, children inherit it from the manager
+static __thread const IPCTransport *transport = &unix_transport;
+static const IPCTransport *transports[] = {&unix_transport, &shm_transport, &tcp_transport, &uring_transport, &thread_transport};
+
+__thread uint64_t ipc_num_syscalls = 0;
+static __thread uint64_t num_frames_sent = 0;
+static __thread uint64_t num_frames_received = 0;
+
+static void select_transport(){
+    const char *name = getenv("IPC_TRANSPORT");
+    transport = &unix_transport;
+    if(name == NULL){
+        return;
+    }
+    for(size_t i = 0; i < sizeof(transports) / sizeof(transports[0]); i++){
+        if(strcmp(name, transports[i]->name) == 0){
+            transport = transports[i];
+            return;
+        }
+    }
+    fprintf(stderr, "[ERROR HAPPENED] : Unknown IPC_TRANSPORT %s, using unix sockets\n", name);
+}
+
+static void fill_peer_addr(int receiver_id, struct sockaddr_un *addr);
+static void init_flow_control(int process_id);
+
+//The node threads never use the socket, so they leave the shared peer addresses alone
+static void init_sender_sockets(int fill_addrs){
     if(sender_sockets_initialized == 0){
-        for(int i = 0; i < MAX_PROCESSES; i++){
+        for(int i = 0; i <= MAX_PROCESSES; i++){
             sender_sockets[i] = -1;
+            if(fill_addrs){
+                fill_peer_addr(i, &peer_addrs[i]);
+            }
         }
         sender_sockets_initialized = 1;
     }
 }
 
+//1 with IPC_TRANSPORT=thread: the manager runs the nodes and the load generator clients as threads, not processes
+int ipc_in_process(){
+    const char *name = getenv("IPC_TRANSPORT");
+    return name != NULL && strcmp(name, thread_transport.name) == 0;
+}
+
 static void make_nonblocking(int fd){
     int flags = fcntl(fd, F_GETFL, 0);
 
@@ -40,7 +87,18 @@ int initiate_communication(int process_id){
     struct sockaddr_un addr;
     int fd;
 
-    init_sender_sockets();
+    select_transport();
+    init_sender_sockets(transport != &thread_transport);
+    init_flow_control(process_id);
+
+    //No socket at all, the mailbox takes everything; the id stands in for the descriptor the callers hold on to
+    if(transport == &thread_transport){
+        own_fd = -1;
+        if(transport->init(process_id, -1) < 0){
+            exit(EXIT_FAILURE);
+        }
+        return process_id;
+    }
 
     if(mkdir(SOCKET_DIR, 0777) < 0 && errno != EEXIST){
         perror("[ERROR HAPPENED!] : Error happened when making the directory for sockets\n");
@@ -72,57 +130,699 @@ int initiate_communication(int process_id){
     }
 
     make_nonblocking(fd);
+    own_fd = fd;
+
+    //The socket stays open with the other backends as well, for descriptors and receivers they can't reach
+    if(transport != &unix_transport && transport->init(process_id, fd) < 0){
+        fprintf(stderr, "[ERROR HAPPENED] : Process %d falls back to unix sockets\n", process_id);
+        transport = &unix_transport;
+    }
 
     //printf("[SUCCESS] : Process %d initialized on %s\n", process_id, sock_path);
     return fd;
 }
 
+//For the child of a fork that goes on under a new id: drops the queues and sockets it inherited without unlinking
+//the parent's socket files (close_communication would), then binds its own like initiate_communication
+//The transports set up fresh state in init, the descriptors of the parent's ring or listen socket stay open until exit
+int reinitiate_communication(int process_id, int inherited_fd){
+    cleanup_ipc();
+    if(epoll_fd >= 0){
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+    if(inherited_fd >= 0){
+        close(inherited_fd);
+    }
+    return initiate_communication(process_id);
+}
+
+
+//Flow control: every sender starts with IPC_CREDIT_WINDOW credits per receiver and spends one per message
+//The receiver gives credits back with a MSG_CREDIT frame once it consumed IPC_CREDIT_RETURN messages of a sender
+//Messages that can't go out yet (no credits, full socket/ring, receiver not up) wait in a per-receiver queue instead of being dropped
+typedef struct IPCQueued{
+    struct IPCQueued *next;
+    int sender_id;
+    int fd;
+    int carrier_sent;
+    size_t len;
+    char data[];
+} IPCQueued;
+
+typedef struct{
+    IPCQueued *head;
+    IPCQueued *tail;
+    int count;
+} IPCQueue;
+
+static __thread IPCQueue pending[MAX_PROCESSES + 1];
+static __thread int num_pending = 0;
+static __thread int send_credits[MAX_PROCESSES + 1];
+static __thread int consumed[MAX_PROCESSES + 1];
+static __thread int num_credits_owed = 0;
+static __thread int own_process_id = -1;
+//Peers whose answering MSG_RESET we wait for after ipc_rejoin, what they send before it was meant for the node we replace
+static __thread char awaiting_reset[MAX_PROCESSES + 1];
+//Peers we owe that answer: it bypasses the credits like MSG_CREDIT, and nothing else goes to them before it
+static __thread char reset_done_owed[MAX_PROCESSES + 1];
+static __thread int num_reset_done_owed = 0;
 
-int send_msg(int sender_id, int receiver_id, const char *msg){
-    (void) sender_id;
-    size_t msg_len = strlen(msg) + 1;
+//Messages that ipc_flush received while it waited for credits, receive_msg hands them out first
+static __thread IPCQueue stash;
+
+//Descriptors that arrived in MSG_FD_CARRIER datagrams and wait for their frame from the ring
+typedef struct{
+    int sender;
+    int32_t token;
     int fd;
+} CarriedFd;
+
+static __thread CarriedFd carried_fds[IPC_MAX_CARRIED_FDS];
+static __thread int num_carried_fds = 0;
+static __thread int32_t next_fd_token = 0;
+
+//Messages larger than a frame go out as MSG_FRAGMENT frames, each payload starts with a FragmentInfo
+//Frames from one sender arrive in order, so every sender has at most one message being reassembled
+typedef struct{
+    uint32_t total_len;         //length of the whole frame (header included)
+    uint32_t num_fragments;
+} FragmentInfo;
+
+#define IPC_FRAGMENT_DATA (IPC_MAX_MSG_SIZE - MSG_HEADER_SIZE - sizeof(FragmentInfo))
+
+typedef struct{
+    char *frame;                //allocated for total_len once the first fragment arrived
+    uint32_t id;
+    uint32_t total_len;
+    uint32_t num_fragments;
+    uint32_t next_seq;
+    size_t filled;
+} Reassembly;
+
+//Reassembled messages, the frame handed to the caller only carries the token (see dispatch_msg)
+typedef struct{
+    int32_t token;
+    char *frame;
+    size_t len;
+} Reassembled;
+
+static __thread Reassembly reassembly[MAX_PROCESSES + 1];
+static __thread Reassembled reassembled[IPC_MAX_REASSEMBLED];
+static __thread int num_reassembled = 0;
+static __thread int32_t next_reassembled_token = 0;
+static __thread uint32_t next_fragmented_id = 0;
+
+static void init_flow_control(int process_id){
+    own_process_id = process_id;
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        pending[i].head = pending[i].tail = NULL;
+        pending[i].count = 0;
+        send_credits[i] = IPC_CREDIT_WINDOW;
+        consumed[i] = 0;
+        awaiting_reset[i] = 0;
+        reset_done_owed[i] = 0;
+    }
+    num_reset_done_owed = 0;
+    stash.head = stash.tail = NULL;
+    stash.count = 0;
+    num_pending = 0;
+    num_credits_owed = 0;
+}
+
+//A queued message with a descriptor keeps its own duplicate of it, the caller may close the original
+static int queue_push(IPCQueue *q, int sender_id, const void *msg, size_t len, int fd, int carrier_sent){
+    IPCQueued *item = malloc(sizeof(IPCQueued) + len + 1);
+    if(item == NULL){
+        fprintf(stderr, "[ERROR HAPPENED] : Could not queue a message of %zu bytes\n", len);
+        return -1;
+    }
+    item->fd = -1;
+    if(fd >= 0 && (item->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0)) < 0){
+        perror("[ERROR HAPPENED] : Could not keep the descriptor of a queued message");
+        free(item);
+        return -1;
+    }
+    item->carrier_sent = carrier_sent;
+    item->next = NULL;
+    item->sender_id = sender_id;
+    item->len = len;
+    memcpy(item->data, msg, len);
+    item->data[len] = '\0';
+    if(q->tail != NULL){
+        q->tail->next = item;
+    } else{
+        q->head = item;
+    }
+    q->tail = item;
+    q->count++;
+    return 0;
+}
+
+static void queue_pop(IPCQueue *q){
+    IPCQueued *item = q->head;
+    q->head = item->next;
+    if(q->head == NULL){
+        q->tail = NULL;
+    }
+    q->count--;
+    if(item->fd >= 0){
+        close(item->fd);
+    }
+    free(item);
+}
+
+static void queue_clear(IPCQueue *q){
+    while(q->head != NULL){
+        queue_pop(q);
+    }
+}
+
+static void fill_peer_addr(int receiver_id, struct sockaddr_un *addr){
     char sock_path[108];
-    struct sockaddr_un addr;
-    ssize_t n;
+    snprintf(sock_path, sizeof(sock_path), "%s/proc_%d.sock", SOCKET_DIR, receiver_id);
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strncpy(addr->sun_path, sock_path, sizeof(addr->sun_path) - 1);
+}
 
-    if(msg_len > 65000){
-        fprintf(stderr, "[ERROR HAPPENED] : Message size is too large\n");
+//One datagram socket per peer, connected once so the kernel doesn't resolve the path on every send
+//Returns -1 while the peer hasn't bound its socket yet
+static int get_sender_socket(int receiver_id){
+    if(sender_sockets[receiver_id] >= 0){
+        return sender_sockets[receiver_id];
+    }
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+        perror("[ERROR HAPPENED] : Tried to initialize socket when sending a message, but failed\n");
+        return -1;
+    }
+    if(connect(fd, (struct sockaddr*)&peer_addrs[receiver_id], sizeof(peer_addrs[receiver_id])) < 0){
+        if(errno != ENOENT && errno != ECONNREFUSED){
+            perror("[ERROR HAPPENED] : Could not connect to the peer socket");
+        }
+        close(fd);
         return -1;
     }
+    sender_sockets[receiver_id] = fd;
+    return fd;
+}
 
-    if(sender_sockets[receiver_id] < 0){
-        if((fd = socket(AF_UNIX, SOCK_DGRAM, 0)) < 0){
-            perror("[ERROR HAPPENED] : Tried to initialize socket when sending a message, but failed\n");
-            return -1;
+//sendmsg with the descriptor attached as SCM_RIGHTS ancillary data (fd < 0 sends a plain datagram)
+static ssize_t send_with_fd(int sock, const void *msg, size_t msg_len, int fd){
+    ipc_num_syscalls++;
+    if(fd < 0){
+        return send(sock, msg, msg_len, 0);
+    }
+    union{
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    struct iovec iov = {(void *)msg, msg_len};
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    memset(&ctrl, 0, sizeof(ctrl));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = ctrl.buf;
+    mh.msg_controllen = sizeof(ctrl.buf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return sendmsg(sock, &mh, 0);
+}
+
+//Unix backend: one datagram over the connected socket of the receiver
+static int unix_send(int sender_id, int receiver_id, const void *msg, size_t msg_len, int fd){
+    int sock;
+    if((sock = get_sender_socket(receiver_id)) < 0){
+        return IPC_SEND_RETRY;
+    }
+    if(send_with_fd(sock, msg, msg_len, fd) >= 0){
+        return IPC_SEND_OK;
+    }
+    if(errno == EAGAIN || errno == EWOULDBLOCK){
+        return IPC_SEND_RETRY;
+    }
+    if(errno == ECONNREFUSED || errno == ENOTCONN){
+        //The peer went away, connect again on the next attempt
+        close(sock);
+        sender_sockets[receiver_id] = -1;
+        return IPC_SEND_RETRY;
+    }
+    perror("[ERROR HAPPENED] : Sending the message failed");
+    return IPC_SEND_ERROR;
+}
+
+//Returns IPC_SEND_OK when the message left, IPC_SEND_RETRY when the receiver can't take it right now and IPC_SEND_ERROR when it has to be dropped
+//A backend that can't pass descriptors still gets the frame (so it keeps its order), the descriptor goes ahead of it
+//in a MSG_FD_CARRIER datagram on the socket, tagged with the token of the frame
+static int transmit(int sender_id, int receiver_id, const void *msg, size_t msg_len, int fd, int *carrier_sent){
+    if(fd >= 0 && !transport->passes_fds && !*carrier_sent){
+        char carrier[MSG_HEADER_SIZE] __attribute__((aligned(8)));
+        int32_t token;
+        memcpy(&token, (const char *)msg + MSG_HEADER_SIZE, sizeof(token));
+        size_t carrier_len = encode_msg(carrier, sizeof(carrier), MSG_FD_CARRIER, sender_id, 0, token, NULL, 0);
+        int ret = unix_send(sender_id, receiver_id, carrier, carrier_len, fd);
+        if(ret != IPC_SEND_OK){
+            return ret;
         }
-        sender_sockets[receiver_id] = fd;
-    } else{
-        fd = sender_sockets[receiver_id];
+        *carrier_sent = 1;
     }
 
-    snprintf(sock_path, sizeof(sock_path), "%s/proc_%d.sock", SOCKET_DIR, receiver_id);
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, sock_path, sizeof(addr.sun_path) - 1);
-    n = sendto(fd, msg, msg_len, 0, (struct sockaddr*)&addr, sizeof(addr));
-    if(n < 0){
-        if(errno == ENOENT){
-            return -1;
+    //If the carrier already went out the receiver finds the descriptor by the token
+    int frame_fd = (fd >= 0 && !*carrier_sent) ? fd : -1;
+    int ret = transport->send(sender_id, receiver_id, msg, msg_len, frame_fd);
+    if(ret == IPC_SEND_UNAVAILABLE){
+        ret = unix_send(sender_id, receiver_id, msg, msg_len, frame_fd);
+    }
+    return ret;
+}
+
+//Returns 1 once the MSG_RESET answer we owe peer_id (if any) went out, the frames behind it wait until then
+static int send_reset_done(int peer_id){
+    char frame[MSG_HEADER_SIZE] __attribute__((aligned(8)));
+    int carrier_sent = 0;
+    if(!reset_done_owed[peer_id]){
+        return 1;
+    }
+    size_t len = encode_msg(frame, sizeof(frame), MSG_RESET, own_process_id, 0, IPC_RESET_DONE, NULL, 0);
+    if(transmit(own_process_id, peer_id, frame, len, -1, &carrier_sent) == IPC_SEND_RETRY){
+        return 0;
+    }
+    reset_done_owed[peer_id] = 0;
+    num_reset_done_owed--;
+    return 1;
+}
+
+//Credit frames bypass the credit check, otherwise two peers waiting for each other's credits would deadlock
+static void return_credits(int peer_id){
+    char frame[MSG_HEADER_SIZE] __attribute__((aligned(8)));
+    int carrier_sent = 0;
+    if(!send_reset_done(peer_id)){
+        return;
+    }
+    size_t len = encode_msg(frame, sizeof(frame), MSG_CREDIT, own_process_id, 0, consumed[peer_id], NULL, 0);
+    if(transmit(own_process_id, peer_id, frame, len, -1, &carrier_sent) != IPC_SEND_RETRY){
+        num_credits_owed -= consumed[peer_id] >= IPC_CREDIT_RETURN;
+        consumed[peer_id] = 0;
+    }
+}
+
+//A node that leaves gives back the credits of the frames it consumed since its last MSG_CREDIT, so the peers' windows
+//toward its id are whole again; frames that reach it after this are only made up for by the next node's ipc_rejoin
+static void return_all_credits(){
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        if(consumed[i] > 0 && i != own_process_id){
+            return_credits(i);
         }
-        if(errno == EAGAIN || errno == EWOULDBLOCK){
-            fprintf(stderr, "[ERROR HAPPENED] : Send buffer is full, receiver %d is slow\n", receiver_id);
+    }
+}
+
+static void flush_peer(int receiver_id){
+    IPCQueue *q = &pending[receiver_id];
+    if(!send_reset_done(receiver_id)){
+        return;
+    }
+    while(q->head != NULL && send_credits[receiver_id] > 0){
+        int ret = transmit(q->head->sender_id, receiver_id, q->head->data, q->head->len, q->head->fd, &q->head->carrier_sent);
+        if(ret == IPC_SEND_RETRY){
+            break;
+        }
+        if(ret == IPC_SEND_OK){
+            send_credits[receiver_id]--;
+            num_frames_sent++;
+        }
+        queue_pop(q);
+        num_pending--;
+    }
+}
+
+static void flush_all(){
+    for(int i = 0; i <= MAX_PROCESSES && num_reset_done_owed > 0; i++){
+        send_reset_done(i);
+    }
+    for(int i = 0; i <= MAX_PROCESSES && num_credits_owed > 0; i++){
+        if(consumed[i] >= IPC_CREDIT_RETURN){
+            return_credits(i);
+        }
+    }
+    for(int i = 0; i <= MAX_PROCESSES && num_pending > 0; i++){
+        if(pending[i].head != NULL){
+            flush_peer(i);
+        }
+    }
+}
+
+static int receive_socket(int fd, char *buf, size_t buf_size, int *received_fd);
+static int accept_msg(char *buf, int len, int received_fd);
+static int send_msg_fd(int sender_id, int receiver_id, const void *msg, size_t msg_len, int fd);
+
+//First descriptor of an SCM_RIGHTS message, any extra ones are closed
+static int cmsg_fd(struct msghdr *mh){
+    int fd = -1;
+    for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(mh); cmsg != NULL; cmsg = CMSG_NXTHDR(mh, cmsg)){
+        if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS){
+            continue;
+        }
+        int n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for(int i = 0; i < n; i++){
+            int received;
+            memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if(fd < 0){
+                fd = received;
+            } else{
+                close(received);
+            }
+        }
+    }
+    return fd;
+}
+
+//Descriptor of the MSG_FD_CARRIER with this token; the carrier was sent before the frame, so it is already queued on the socket
+static int take_carried_fd(int sender, int32_t token){
+    char drain_buf[IPC_MAX_MSG_SIZE + 1] __attribute__((aligned(8)));
+    while(1){
+        for(int i = 0; i < num_carried_fds; i++){
+            if(carried_fds[i].sender == sender && carried_fds[i].token == token){
+                int fd = carried_fds[i].fd;
+                carried_fds[i] = carried_fds[--num_carried_fds];
+                return fd;
+            }
+        }
+        int received_fd;
+        int n = receive_socket(own_fd, drain_buf, sizeof(drain_buf), &received_fd);
+        if(n <= 0){
+            fprintf(stderr, "[ERROR HAPPENED] : Descriptor %d of process %d never arrived\n", token, sender);
             return -1;
         }
-        perror("[ERROR HAPPENED] : Sending the message failed");
+        if(accept_msg(drain_buf, n, received_fd)){
+            queue_push(&stash, own_process_id, drain_buf, n, -1, 0);
+        }
+    }
+}
+
+//Splits a MSG_COALESCED frame into its frames and stashes them, the next receive calls hand them out one by one
+//Only the order-independent query frames are coalesced, so it doesn't matter if a later frame overtakes them
+static void unpack_batch(const char *buf, int len, const MsgHeader *hdr){
+    size_t end = MSG_HEADER_SIZE + hdr->payload_len;
+    size_t offset = MSG_HEADER_SIZE;
+    if(end > (size_t)len){
+        end = len;
+    }
+    while(offset + MSG_HEADER_SIZE <= end){
+        MsgHeader inner;
+        memcpy(&inner, buf + offset, MSG_HEADER_SIZE);
+        size_t inner_len = MSG_HEADER_SIZE + inner.payload_len;
+        if(inner_len > end - offset || inner.type == MSG_COALESCED || (inner.flags & MSG_FLAG_FD)){
+            fprintf(stderr, "[ERROR HAPPENED] : Malformed batch from process %d\n", hdr->sender);
+            return;
+        }
+        queue_push(&stash, hdr->sender, buf + offset, inner_len, -1, 0);
+        offset += MSG_COALESCED_ALIGN(inner_len);
+    }
+}
+
+static void drop_reassembly(int sender){
+    free(reassembly[sender].frame);
+    reassembly[sender].frame = NULL;
+}
+
+//Copies a fragment into the buffer of its message; once the last one arrived, buf is replaced by a frame with the
+//header of the message, MSG_FLAG_REASSEMBLED and the token of the reassembled message as payload
+//Returns 1 if buf now holds that frame
+static int reassemble(char *buf, int len, const MsgHeader *hdr){
+    Reassembly *r = &reassembly[hdr->sender];
+    FragmentInfo info;
+    if(hdr->payload_len < sizeof(info) || MSG_HEADER_SIZE + hdr->payload_len > (size_t)len){
+        fprintf(stderr, "[ERROR HAPPENED] : Malformed fragment from process %d\n", hdr->sender);
+        return 0;
+    }
+    memcpy(&info, buf + MSG_HEADER_SIZE, sizeof(info));
+    size_t data_len = hdr->payload_len - sizeof(info);
+
+    if(hdr->arg == 0){
+        if(r->frame != NULL){
+            fprintf(stderr, "[ERROR HAPPENED] : Message %u of process %d is incomplete, dropped\n", r->id, hdr->sender);
+            drop_reassembly(hdr->sender);
+        }
+        if(info.total_len < MSG_HEADER_SIZE || info.total_len > IPC_MAX_REASSEMBLED_SIZE
+           || info.num_fragments != (info.total_len + IPC_FRAGMENT_DATA - 1) / IPC_FRAGMENT_DATA){
+            fprintf(stderr, "[ERROR HAPPENED] : Invalid fragmented message of %u bytes from process %d\n", info.total_len, hdr->sender);
+            return 0;
+        }
+        //The whole message is allocated up front, the fragments are copied straight to their place
+        r->frame = malloc(info.total_len + 1);
+        if(r->frame == NULL){
+            fprintf(stderr, "[ERROR HAPPENED] : Could not allocate %u bytes to reassemble a message\n", info.total_len);
+            return 0;
+        }
+        r->id = hdr->request_id;
+        r->total_len = info.total_len;
+        r->num_fragments = info.num_fragments;
+        r->next_seq = 0;
+        r->filled = 0;
+    }
+    if(r->frame == NULL || r->id != hdr->request_id || (uint32_t)hdr->arg != r->next_seq || r->filled + data_len > r->total_len){
+        if(r->frame != NULL || hdr->arg != 0){
+            fprintf(stderr, "[ERROR HAPPENED] : Fragment %d of message %u from process %d is out of order\n", hdr->arg, hdr->request_id, hdr->sender);
+        }
+        if(r->frame != NULL){
+            drop_reassembly(hdr->sender);
+        }
+        return 0;
+    }
+    memcpy(r->frame + r->filled, buf + MSG_HEADER_SIZE + sizeof(info), data_len);
+    r->filled += data_len;
+    if(++r->next_seq < r->num_fragments){
+        return 0;
+    }
+
+    if(r->filled != r->total_len || num_reassembled == IPC_MAX_REASSEMBLED){
+        fprintf(stderr, "[ERROR HAPPENED] : Could not keep reassembled message %u of process %d\n", r->id, hdr->sender);
+        drop_reassembly(hdr->sender);
+        return 0;
+    }
+    r->frame[r->total_len] = '\0';
+    Reassembled *done = &reassembled[num_reassembled++];
+    done->token = next_reassembled_token++;
+    done->frame = r->frame;
+    done->len = r->total_len;
+    r->frame = NULL;
+
+    MsgHeader stub;
+    memcpy(&stub, done->frame, MSG_HEADER_SIZE);
+    stub.flags |= MSG_FLAG_REASSEMBLED;
+    stub.payload_len = sizeof(int32_t);
+    memcpy(buf, &stub, MSG_HEADER_SIZE);
+    memcpy(buf + MSG_HEADER_SIZE, &done->token, sizeof(int32_t));
+    return 1;
+}
+
+//Takes the reassembled message of the token out of the table, the caller frees it
+static char *take_reassembled(int32_t token, size_t *len){
+    for(int i = 0; i < num_reassembled; i++){
+        if(reassembled[i].token == token){
+            char *frame = reassembled[i].frame;
+            *len = reassembled[i].len;
+            reassembled[i] = reassembled[--num_reassembled];
+            return frame;
+        }
+    }
+    return NULL;
+}
+
+static void count_consumed(int sender){
+    num_frames_received++;
+    if(++consumed[sender] == IPC_CREDIT_RETURN){
+        num_credits_owed++;
+        return_credits(sender);
+    }
+}
+
+//A peer asked to start over (ipc_rejoin): what we still queued for the node that had its id before is dropped and
+//both windows start full again, however many credits the old node took along
+static void reset_peer(int peer_id){
+    while(pending[peer_id].head != NULL){
+        queue_pop(&pending[peer_id]);
+        num_pending--;
+    }
+    send_credits[peer_id] = IPC_CREDIT_WINDOW;
+    num_credits_owed -= consumed[peer_id] >= IPC_CREDIT_RETURN;
+    consumed[peer_id] = 0;
+    drop_reassembly(peer_id);
+    if(sender_sockets[peer_id] >= 0){
+        close(sender_sockets[peer_id]);
+        sender_sockets[peer_id] = -1;
+    }
+    if(transport->peer_replaced != NULL){
+        transport->peer_replaced(peer_id);
+    }
+}
+
+//Takes the flow control frames out of the stream and puts received descriptors into the frames they belong to
+//Returns 1 if the message is for the caller
+static int accept_msg(char *buf, int len, int received_fd){
+    MsgHeader hdr;
+    if(len < (int)MSG_HEADER_SIZE){
+        if(received_fd >= 0) close(received_fd);
+        return 1;
+    }
+    memcpy(&hdr, buf, MSG_HEADER_SIZE);
+    if(hdr.sender < 0 || hdr.sender > MAX_PROCESSES){
+        if(received_fd >= 0) close(received_fd);
+        return 1;
+    }
+    if(awaiting_reset[hdr.sender] && !(hdr.type == MSG_RESET && hdr.arg == IPC_RESET_DONE)){
+        if(received_fd >= 0) close(received_fd);
+        return 0;
+    }
+    //The request spent a credit like any frame, the answer none, like MSG_CREDIT
+    if(hdr.type == MSG_RESET){
+        if(received_fd >= 0) close(received_fd);
+        if(hdr.arg == IPC_RESET_REQUEST){
+            reset_peer(hdr.sender);
+            if(!reset_done_owed[hdr.sender]){
+                reset_done_owed[hdr.sender] = 1;
+                num_reset_done_owed++;
+            }
+            send_reset_done(hdr.sender);
+            count_consumed(hdr.sender);
+        } else{
+            awaiting_reset[hdr.sender] = 0;
+        }
+        return 0;
+    }
+    if(hdr.type == MSG_CREDIT){
+        send_credits[hdr.sender] += hdr.arg;
+        flush_peer(hdr.sender);
+        return 0;
+    }
+    if(hdr.type == MSG_FD_CARRIER){
+        if(received_fd >= 0 && num_carried_fds < IPC_MAX_CARRIED_FDS){
+            carried_fds[num_carried_fds].sender = hdr.sender;
+            carried_fds[num_carried_fds].token = hdr.arg;
+            carried_fds[num_carried_fds].fd = received_fd;
+            num_carried_fds++;
+        } else if(received_fd >= 0){
+            fprintf(stderr, "[ERROR HAPPENED] : Too many descriptors waiting for their frames\n");
+            close(received_fd);
+        }
+        return 0;
+    }
+    if((hdr.flags & MSG_FLAG_FD) && hdr.payload_len >= sizeof(int32_t) && MSG_HEADER_SIZE + sizeof(int32_t) <= (size_t)len){
+        int32_t fd = received_fd >= 0 ? received_fd : -1;
+        if(fd < 0){
+            int32_t token;
+            memcpy(&token, buf + MSG_HEADER_SIZE, sizeof(token));
+            fd = take_carried_fd(hdr.sender, token);
+        }
+        memcpy(buf + MSG_HEADER_SIZE, &fd, sizeof(fd));
+    } else if(received_fd >= 0){
+        close(received_fd);
+    }
+    //A batch spent one credit, so it is also returned as one message
+    count_consumed(hdr.sender);
+    if(hdr.type == MSG_COALESCED){
+        unpack_batch(buf, len, &hdr);
+        return 0;
+    }
+    if(hdr.type == MSG_FRAGMENT){
+        return reassemble(buf, len, &hdr);
+    }
+    return 1;
+}
+
+static int enqueue(int sender_id, int receiver_id, const void *msg, size_t msg_len, int fd, int carrier_sent){
+    if(queue_push(&pending[receiver_id], sender_id, msg, msg_len, fd, carrier_sent) < 0){
         return -1;
     }
+    num_pending++;
     return 0;
 }
 
+//The message is either sent right away or queued behind the earlier ones for this receiver, it is only lost if it's malformed
+static int send_msg_fd(int sender_id, int receiver_id, const void *msg, size_t msg_len, int fd){
+    if(msg_len > IPC_MAX_MSG_SIZE){
+        fprintf(stderr, "[ERROR HAPPENED] : Message size is too large\n");
+        return -1;
+    }
+    if(receiver_id < 0 || receiver_id > MAX_PROCESSES){
+        fprintf(stderr, "[ERROR HAPPENED] : Invalid receiver %d\n", receiver_id);
+        return -1;
+    }
 
-int receive_msg(int fd, char *buf, size_t buf_size){
-    ssize_t n = recv(fd, buf, buf_size - 1, 0);
+    if(pending[receiver_id].head != NULL){
+        flush_peer(receiver_id);
+    }
+    if(pending[receiver_id].head != NULL || send_credits[receiver_id] <= 0 || !send_reset_done(receiver_id)){
+        return enqueue(sender_id, receiver_id, msg, msg_len, fd, 0);
+    }
+    int carrier_sent = 0;
+    int ret = transmit(sender_id, receiver_id, msg, msg_len, fd, &carrier_sent);
+    if(ret == IPC_SEND_OK){
+        send_credits[receiver_id]--;
+        num_frames_sent++;
+        return 0;
+    }
+    if(ret == IPC_SEND_RETRY){
+        return enqueue(sender_id, receiver_id, msg, msg_len, fd, carrier_sent);
+    }
+    return -1;
+}
+
+//Splits a frame that is larger than IPC_MAX_MSG_SIZE into MSG_FRAGMENT frames, which queue up like any other frame
+static int send_fragmented(int sender_id, int receiver_id, const void *msg, size_t msg_len){
+    char fragment[IPC_MAX_MSG_SIZE] __attribute__((aligned(8)));
+    FragmentInfo info;
+    if(msg_len > IPC_MAX_REASSEMBLED_SIZE){
+        fprintf(stderr, "[ERROR HAPPENED] : Message size is too large\n");
+        return -1;
+    }
+    info.total_len = msg_len;
+    info.num_fragments = (msg_len + IPC_FRAGMENT_DATA - 1) / IPC_FRAGMENT_DATA;
+    uint32_t id = next_fragmented_id++;
+    memcpy(fragment + MSG_HEADER_SIZE, &info, sizeof(info));
+    for(uint32_t seq = 0; seq < info.num_fragments; seq++){
+        size_t offset = (size_t)seq * IPC_FRAGMENT_DATA;
+        size_t data_len = msg_len - offset < IPC_FRAGMENT_DATA ? msg_len - offset : IPC_FRAGMENT_DATA;
+        memcpy(fragment + MSG_HEADER_SIZE + sizeof(info), (const char *)msg + offset, data_len);
+        encode_msg(fragment, sizeof(fragment), MSG_FRAGMENT, sender_id, id, seq, NULL, 0);
+        ((MsgHeader *)fragment)->payload_len = sizeof(info) + data_len;
+        if(send_msg_fd(sender_id, receiver_id, fragment, MSG_HEADER_SIZE + sizeof(info) + data_len, -1) < 0){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//Messages of any size up to IPC_MAX_REASSEMBLED_SIZE, the larger ones are fragmented
+int send_msg(int sender_id, int receiver_id, const void *msg, size_t msg_len){
+    if(msg_len > IPC_MAX_MSG_SIZE){
+        return send_fragmented(sender_id, receiver_id, msg, msg_len);
+    }
+    return send_msg_fd(sender_id, receiver_id, msg, msg_len, -1);
+}
+
+//recvmsg that also picks up a descriptor sent with SCM_RIGHTS (*received_fd is -1 if there was none)
+static int receive_socket(int fd, char *buf, size_t buf_size, int *received_fd){
+    union{
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    struct iovec iov = {buf, buf_size - 1};
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = ctrl.buf;
+    mh.msg_controllen = sizeof(ctrl.buf);
+
+    *received_fd = -1;
+    ipc_num_syscalls++;
+    ssize_t n = recvmsg(fd, &mh, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
     if(n < 0){
         if(errno == EAGAIN || errno == EWOULDBLOCK){
             return 0;
@@ -130,32 +830,879 @@ int receive_msg(int fd, char *buf, size_t buf_size){
         perror("[ERROR HAPPENED] : When receiving a message");
         return -1;
     }
+    *received_fd = cmsg_fd(&mh);
+    buf[n] = '\0';
+    return n;
+}
+
+static int unix_receive(char *buf, size_t buf_size, int *received_fd){
+    int n = receive_socket(own_fd, buf, buf_size, received_fd);
+    if(n == 0 && transport->socket_drained != NULL){
+        transport->socket_drained();
+    }
+    return n;
+}
+
+//Backends that learn about socket data themselves spare us a read that would find it empty
+static int socket_readable(){
+    return transport->socket_readable == NULL || transport->socket_readable();
+}
+
+//One message from the backend or the socket, flow control frames are handled here and never returned
+//Returns 0 right after a batch was unpacked into the stash, so its frames aren't overtaken by the rest of the socket
+static int receive_one(int fd, char *buf, size_t buf_size){
+    while(1){
+        int n = 0;
+        int received_fd = -1;
+        int stashed = stash.count;
+        if(transport != &unix_transport){
+            n = transport->receive(buf, buf_size, &received_fd);
+        }
+        if(n <= 0 && (!socket_readable() || (n = unix_receive(buf, buf_size, &received_fd)) <= 0)){
+            return n;
+        }
+        if(accept_msg(buf, n, received_fd)){
+            return n;
+        }
+        if(stash.count > stashed){
+            return 0;
+        }
+    }
+}
+
+static int pop_stash(char *buf, size_t buf_size){
+    size_t n = stash.head->len < buf_size - 1 ? stash.head->len : buf_size - 1;
+    memcpy(buf, stash.head->data, n);
     buf[n] = '\0';
+    queue_pop(&stash);
+    return (int)n;
+}
+
+int receive_msg(int fd, char *buf, size_t buf_size){
+    if(num_pending > 0 || num_credits_owed > 0 || num_reset_done_owed > 0){
+        flush_all();
+    }
+    if(stash.head != NULL){
+        return pop_stash(buf, buf_size);
+    }
+    int n = receive_one(fd, buf, buf_size);
+    if(n == 0 && stash.head != NULL){
+        return pop_stash(buf, buf_size);
+    }
     return n;
 }
 
+//Unix backend: sends the whole batch with sendmmsg through an unconnected socket with cached peer addresses,
+//so one call can reach many receivers (num_msgs is at most IPC_BATCH_SIZE)
+static int unix_send_batch(int sender_id, const IPCOutMsg *msgs, int num_msgs, int *status){
+    struct mmsghdr hdrs[IPC_BATCH_SIZE];
+    struct iovec iovs[IPC_BATCH_SIZE];
+    int idx[IPC_BATCH_SIZE];
+    int sent = 0;
+
+    if(batch_socket < 0){
+        batch_socket = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(batch_socket < 0){
+            perror("[ERROR HAPPENED] : Tried to initialize socket when sending a message, but failed\n");
+            for(int i = 0; i < num_msgs; i++){
+                status[i] = IPC_SEND_RETRY;
+            }
+            return 0;
+        }
+    }
+
+    for(int i = 0; i < num_msgs; i++){
+        int r = msgs[i].receiver_id;
+        idx[i] = i;
+        iovs[i].iov_base = (void *)msgs[i].msg;
+        iovs[i].iov_len = msgs[i].msg_len;
+        memset(&hdrs[i], 0, sizeof(hdrs[i]));
+        hdrs[i].msg_hdr.msg_name = &peer_addrs[r];
+        hdrs[i].msg_hdr.msg_namelen = sizeof(peer_addrs[r]);
+        hdrs[i].msg_hdr.msg_iov = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    //sendmmsg stops at the first failing message: that message and everything after it for the same receiver is retried later
+    int k = num_msgs;
+    int done = 0;
+    while(done < k){
+        ipc_num_syscalls++;
+        int n = sendmmsg(batch_socket, hdrs + done, k - done, 0);
+        if(n > 0){
+            for(int i = done; i < done + n; i++){
+                status[idx[i]] = IPC_SEND_OK;
+            }
+            sent += n;
+            done += n;
+            continue;
+        }
+        int r = msgs[idx[done]].receiver_id;
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOENT && errno != ECONNREFUSED){
+            perror("[ERROR HAPPENED] : Sending the message batch failed");
+            status[idx[done]] = IPC_SEND_ERROR;
+            done++;
+            continue;
+        }
+        int kept = done;
+        for(int i = done; i < k; i++){
+            if(msgs[idx[i]].receiver_id == r){
+                status[idx[i]] = IPC_SEND_RETRY;
+            } else{
+                idx[kept] = idx[i];
+                iovs[kept] = iovs[i];
+                hdrs[kept] = hdrs[i];
+                hdrs[kept].msg_hdr.msg_iov = &iovs[kept];
+                kept++;
+            }
+        }
+        k = kept;
+    }
+    return sent;
+}
+
+//For backends without a batch send; once a receiver is full its later messages wait as well, so they keep their order
+static void send_each(int sender_id, const IPCOutMsg *msgs, int num_msgs, int *status){
+    char blocked[MAX_PROCESSES + 1];
+    memset(blocked, 0, sizeof(blocked));
+    for(int i = 0; i < num_msgs; i++){
+        int r = msgs[i].receiver_id;
+        int carrier_sent = 0;
+        if(blocked[r]){
+            status[i] = IPC_SEND_RETRY;
+            continue;
+        }
+        status[i] = transmit(sender_id, r, msgs[i].msg, msgs[i].msg_len, -1, &carrier_sent);
+        blocked[r] = status[i] == IPC_SEND_RETRY;
+    }
+}
+
+//Sends up to num_msgs messages with as few backend calls as possible (one per IPC_BATCH_SIZE messages)
+//Messages without credits or that hit a full receiver are queued like in send_msg; returns the number of messages accepted
+int send_msg_batch(int sender_id, const IPCOutMsg *msgs, int num_msgs){
+    IPCOutMsg batch[IPC_BATCH_SIZE];
+    int status[IPC_BATCH_SIZE];
+    int accepted = 0;
+
+    //A message that needs fragments goes out on its own, after the ones before it
+    for(int i = 0; i < num_msgs; i++){
+        if(msgs[i].msg_len > IPC_MAX_MSG_SIZE){
+            accepted = send_msg_batch(sender_id, msgs, i);
+            accepted += send_msg(sender_id, msgs[i].receiver_id, msgs[i].msg, msgs[i].msg_len) == 0;
+            return accepted + send_msg_batch(sender_id, msgs + i + 1, num_msgs - i - 1);
+        }
+    }
+
+    for(int start = 0; start < num_msgs; start += IPC_BATCH_SIZE){
+        int count = num_msgs - start < IPC_BATCH_SIZE ? num_msgs - start : IPC_BATCH_SIZE;
+
+        int k = 0;
+        for(int i = 0; i < count; i++){
+            const IPCOutMsg *m = &msgs[start + i];
+            int r = m->receiver_id;
+            if(r < 0 || r > MAX_PROCESSES){
+                fprintf(stderr, "[ERROR HAPPENED] : Invalid message in batch (receiver %d, %zu bytes)\n", r, m->msg_len);
+                continue;
+            }
+            if(pending[r].head != NULL || send_credits[r] <= 0 || !send_reset_done(r)){
+                accepted += enqueue(sender_id, r, m->msg, m->msg_len, -1, 0) == 0;
+                continue;
+            }
+            send_credits[r]--;
+            batch[k++] = *m;
+        }
+
+        if(transport->send_batch != NULL){
+            transport->send_batch(sender_id, batch, k, status);
+        } else{
+            send_each(sender_id, batch, k, status);
+        }
+        for(int i = 0; i < k; i++){
+            int r = batch[i].receiver_id;
+            if(status[i] == IPC_SEND_OK){
+                num_frames_sent++;
+                accepted++;
+                continue;
+            }
+            send_credits[r]++;
+            if(status[i] != IPC_SEND_ERROR){
+                accepted += enqueue(sender_id, r, batch[i].msg, batch[i].msg_len, -1, 0) == 0;
+            }
+        }
+    }
+    return accepted;
+}
+
+//Unix backend: up to max_msgs datagrams (at most IPC_BATCH_SIZE) with one recvmmsg call
+static int unix_receive_batch(char **bufs, size_t buf_size, int *lens, int *fds, int max_msgs){
+    struct mmsghdr hdrs[IPC_BATCH_SIZE];
+    struct iovec iovs[IPC_BATCH_SIZE];
+    union{
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl[IPC_BATCH_SIZE];
+
+    for(int i = 0; i < max_msgs; i++){
+        iovs[i].iov_base = bufs[i];
+        iovs[i].iov_len = buf_size - 1;
+        memset(&hdrs[i], 0, sizeof(hdrs[i]));
+        hdrs[i].msg_hdr.msg_iov = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+        hdrs[i].msg_hdr.msg_control = ctrl[i].buf;
+        hdrs[i].msg_hdr.msg_controllen = sizeof(ctrl[i].buf);
+    }
+
+    ipc_num_syscalls++;
+    int n = recvmmsg(own_fd, hdrs, max_msgs, MSG_DONTWAIT | MSG_CMSG_CLOEXEC, NULL);
+    if(n < 0){
+        if(errno == EAGAIN || errno == EWOULDBLOCK){
+            if(transport->socket_drained != NULL){
+                transport->socket_drained();
+            }
+            return 0;
+        }
+        perror("[ERROR HAPPENED] : When receiving a message batch");
+        return -1;
+    }
+    for(int i = 0; i < n; i++){
+        lens[i] = hdrs[i].msg_len;
+        bufs[i][lens[i]] = '\0';
+        fds[i] = cmsg_fd(&hdrs[i].msg_hdr);
+    }
+    return n;
+}
+
+//Fills bufs[count..] from one backend and drops the flow control frames, returns the new count (-1 on errors)
+static int receive_batch_from(const IPCTransport *t, char **bufs, size_t buf_size, int *lens, int count, int max_msgs){
+    int fds[IPC_BATCH_SIZE];
+    int want = max_msgs - count < IPC_BATCH_SIZE ? max_msgs - count : IPC_BATCH_SIZE;
+    int n;
+
+    if(t->receive_batch != NULL){
+        n = t->receive_batch(bufs + count, buf_size, lens + count, fds, want);
+    } else{
+        for(n = 0; n < want; n++){
+            int len = t->receive(bufs[count + n], buf_size, &fds[n]);
+            if(len <= 0){
+                break;
+            }
+            lens[count + n] = len;
+        }
+    }
+    if(n < 0){
+        return -1;
+    }
+    int base = count;
+    for(int i = 0; i < n; i++){
+        char *buf = bufs[base + i];
+        int len = lens[base + i];
+        if(accept_msg(buf, len, fds[i])){
+            bufs[base + i] = bufs[count];
+            bufs[count] = buf;
+            lens[count++] = len;
+        }
+    }
+    return count;
+}
+
+//Receives up to max_msgs messages, bufs[i] gets message i and lens[i] its length
+//Flow control frames are dropped from the result, so the pointers in bufs may be reordered
+//Returns the number of messages (0 if there is nothing to read)
+int receive_msg_batch(int fd, char **bufs, size_t buf_size, int *lens, int max_msgs){
+    int count = 0;
+
+    if(num_pending > 0 || num_credits_owed > 0 || num_reset_done_owed > 0){
+        flush_all();
+    }
+    while(count < max_msgs && stash.head != NULL){
+        lens[count] = pop_stash(bufs[count], buf_size);
+        count++;
+    }
+
+    if(transport != &unix_transport && count < max_msgs){
+        int n = receive_batch_from(transport, bufs, buf_size, lens, count, max_msgs);
+        if(n > 0){
+            count = n;
+        }
+    }
+    if(count < max_msgs && socket_readable()){
+        int n = receive_batch_from(&unix_transport, bufs, buf_size, lens, count, max_msgs);
+        if(n < 0){
+            return count > 0 ? count : -1;
+        }
+        count = n;
+    }
+    //Frames of unpacked batches, every slot from count on is free again
+    while(count < max_msgs && stash.head != NULL){
+        lens[count] = pop_stash(bufs[count], buf_size);
+        count++;
+    }
+    return count;
+}
+
+//Number of messages still waiting for credits or buffer space
+int ipc_pending(){
+    return num_pending;
+}
+
+//Backend in use and what it cost to move the frames (credit and descriptor carrier frames aren't counted)
+void ipc_print_stats(FILE *fp){
+    uint64_t frames = num_frames_sent + num_frames_received;
+    fprintf(fp, "Transport: %s\n", transport->name);
+    fprintf(fp, "Frames sent: %llu, received: %llu\n", (unsigned long long)num_frames_sent, (unsigned long long)num_frames_received);
+    fprintf(fp, "Transport syscalls: %llu (%.2f per frame)\n", (unsigned long long)ipc_num_syscalls,
+            frames > 0 ? (double)ipc_num_syscalls / frames : 0.0);
+}
+
+void ipc_get_stats(IPCStats *stats){
+    stats->transport = transport->name;
+    stats->frames_sent = num_frames_sent;
+    stats->frames_received = num_frames_received;
+    stats->syscalls = ipc_num_syscalls;
+}
+
+//Blocks until every queued message has left or timeout_ms passed, returns how many are still queued
+//Messages that arrive in the meantime are kept for receive_msg, only the credit frames are consumed
+int ipc_flush(int fd, int timeout_ms){
+    static __thread char flush_buf[IPC_MAX_MSG_SIZE + 1] __attribute__((aligned(8)));
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while(1){
+        flush_all();
+        if(num_pending == 0){
+            return 0;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        if(elapsed_ms >= timeout_ms){
+            fprintf(stderr, "[ERROR HAPPENED] : %d messages are still queued after %d ms\n", num_pending, timeout_ms);
+            return num_pending;
+        }
+        int n;
+        while((n = receive_one(fd, flush_buf, sizeof(flush_buf))) > 0){
+            queue_push(&stash, own_process_id, flush_buf, n, -1, 0);
+        }
+        //Not ipc_wait: the stash we just filled would wake us up right away
+        transport->wait(timeout_ms - elapsed_ms, num_pending > 0);
+    }
+}
+
+//Waits on the connected sockets of receivers that have queued messages, so we wake up once they drained
+static void watch_blocked_peers(int add){
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT;
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        if(pending[i].head != NULL && sender_sockets[i] >= 0){
+            ev.data.fd = sender_sockets[i];
+            epoll_ctl(epoll_fd, add ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, sender_sockets[i], &ev);
+        }
+    }
+}
+
+//Unix backend: epoll on the socket, while messages are queued we also wake up when a receiver has room again
+static int unix_wait(int timeout_ms, int has_pending){
+    if(epoll_fd < 0){
+        struct epoll_event ev;
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if(epoll_fd < 0){
+            perror("[ERROR HAPPENED] : Could not create epoll instance");
+            return 0;
+        }
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = own_fd;
+        if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, own_fd, &ev) < 0){
+            perror("[ERROR HAPPENED] : Could not add the socket to epoll");
+        }
+    }
+    ipc_num_syscalls++;
+    if(!has_pending){
+        struct epoll_event events[1];
+        return epoll_wait(epoll_fd, events, 1, timeout_ms) > 0;
+    }
+
+    //A receiver that isn't up yet has no socket to watch, retry it after IPC_PENDING_RETRY_MS
+    if(timeout_ms < 0 || timeout_ms > IPC_PENDING_RETRY_MS){
+        timeout_ms = IPC_PENDING_RETRY_MS;
+    }
+    struct epoll_event events[MAX_PROCESSES + 2];
+    watch_blocked_peers(1);
+    int ready = epoll_wait(epoll_fd, events, MAX_PROCESSES + 2, timeout_ms);
+    watch_blocked_peers(0);
+    return ready > 0;
+}
+
+//Blocks until a message may be available or timeout_ms passes (-1 waits forever)
+//The backend decides how to sleep: epoll for the sockets, the futex doorbell for the shm rings
+int ipc_wait(int fd, int timeout_ms){
+    if(num_pending > 0 || num_credits_owed > 0 || num_reset_done_owed > 0){
+        flush_all();
+    }
+    if(stash.head != NULL){
+        return 1;
+    }
+    //Credits and reset answers that didn't go out are retried like queued frames
+    return transport->wait(timeout_ms, num_pending > 0 || num_credits_owed > 0 || num_reset_done_owed > 0);
+}
+
+//The socket is set up by initiate_communication for every backend, so there is nothing left to do here
+static int unix_init(int process_id, int socket_fd){
+    return 0;
+}
+
+static void unix_close(int process_id){
+    if(epoll_fd >= 0){
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+}
+
+const IPCTransport unix_transport = {
+    .name = "unix",
+    .passes_fds = 1,
+    .init = unix_init,
+    .send = unix_send,
+    .send_batch = unix_send_batch,
+    .receive = unix_receive,
+    .receive_batch = unix_receive_batch,
+    .wait = unix_wait,
+    .close = unix_close,
+    .socket_readable = NULL,
+    .socket_drained = NULL,
+    .peer_replaced = NULL,
+};
+
+//A node that took over the id of an earlier one (load generator clients of later phases) starts the flow control
+//with the peers 0..num_peers-1 over: the peers may still hold frames, credits or a fragment of the old node
+//The MSG_RESET goes out like any frame, so it arrives before our queries; until a peer's MSG_RESET comes back,
+//whatever it sends was meant for the old node and is dropped without counting it
+void ipc_rejoin(int num_peers){
+    char frame[MSG_HEADER_SIZE] __attribute__((aligned(8)));
+    size_t len = encode_msg(frame, sizeof(frame), MSG_RESET, own_process_id, 0, IPC_RESET_REQUEST, NULL, 0);
+    for(int p = 0; p < num_peers && p <= MAX_PROCESSES; p++){
+        if(p == own_process_id){
+            continue;
+        }
+        awaiting_reset[p] = 1;
+        if(send_msg_fd(own_process_id, p, frame, len, -1) < 0){
+            awaiting_reset[p] = 0;
+        }
+    }
+}
+
 void close_communication(int process_id, int fd){
     char sock_path[108];
 
-    for(int i = 0; i < MAX_PROCESSES; i++){
-        if(sender_sockets[i] >= 0){
-            close(sender_sockets[i]);
-            sender_sockets[i] = -1;
-        }
+    if(own_process_id >= 0){
+        return_all_credits();
     }
+    if(transport != &unix_transport){
+        transport->close(process_id);
+    }
+
+    cleanup_ipc();
+    unix_close(process_id);
 
+    if(own_fd < 0){
+        return;
+    }
     snprintf(sock_path, sizeof(sock_path), "%s/proc_%d.sock", SOCKET_DIR, process_id);
     close(fd);
     unlink(sock_path);
+    own_fd = -1;
 
     //printf("[SUCCESS] Process %d closed communication\n", process_id);
 }
 
 void cleanup_ipc(){
-    for (int i = 0; i < MAX_PROCESSES; i++){
+    for (int i = 0; i <= MAX_PROCESSES; i++){
         if(sender_sockets[i] >= 0){
             close(sender_sockets[i]);
             sender_sockets[i] = -1;
         }
+        queue_clear(&pending[i]);
+    }
+    queue_clear(&stash);
+    num_pending = 0;
+    while(num_carried_fds > 0){
+        close(carried_fds[--num_carried_fds].fd);
+    }
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        drop_reassembly(i);
+    }
+    while(num_reassembled > 0){
+        free(reassembled[--num_reassembled].frame);
+    }
+    if(batch_socket >= 0){
+        close(batch_socket);
+        batch_socket = -1;
+    }
+}
+
+
+static const char *msg_type_names[MSG_TYPE_COUNT] = {
+    [MSG_INVALID] = "INVALID",
+    [MSG_KEY_SEGMENT] = "KEY_SEGMENT",
+    [MSG_QUERY] = "QUERY",
+    [MSG_PQUERY] = "PQUERY",
+    [MSG_PFOUND] = "PFOUND",
+    [MSG_PNOTFOUND] = "PNOTFOUND",
+    [MSG_FOUND] = "FOUND",
+    [MSG_NOTFOUND] = "NOTFOUND",
+    [MSG_BLOOM_FILTER] = "BLOOM_FILTER",
+    [MSG_INSERT_SEGMENT] = "INSERT_SEGMENT",
+    [MSG_DELETE_SEGMENT] = "DELETE_SEGMENT",
+    [MSG_CREDIT] = "CREDIT",
+    [MSG_FD_CARRIER] = "FD_CARRIER",
+    [MSG_COALESCED] = "COALESCED",
+    [MSG_FRAGMENT] = "FRAGMENT",
+    [MSG_RESET] = "RESET",
+    [MSG_READY] = "READY",
+    [MSG_BUILT] = "BUILT",
+    [MSG_BROADCAST_DONE] = "BROADCAST_DONE",
+};
+
+const char *msg_type_name(int type){
+    if(type <= MSG_INVALID || type >= MSG_TYPE_COUNT || msg_type_names[type] == NULL){
+        return "UNKNOWN";
+    }
+    return msg_type_names[type];
+}
+
+//Writes the header and the payload into buf, returns the total frame length (0 if it does not fit)
+size_t encode_msg(char *buf, size_t buf_size, MsgType type, int sender_id, uint32_t request_id, int32_t arg, const void *payload, size_t payload_len){
+    size_t frame_len = MSG_HEADER_SIZE + payload_len;
+    if(frame_len > buf_size){
+        return 0;
+    }
+    MsgHeader hdr;
+    hdr.type = (uint16_t)type;
+    hdr.flags = 0;
+    hdr.sender = sender_id;
+    hdr.request_id = request_id;
+    hdr.arg = arg;
+    hdr.payload_len = (uint32_t)payload_len;
+    memcpy(buf, &hdr, MSG_HEADER_SIZE);
+    if(payload_len > 0){
+        memcpy(buf + MSG_HEADER_SIZE, payload, payload_len);
+    }
+    return frame_len;
+}
+
+//Validates a received frame and points payload right after the header
+int decode_msg(const char *buf, size_t len, MsgHeader *hdr, const char **payload){
+    if(len < MSG_HEADER_SIZE){
+        return -1;
+    }
+    memcpy(hdr, buf, MSG_HEADER_SIZE);
+    if(hdr->type == MSG_INVALID || hdr->type >= MSG_TYPE_COUNT || MSG_HEADER_SIZE + hdr->payload_len > len){
+        return -1;
+    }
+    *payload = buf + MSG_HEADER_SIZE;
+    return 0;
+}
+
+//Keys are packed right after the header, the receive buffer has to be 4-byte aligned (malloc'd buffers are)
+const int *msg_keys(const MsgHeader *hdr, const char *payload, int *num_keys){
+    *num_keys = hdr->payload_len / sizeof(int32_t);
+    return (const int *)payload;
+}
+
+//Payloads that don't fit into one frame are encoded into a temporary buffer and fragmented by send_msg
+int send_frame(int sender_id, int receiver_id, MsgType type, uint32_t request_id, int32_t arg, const void *payload, size_t payload_len){
+    char frame[IPC_MAX_MSG_SIZE];
+    if(MSG_HEADER_SIZE + payload_len > sizeof(frame)){
+        char *large = malloc(MSG_HEADER_SIZE + payload_len);
+        if(large == NULL){
+            fprintf(stderr, "[ERROR HAPPENED] : Could not allocate a %s message of %zu bytes\n", msg_type_name(type), payload_len);
+            return -1;
+        }
+        size_t large_len = encode_msg(large, MSG_HEADER_SIZE + payload_len, type, sender_id, request_id, arg, payload, payload_len);
+        int ret = send_msg(sender_id, receiver_id, large, large_len);
+        free(large);
+        return ret;
     }
+    size_t frame_len = encode_msg(frame, sizeof(frame), type, sender_id, request_id, arg, payload, payload_len);
+    return send_msg(sender_id, receiver_id, frame, frame_len);
+}
+
+int send_key_frame(int sender_id, int receiver_id, MsgType type, uint32_t request_id, int32_t arg, int key){
+    int32_t k = key;
+    return send_frame(sender_id, receiver_id, type, request_id, arg, &k, sizeof(k));
+}
+
+//Sends the same frame to every receiver in one batch (fan-out of a query or a key chunk to several processes)
+//Returns the number of receivers the frame was sent to
+int send_frame_batch(int sender_id, const int *receivers, int num_receivers, MsgType type, uint32_t request_id, int32_t arg, const void *payload, size_t payload_len){
+    char frame[IPC_MAX_MSG_SIZE] __attribute__((aligned(8)));
+    IPCOutMsg msgs[MAX_PROCESSES + 1];
+    if(MSG_HEADER_SIZE + payload_len > sizeof(frame)){
+        int sent = 0;
+        for(int i = 0; i < num_receivers; i++){
+            sent += send_frame(sender_id, receivers[i], type, request_id, arg, payload, payload_len) == 0;
+        }
+        return sent;
+    }
+    size_t len = encode_msg(frame, sizeof(frame), type, sender_id, request_id, arg, payload, payload_len);
+    if(num_receivers > MAX_PROCESSES + 1){
+        num_receivers = MAX_PROCESSES + 1;
+    }
+    for(int i = 0; i < num_receivers; i++){
+        msgs[i].receiver_id = receivers[i];
+        msgs[i].msg = frame;
+        msgs[i].msg_len = len;
+    }
+    return send_msg_batch(sender_id, msgs, num_receivers);
+}
+
+int send_key_frame_batch(int sender_id, const int *receivers, int num_receivers, MsgType type, uint32_t request_id, int32_t arg, int key){
+    int32_t k = key;
+    return send_frame_batch(sender_id, receivers, num_receivers, type, request_id, arg, &k, sizeof(k));
+}
+
+//Sends a key array as one message, the receiver's handler sees all keys at once however many fragments it took
+int send_keys(int sender_id, int receiver_id, MsgType type, int32_t arg, const int *keys, int num_keys){
+    return send_frame(sender_id, receiver_id, type, 0, arg, keys, (size_t)num_keys * sizeof(int32_t));
+}
+
+//Creates an anonymous shared buffer of size bytes, mapped read-write at *addr
+//Fill it and seal it with ipc_memfd_seal before it is sent; returns the descriptor
+int ipc_memfd_create(const char *name, size_t size, void **addr){
+    int fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(fd < 0){
+        perror("[ERROR HAPPENED] : Could not create the shared buffer");
+        return -1;
+    }
+    if(ftruncate(fd, size) < 0){
+        perror("[ERROR HAPPENED] : Could not size the shared buffer");
+        close(fd);
+        return -1;
+    }
+    *addr = NULL;
+    if(size > 0){
+        *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(*addr == MAP_FAILED){
+            perror("[ERROR HAPPENED] : Could not map the shared buffer");
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+//Drops the writable mapping and seals the buffer, after this nobody can change or resize it
+int ipc_memfd_seal(int fd, void *addr, size_t size){
+    if(addr != NULL){
+        munmap(addr, size);
+    }
+    if(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0){
+        perror("[ERROR HAPPENED] : Could not seal the shared buffer");
+        return -1;
+    }
+    return 0;
+}
+
+//In-process mode: every node thread that receives a buffer gets the same mapping, counted by its users, so a
+//summary broadcast to hundreds of nodes is one mapping (and one pointer) instead of one per node
+typedef struct{
+    dev_t dev;
+    ino_t ino;
+    const void *addr;
+    size_t size;
+    int refs;
+} SharedMapping;
+
+static SharedMapping *shared_mappings = NULL;
+static int num_shared_mappings = 0;
+static int shared_mappings_capacity = 0;
+static pthread_mutex_t shared_mappings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const void *map_sealed(int fd, size_t size){
+    void *addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if(addr == MAP_FAILED){
+        perror("[ERROR HAPPENED] : Could not map the received buffer");
+        return NULL;
+    }
+    return addr;
+}
+
+static const void *map_shared(int fd, const struct stat *st){
+    const void *addr = NULL;
+    pthread_mutex_lock(&shared_mappings_lock);
+    for(int i = 0; i < num_shared_mappings; i++){
+        SharedMapping *m = &shared_mappings[i];
+        if(m->dev == st->st_dev && m->ino == st->st_ino){
+            m->refs++;
+            addr = m->addr;
+            break;
+        }
+    }
+    if(addr == NULL && (addr = map_sealed(fd, st->st_size)) != NULL){
+        if(num_shared_mappings == shared_mappings_capacity){
+            int capacity = shared_mappings_capacity == 0 ? 64 : shared_mappings_capacity * 2;
+            SharedMapping *grown = realloc(shared_mappings, capacity * sizeof(SharedMapping));
+            if(grown == NULL){
+                pthread_mutex_unlock(&shared_mappings_lock);
+                munmap((void *)addr, st->st_size);
+                return NULL;
+            }
+            shared_mappings = grown;
+            shared_mappings_capacity = capacity;
+        }
+        shared_mappings[num_shared_mappings++] = (SharedMapping){st->st_dev, st->st_ino, addr, st->st_size, 1};
+    }
+    pthread_mutex_unlock(&shared_mappings_lock);
+    return addr;
+}
+
+//0 if addr is not a shared mapping
+static int unmap_shared(const void *addr){
+    pthread_mutex_lock(&shared_mappings_lock);
+    for(int i = 0; i < num_shared_mappings; i++){
+        SharedMapping *m = &shared_mappings[i];
+        if(m->addr == addr){
+            if(--m->refs == 0){
+                munmap((void *)m->addr, m->size);
+                *m = shared_mappings[--num_shared_mappings];
+            }
+            pthread_mutex_unlock(&shared_mappings_lock);
+            return 1;
+        }
+    }
+    pthread_mutex_unlock(&shared_mappings_lock);
+    return 0;
+}
+
+//Maps a received buffer read-only and closes the descriptor
+//Only sealed buffers are accepted, so the sender can't change the content under us; returns NULL on error (or if it is empty)
+//Release it with ipc_memfd_unmap, in-process the mapping may be shared with other node threads
+const void *ipc_memfd_map(int fd, size_t *size){
+    struct stat st;
+    *size = 0;
+    if(fd < 0){
+        return NULL;
+    }
+    int seals = fcntl(fd, F_GET_SEALS);
+    if(seals < 0 || !(seals & F_SEAL_WRITE) || !(seals & F_SEAL_SHRINK) || fstat(fd, &st) < 0){
+        fprintf(stderr, "[ERROR HAPPENED] : Received a shared buffer that is not sealed\n");
+        close(fd);
+        return NULL;
+    }
+    const void *addr = NULL;
+    if(st.st_size > 0){
+        addr = transport == &thread_transport ? map_shared(fd, &st) : map_sealed(fd, st.st_size);
+        if(addr == NULL){
+            close(fd);
+            return NULL;
+        }
+        *size = st.st_size;
+    }
+    close(fd);
+    return addr;
+}
+
+void ipc_memfd_unmap(const void *addr, size_t size){
+    if(addr != NULL && size > 0 && (transport != &thread_transport || !unmap_shared(addr))){
+        munmap((void *)addr, size);
+    }
+}
+
+//Descriptor that came with a MSG_FLAG_FD frame (-1 if there is none), the handler owns it
+int msg_fd(const MsgHeader *hdr, const char *payload){
+    int32_t fd;
+    if(!(hdr->flags & MSG_FLAG_FD) || hdr->payload_len < sizeof(int32_t)){
+        return -1;
+    }
+    memcpy(&fd, payload, sizeof(fd));
+    return fd;
+}
+
+//Sends a descriptor (e.g. a sealed memfd) to every receiver, the caller may close it afterwards
+//The payload slot of the descriptor holds the token that pairs the frame with its carrier on the shm transport
+int send_fd_frame(int sender_id, const int *receivers, int num_receivers, MsgType type, uint32_t request_id, int32_t arg, int fd, uint16_t flags){
+    char frame[MSG_HEADER_SIZE + sizeof(int32_t)] __attribute__((aligned(8)));
+    int32_t token = next_fd_token++;
+    size_t len = encode_msg(frame, sizeof(frame), type, sender_id, request_id, arg, &token, sizeof(token));
+    ((MsgHeader *)frame)->flags = MSG_FLAG_FD | flags;
+    int sent = 0;
+    for(int i = 0; i < num_receivers; i++){
+        if(send_msg_fd(sender_id, receivers[i], frame, len, fd) == 0){
+            sent++;
+        }
+    }
+    return sent;
+}
+
+//Puts the whole key array into one sealed memfd that all receivers map, instead of copying it chunk by chunk
+//The receivers' handlers see a normal key frame (dispatch_msg maps the buffer for them)
+//IPC_INLINE_PAYLOADS=1 sends the keys through the transport instead, as one fragmented message per receiver
+int send_keys_shared(int sender_id, const int *receivers, int num_receivers, MsgType type, int32_t arg, const int *keys, int num_keys){
+    void *addr;
+    size_t size = (size_t)num_keys * sizeof(int32_t);
+    const char *inline_env = getenv("IPC_INLINE_PAYLOADS");
+    if(inline_env != NULL && atoi(inline_env) > 0){
+        return send_frame_batch(sender_id, receivers, num_receivers, type, 0, arg, keys, size);
+    }
+    int fd = ipc_memfd_create(msg_type_name(type), size, &addr);
+    if(fd < 0){
+        return 0;
+    }
+    if(size > 0){
+        memcpy(addr, keys, size);
+    }
+    if(ipc_memfd_seal(fd, addr, size) < 0){
+        close(fd);
+        return 0;
+    }
+    int sent = send_fd_frame(sender_id, receivers, num_receivers, type, 0, arg, fd, MSG_FLAG_SHARED);
+    close(fd);
+    return sent;
+}
+
+//Table-driven dispatch: handlers is indexed by MsgType
+//Returns -1 for malformed frames and for types without a handler, so the caller can report them
+int dispatch_msg(const MsgHandler *handlers, const char *buf, size_t len){
+    MsgHeader hdr;
+    const char *payload;
+    if(decode_msg(buf, len, &hdr, &payload) < 0){
+        return -1;
+    }
+    if(hdr.flags & MSG_FLAG_REASSEMBLED){
+        int32_t token;
+        size_t full_len;
+        if(hdr.payload_len < sizeof(token)){
+            return -1;
+        }
+        memcpy(&token, payload, sizeof(token));
+        char *full = take_reassembled(token, &full_len);
+        if(full == NULL){
+            return -1;
+        }
+        int ret = dispatch_msg(handlers, full, full_len);
+        free(full);
+        return ret;
+    }
+    if(handlers[hdr.type] == NULL){
+        if(hdr.flags & MSG_FLAG_FD){
+            close(msg_fd(&hdr, payload));
+        }
+        return -1;
+    }
+    //A shared payload is mapped for the duration of the handler, which sees it like an inline payload
+    if(hdr.flags & MSG_FLAG_SHARED){
+        size_t size;
+        const void *shared = ipc_memfd_map(msg_fd(&hdr, payload), &size);
+        if(shared == NULL && size > 0){
+            return -1;
+        }
+        hdr.flags &= ~(MSG_FLAG_FD | MSG_FLAG_SHARED);
+        hdr.payload_len = size;
+        handlers[hdr.type](&hdr, shared);
+        ipc_memfd_unmap(shared, size);
+        return 0;
+    }
+    handlers[hdr.type](&hdr, payload);
+    return 0;
 }
@@ -1,12 +1,126 @@
 #ifndef IPC_H
 
 #define IPC_H
+#include <stdio.h>
 #include <stddef.h>
+#include <stdint.h>
+
+//Ids of the processes, the manager and the load generator clients all stay below it
+#define MAX_PROCESSES 1024
+#define IPC_BATCH_SIZE 32
+//Messages a sender may have in flight to one receiver before it waits for credits
+//Unix datagram queues hold only max_dgram_qlen (10 by default) messages, so the window is kept small
+#define IPC_CREDIT_WINDOW 8
+#define IPC_CREDIT_RETURN (IPC_CREDIT_WINDOW / 2)
+#define IPC_FLUSH_TIMEOUT_MS 60000
+#define IPC_MAX_CARRIED_FDS 64
+#define IPC_RESET_REQUEST 0
+#define IPC_RESET_DONE 1
+
+//Every message is a binary frame: a fixed-size MsgHeader followed by payload_len bytes of payload
+//Messages that carry keys pack them as int32 values right after the header, so no decimal parsing is needed
+typedef enum{
+    MSG_INVALID = 0,
+    MSG_KEY_SEGMENT,        //key segment (key_segment.h) with the keys of every process, build from it and report MSG_BUILT
+    MSG_QUERY,              //manager or load generator client -> process, one key
+    MSG_PQUERY,             //process -> peer, one key
+    MSG_PFOUND,             //peer -> process, "arg" is the peer that has the key
+    MSG_PNOTFOUND,
+    MSG_FOUND,              //process -> sender of the query, "arg" is the process that has the key
+    MSG_NOTFOUND,           //process -> sender of the query, "arg" is the process that checked (-1 if not ready or too busy)
+    MSG_BLOOM_FILTER,       //carries a sealed memfd with the exported filter of process "arg"
+    MSG_INSERT_SEGMENT,     //key segment of new keys by owner, apply them and report MSG_BUILT
+    MSG_DELETE_SEGMENT,     //key segment of deleted keys by owner, apply them and report MSG_BUILT
+    MSG_CREDIT,             //flow control, "arg" credits returned to the receiver (handled inside IPC.c)
+    MSG_FD_CARRIER,         //descriptor of the ring frame with token "arg" (shm transport, handled inside IPC.c)
+    MSG_COALESCED,          //"arg" coalesced frames packed back to back (see coalesce.h), unpacked inside IPC.c
+    MSG_FRAGMENT,           //part "arg" of message "request_id" that is larger than a frame, reassembled inside IPC.c
+    MSG_RESET,              //flow control starts over for a node that reuses an id, "arg" IPC_RESET_* (see ipc_rejoin)
+    MSG_READY,              //process -> manager, up and listening (see barrier.h)
+    MSG_BUILT,              //process -> manager, summary of phase "request_id" built
+    MSG_BROADCAST_DONE,     //process -> manager, holds the summaries of all peers (phase "request_id")
+    MSG_TYPE_COUNT
+} MsgType;
+
+typedef struct{
+    uint16_t type;
+    uint16_t flags;
+    int32_t sender;
+    uint32_t request_id;
+    int32_t arg;
+    uint32_t payload_len;
+} MsgHeader;
+
+//Header flags
+//MSG_FLAG_FD: the first int32 of the payload is a descriptor that came with the frame (see msg_fd)
+//MSG_FLAG_SHARED: the descriptor is a sealed memfd with the real payload, dispatch_msg maps it for the handler
+//MSG_FLAG_REASSEMBLED: the frame stands for a reassembled message kept inside IPC.c, dispatch_msg hands its payload to the handler
+#define MSG_FLAG_FD 0x1
+#define MSG_FLAG_SHARED 0x2
+#define MSG_FLAG_REASSEMBLED 0x4
+
+#define MSG_HEADER_SIZE sizeof(MsgHeader)
+#define IPC_MAX_MSG_SIZE 65000
+#define IPC_MAX_KEYS_PER_MSG ((IPC_MAX_MSG_SIZE - MSG_HEADER_SIZE) / sizeof(int32_t))
+//Larger messages are split into MSG_FRAGMENT frames, the receiver puts them back together up to this size
+#define IPC_MAX_REASSEMBLED_SIZE (1u << 30)
+//Reassembled messages that wait for dispatch_msg at the same time
+#define IPC_MAX_REASSEMBLED 16
+//Frames inside a MSG_COALESCED start at 4-byte offsets, so their int32 keys stay aligned
+#define MSG_COALESCED_ALIGN(len) (((len) + 3) & ~(size_t)3)
+
+typedef struct{
+    int receiver_id;
+    const void *msg;
+    size_t msg_len;
+} IPCOutMsg;
+
+typedef void (*MsgHandler)(const MsgHeader *hdr, const char *payload);
+
+//What ipc_print_stats prints, for the results records
+typedef struct{
+    const char *transport;
+    uint64_t frames_sent;
+    uint64_t frames_received;
+    uint64_t syscalls;
+} IPCStats;
 
 int initiate_communication(int process_id);
-int send_msg(int sender_id, int receiver_id, const char *msg);
+int reinitiate_communication(int process_id, int inherited_fd);
+int send_msg(int sender_id, int receiver_id, const void *msg, size_t msg_len);
 int receive_msg(int fd, char *buf, size_t buf_size);
+int send_msg_batch(int sender_id, const IPCOutMsg *msgs, int num_msgs);
+int receive_msg_batch(int fd, char **bufs, size_t buf_size, int *lens, int max_msgs);
+int ipc_wait(int fd, int timeout_ms);
+int ipc_pending();
+int ipc_flush(int fd, int timeout_ms);
+void ipc_print_stats(FILE *fp);
+void ipc_get_stats(IPCStats *stats);
+void ipc_rejoin(int num_peers);
 void close_communication(int process_id, int fd);
 void cleanup_ipc();
+//In-process mode (IPC_TRANSPORT=thread, see IPC_thread.c): the nodes are threads of the manager that run until
+//ipc_threads_stop, which also wakes up every thread blocked in ipc_wait
+int ipc_in_process();
+void ipc_threads_stop();
+int ipc_threads_stopping();
+
+size_t encode_msg(char *buf, size_t buf_size, MsgType type, int sender_id, uint32_t request_id, int32_t arg, const void *payload, size_t payload_len);
+int decode_msg(const char *buf, size_t len, MsgHeader *hdr, const char **payload);
+const int *msg_keys(const MsgHeader *hdr, const char *payload, int *num_keys);
+int send_frame(int sender_id, int receiver_id, MsgType type, uint32_t request_id, int32_t arg, const void *payload, size_t payload_len);
+int send_key_frame(int sender_id, int receiver_id, MsgType type, uint32_t request_id, int32_t arg, int key);
+int send_frame_batch(int sender_id, const int *receivers, int num_receivers, MsgType type, uint32_t request_id, int32_t arg, const void *payload, size_t payload_len);
+int send_key_frame_batch(int sender_id, const int *receivers, int num_receivers, MsgType type, uint32_t request_id, int32_t arg, int key);
+int send_keys(int sender_id, int receiver_id, MsgType type, int32_t arg, const int *keys, int num_keys);
+int ipc_memfd_create(const char *name, size_t size, void **addr);
+int ipc_memfd_seal(int fd, void *addr, size_t size);
+const void *ipc_memfd_map(int fd, size_t *size);
+void ipc_memfd_unmap(const void *addr, size_t size);
+int msg_fd(const MsgHeader *hdr, const char *payload);
+int send_fd_frame(int sender_id, const int *receivers, int num_receivers, MsgType type, uint32_t request_id, int32_t arg, int fd, uint16_t flags);
+int send_keys_shared(int sender_id, const int *receivers, int num_receivers, MsgType type, int32_t arg, const int *keys, int num_keys);
+int dispatch_msg(const MsgHandler *handlers, const char *buf, size_t len);
+const char *msg_type_name(int type);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,277 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "IPC.h"
+#include "IPC_shm.h"
+
+#define SHM_NAME_FORMAT "/dist_cache_proc_%d"
+//Senders with a ring in every region, higher ids (a large fleet, its load generator clients) go over the socket
+#define SHM_MAX_SENDERS 65
+#define SHM_RING_BYTES (1 << 20)
+#define SHM_RECORD_HEADER 8
+#define SHM_WRAP_MARKER 0xFFFFFFFFu
+#define CACHE_LINE 64
+//The futex doesn't wake up for the Unix socket, so socket frames are picked up at the latest after this long
+#define SHM_SOCKET_CHECK_MS 10
+
+//head is only written by the producer and tail only by the consumer, they live on separate cache lines
+typedef struct{
+    _Atomic uint64_t head;
+    char pad_head[CACHE_LINE - sizeof(uint64_t)];
+    _Atomic uint64_t tail;
+    char pad_tail[CACHE_LINE - sizeof(uint64_t)];
+    char data[SHM_RING_BYTES];
+} ShmRing;
+
+typedef struct{
+    _Atomic uint32_t doorbell;
+    _Atomic uint32_t consumer_idle;
+    _Atomic int32_t num_senders;
+    _Atomic uint32_t closed;    //the receiver left, a node that binds its id later creates a new region
+    char pad[CACHE_LINE - 4 * sizeof(uint32_t)];
+    ShmRing rings[SHM_MAX_SENDERS];
+} ShmRegion;
+
+static ShmRegion *own_region = NULL;
+static ShmRegion *peer_regions[SHM_MAX_SENDERS];
+static int next_ring = 0;
+
+static size_t record_size(size_t msg_len){
+    return SHM_RECORD_HEADER + ((msg_len + 7) & ~(size_t)7);
+}
+
+static int futex_wait(_Atomic uint32_t *addr, uint32_t expected, int timeout_ms){
+    struct timespec ts;
+    ipc_num_syscalls++;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    return syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, expected, timeout_ms >= 0 ? &ts : NULL, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t *addr){
+    ipc_num_syscalls++;
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static ShmRegion *map_region(int process_id, int create){
+    char name[64];
+    snprintf(name, sizeof(name), SHM_NAME_FORMAT, process_id);
+
+    int flags = create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR;
+    int fd = shm_open(name, flags, 0666);
+    if(fd < 0){
+        if(create){
+            fprintf(stderr, "[ERROR HAPPENED] : Could not create shared memory region %s: %s\n", name, strerror(errno));
+        }
+        return NULL;
+    }
+    if(create && ftruncate(fd, sizeof(ShmRegion)) < 0){
+        fprintf(stderr, "[ERROR HAPPENED] : Could not size shared memory region %s: %s\n", name, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    //The receiver may still be sizing its region, treat it as not ready yet
+    struct stat st;
+    if(!create && (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ShmRegion))){
+        close(fd);
+        return NULL;
+    }
+    void *addr = mmap(NULL, sizeof(ShmRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED){
+        fprintf(stderr, "[ERROR HAPPENED] : Could not map shared memory region %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+    return (ShmRegion *)addr;
+}
+
+int shm_transport_init(int process_id){
+    for(int i = 0; i < SHM_MAX_SENDERS; i++){
+        peer_regions[i] = NULL;
+    }
+    own_region = map_region(process_id, 1);
+    return own_region != NULL ? 0 : -1;
+}
+
+//Returns IPC_SEND_UNAVAILABLE when the receiver has no region yet, so the caller can fall back to the socket
+int shm_transport_send(int sender_id, int receiver_id, const void *msg, size_t msg_len){
+    if(sender_id < 0 || sender_id >= SHM_MAX_SENDERS || receiver_id < 0 || receiver_id >= SHM_MAX_SENDERS){
+        return IPC_SEND_UNAVAILABLE;
+    }
+    //Load generator clients of every phase reuse the same ids, the region we still have mapped may be the last one's
+    if(peer_regions[receiver_id] != NULL && atomic_load_explicit(&peer_regions[receiver_id]->closed, memory_order_acquire)){
+        munmap(peer_regions[receiver_id], sizeof(ShmRegion));
+        peer_regions[receiver_id] = NULL;
+    }
+    if(peer_regions[receiver_id] == NULL){
+        peer_regions[receiver_id] = map_region(receiver_id, 0);
+        if(peer_regions[receiver_id] == NULL){
+            return IPC_SEND_UNAVAILABLE;
+        }
+    }
+    ShmRegion *region = peer_regions[receiver_id];
+    ShmRing *ring = &region->rings[sender_id];
+
+    int32_t senders = atomic_load_explicit(&region->num_senders, memory_order_relaxed);
+    while(senders < sender_id + 1 && !atomic_compare_exchange_weak(&region->num_senders, &senders, sender_id + 1)){
+    }
+
+    size_t need = record_size(msg_len);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t offset = head % SHM_RING_BYTES;
+    size_t contiguous = SHM_RING_BYTES - offset;
+    size_t total = need > contiguous ? contiguous + need : need;
+
+    if(head + total - tail > SHM_RING_BYTES){
+        return IPC_SEND_RETRY;
+    }
+    if(need > contiguous){
+        uint32_t marker = SHM_WRAP_MARKER;
+        memcpy(ring->data + offset, &marker, sizeof(marker));
+        head += contiguous;
+        offset = 0;
+    }
+    uint32_t len = (uint32_t)msg_len;
+    memcpy(ring->data + offset, &len, sizeof(len));
+    memcpy(ring->data + offset + SHM_RECORD_HEADER, msg, msg_len);
+    atomic_store_explicit(&ring->head, head + need, memory_order_release);
+
+    //Pairs with the fence in shm_transport_wait: either the consumer sees the new head or we see it idle
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&region->consumer_idle, memory_order_relaxed)){
+        atomic_fetch_add(&region->doorbell, 1);
+        futex_wake(&region->doorbell);
+    }
+    return IPC_SEND_OK;
+}
+
+static int ring_receive(ShmRing *ring, char *buf, size_t buf_size){
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while(1){
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if(tail == head){
+            return 0;
+        }
+        size_t offset = tail % SHM_RING_BYTES;
+        uint32_t len;
+        memcpy(&len, ring->data + offset, sizeof(len));
+        if(len == SHM_WRAP_MARKER){
+            tail += SHM_RING_BYTES - offset;
+            atomic_store_explicit(&ring->tail, tail, memory_order_release);
+            continue;
+        }
+        size_t copy_len = len < buf_size - 1 ? len : buf_size - 1;
+        memcpy(buf, ring->data + offset + SHM_RECORD_HEADER, copy_len);
+        buf[copy_len] = '\0';
+        atomic_store_explicit(&ring->tail, tail + record_size(len), memory_order_release);
+        return (int)copy_len;
+    }
+}
+
+//Round robin over the rings of all senders that have attached, so one busy sender can't starve the others
+int shm_transport_receive(char *buf, size_t buf_size){
+    if(own_region == NULL){
+        return 0;
+    }
+    int senders = atomic_load_explicit(&own_region->num_senders, memory_order_acquire);
+    for(int i = 0; i < senders; i++){
+        int r = (next_ring + i) % senders;
+        int n = ring_receive(&own_region->rings[r], buf, buf_size);
+        if(n > 0){
+            next_ring = (r + 1) % senders;
+            return n;
+        }
+    }
+    return 0;
+}
+
+static int rings_empty(){
+    int senders = atomic_load_explicit(&own_region->num_senders, memory_order_acquire);
+    for(int i = 0; i < senders; i++){
+        ShmRing *ring = &own_region->rings[i];
+        if(atomic_load_explicit(&ring->head, memory_order_acquire) != atomic_load_explicit(&ring->tail, memory_order_relaxed)){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//Blocks on the doorbell futex until a producer rings it or the timeout expires; returns 1 if messages may be pending
+int shm_transport_wait(int timeout_ms){
+    if(own_region == NULL){
+        return 0;
+    }
+    uint32_t seq = atomic_load(&own_region->doorbell);
+    atomic_store(&own_region->consumer_idle, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    if(!rings_empty()){
+        atomic_store(&own_region->consumer_idle, 0);
+        return 1;
+    }
+    futex_wait(&own_region->doorbell, seq, timeout_ms);
+    atomic_store(&own_region->consumer_idle, 0);
+    return !rings_empty();
+}
+
+void shm_transport_close(int process_id){
+    char name[64];
+    for(int i = 0; i < SHM_MAX_SENDERS; i++){
+        if(peer_regions[i] != NULL){
+            munmap(peer_regions[i], sizeof(ShmRegion));
+            peer_regions[i] = NULL;
+        }
+    }
+    if(own_region != NULL){
+        atomic_store_explicit(&own_region->closed, 1, memory_order_release);
+        munmap(own_region, sizeof(ShmRegion));
+        own_region = NULL;
+    }
+    snprintf(name, sizeof(name), SHM_NAME_FORMAT, process_id);
+    shm_unlink(name);
+}
+
+static int shm_init(int process_id, int socket_fd){
+    return shm_transport_init(process_id);
+}
+
+static int shm_send(int sender_id, int receiver_id, const void *msg, size_t msg_len, int fd){
+    return shm_transport_send(sender_id, receiver_id, msg, msg_len);
+}
+
+static int shm_receive(char *buf, size_t buf_size, int *received_fd){
+    *received_fd = -1;
+    return shm_transport_receive(buf, buf_size);
+}
+
+static int shm_wait(int timeout_ms, int has_pending){
+    int max_ms = has_pending ? IPC_PENDING_RETRY_MS : SHM_SOCKET_CHECK_MS;
+    if(timeout_ms < 0 || timeout_ms > max_ms){
+        timeout_ms = max_ms;
+    }
+    return shm_transport_wait(timeout_ms);
+}
+
+//Rings can't carry descriptors, IPC.c sends them ahead of the frame over the socket
+const IPCTransport shm_transport = {
+    .name = "shm",
+    .passes_fds = 0,
+    .init = shm_init,
+    .send = shm_send,
+    .send_batch = NULL,
+    .receive = shm_receive,
+    .receive_batch = NULL,
+    .wait = shm_wait,
+    .close = shm_transport_close,
+};
@@ -0,0 +1,18 @@
+#ifndef IPC_SHM_H
+
+#define IPC_SHM_H
+#include <stddef.h>
+#include "IPC_transport.h"
+
+//Shared-memory transport: one lock-free single-producer/single-consumer ring per (sender, receiver) pair
+//Every receiver owns one region (/dev/shm/dist_cache_proc_<id>) that holds the rings of all its senders
+//The consumer is only woken up with a futex when it announced that it is idle, otherwise no syscall is made
+//shm_transport_send returns IPC_SEND_UNAVAILABLE while the receiver has no region yet (the frame goes over the socket then)
+
+int shm_transport_init(int process_id);
+int shm_transport_send(int sender_id, int receiver_id, const void *msg, size_t msg_len);
+int shm_transport_receive(char *buf, size_t buf_size);
+int shm_transport_wait(int timeout_ms);
+void shm_transport_close(int process_id);
+
+#endif
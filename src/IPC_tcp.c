@@ -0,0 +1,421 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "IPC.h"
+#include "IPC_transport.h"
+
+//Loopback TCP backend: process <id> listens on 127.0.0.1:(IPC_TCP_BASE_PORT + id)
+//Every sender keeps one persistent connection per receiver (TCP_NODELAY, so small frames aren't held back by Nagle)
+//and writes each frame with a 4-byte length prefix; the receiver cuts the byte stream back into frames
+//Descriptors can't travel over TCP, IPC.c sends them ahead of their frame over the Unix socket
+
+#define TCP_DEFAULT_BASE_PORT 47000
+#define TCP_PREFIX_SIZE sizeof(uint32_t)
+#define TCP_MAX_FRAME (TCP_PREFIX_SIZE + IPC_MAX_MSG_SIZE)
+#define TCP_IN_BUF_SIZE (4 * TCP_MAX_FRAME)
+#define TCP_MAX_CONNS (MAX_PROCESSES + 1)
+//Marks the epoll entries of outgoing connections, their receiver id is in the low bits
+#define TCP_OUT_CONN_TAG (1ULL << 32)
+
+//Incoming connection, in_buf[start, end) holds bytes that were read but not handed out yet
+typedef struct{
+    int fd;
+    size_t start;
+    size_t end;
+    char *in_buf;
+} TcpConn;
+
+static int base_port = TCP_DEFAULT_BASE_PORT;
+static int listen_fd = -1;
+static int tcp_epoll_fd = -1;
+static int unix_fd = -1;
+
+static TcpConn conns[TCP_MAX_CONNS];
+static int num_conns = 0;
+static int next_conn = 0;
+
+//Outgoing connections, out_rest holds the tail of a frame the kernel only took partly
+static int out_fds[MAX_PROCESSES + 1];
+static char *out_rest[MAX_PROCESSES + 1];
+static size_t out_rest_len[MAX_PROCESSES + 1];
+
+static void fill_tcp_addr(int process_id, struct sockaddr_in *addr){
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(base_port + process_id);
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+static int tcp_init(int process_id, int socket_fd){
+    struct sockaddr_in addr;
+    struct epoll_event ev;
+    int one = 1;
+    const char *port_env = getenv("IPC_TCP_BASE_PORT");
+
+    if(port_env != NULL && atoi(port_env) > 0){
+        base_port = atoi(port_env);
+    }
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        out_fds[i] = -1;
+        out_rest[i] = NULL;
+        out_rest_len[i] = 0;
+    }
+    num_conns = 0;
+    unix_fd = socket_fd;
+
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listen_fd < 0){
+        perror("[ERROR HAPPENED] : Could not create the TCP listen socket");
+        return -1;
+    }
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    fill_tcp_addr(process_id, &addr);
+    if(bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, TCP_MAX_CONNS) < 0){
+        fprintf(stderr, "[ERROR HAPPENED] : Could not listen on 127.0.0.1:%d: %s\n", base_port + process_id, strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+
+    tcp_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(tcp_epoll_fd < 0){
+        perror("[ERROR HAPPENED] : Could not create epoll instance");
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd;
+    epoll_ctl(tcp_epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+    //The Unix socket still brings descriptors and frames of receivers without TCP, so it wakes us up as well
+    ev.data.fd = unix_fd;
+    epoll_ctl(tcp_epoll_fd, EPOLL_CTL_ADD, unix_fd, &ev);
+    return 0;
+}
+
+//Connects once per receiver; connect on loopback completes right away, so it is done blocking
+//Returns -1 while the receiver isn't listening yet
+static int get_out_conn(int receiver_id){
+    struct sockaddr_in addr;
+    int one = 1;
+    if(out_fds[receiver_id] >= 0){
+        return out_fds[receiver_id];
+    }
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+        perror("[ERROR HAPPENED] : Could not create a TCP socket");
+        return -1;
+    }
+    fill_tcp_addr(receiver_id, &addr);
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+        if(errno != ECONNREFUSED){
+            perror("[ERROR HAPPENED] : Could not connect to the peer");
+        }
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    //A receiver that left closes its end; load generator clients of the next phase listen under the same id, and a frame
+    //written into the old connection before the reset comes back would be lost
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLRDHUP;
+    ev.data.u64 = TCP_OUT_CONN_TAG | (uint64_t)receiver_id;
+    epoll_ctl(tcp_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    out_fds[receiver_id] = fd;
+    return fd;
+}
+
+static void drop_out_conn(int receiver_id){
+    epoll_ctl(tcp_epoll_fd, EPOLL_CTL_DEL, out_fds[receiver_id], NULL);
+    close(out_fds[receiver_id]);
+    out_fds[receiver_id] = -1;
+    out_rest_len[receiver_id] = 0;
+}
+
+//Writes what is left of a partly sent frame, returns 1 once nothing is left
+static int flush_rest(int receiver_id){
+    while(out_rest_len[receiver_id] > 0){
+        ipc_num_syscalls++;
+        ssize_t n = send(out_fds[receiver_id], out_rest[receiver_id], out_rest_len[receiver_id], MSG_NOSIGNAL);
+        if(n < 0){
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                perror("[ERROR HAPPENED] : Sending the rest of a frame failed");
+                drop_out_conn(receiver_id);
+            }
+            return 0;
+        }
+        memmove(out_rest[receiver_id], out_rest[receiver_id] + n, out_rest_len[receiver_id] - n);
+        out_rest_len[receiver_id] -= n;
+    }
+    return 1;
+}
+
+//A frame is only refused as a whole: once its first byte is in the stream the rest is kept here and sent before the next frame
+static int tcp_send(int sender_id, int receiver_id, const void *msg, size_t msg_len, int fd){
+    int sock = get_out_conn(receiver_id);
+    if(sock < 0){
+        return IPC_SEND_RETRY;
+    }
+    if(out_rest_len[receiver_id] > 0 && !flush_rest(receiver_id)){
+        return IPC_SEND_RETRY;
+    }
+    if(out_fds[receiver_id] < 0){
+        return IPC_SEND_RETRY;
+    }
+
+    uint32_t prefix = (uint32_t)msg_len;
+    struct iovec iov[2] = {{&prefix, TCP_PREFIX_SIZE}, {(void *)msg, msg_len}};
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = 2;
+    ipc_num_syscalls++;
+    ssize_t n = sendmsg(sock, &mh, MSG_NOSIGNAL);
+    if(n < 0){
+        if(errno == EAGAIN || errno == EWOULDBLOCK){
+            return IPC_SEND_RETRY;
+        }
+        if(errno == EPIPE || errno == ECONNRESET){
+            drop_out_conn(receiver_id);
+            return IPC_SEND_RETRY;
+        }
+        perror("[ERROR HAPPENED] : Sending the message failed");
+        return IPC_SEND_ERROR;
+    }
+
+    size_t total = TCP_PREFIX_SIZE + msg_len;
+    if((size_t)n < total){
+        if(out_rest[receiver_id] == NULL && (out_rest[receiver_id] = malloc(TCP_MAX_FRAME)) == NULL){
+            fprintf(stderr, "[ERROR HAPPENED] : Could not keep the rest of a frame, dropping the connection\n");
+            drop_out_conn(receiver_id);
+            return IPC_SEND_ERROR;
+        }
+        size_t skip = (size_t)n;
+        size_t len = 0;
+        if(skip < TCP_PREFIX_SIZE){
+            memcpy(out_rest[receiver_id], (char *)&prefix + skip, TCP_PREFIX_SIZE - skip);
+            len = TCP_PREFIX_SIZE - skip;
+            skip = 0;
+        } else{
+            skip -= TCP_PREFIX_SIZE;
+        }
+        memcpy(out_rest[receiver_id] + len, (const char *)msg + skip, msg_len - skip);
+        out_rest_len[receiver_id] = len + msg_len - skip;
+    }
+    return IPC_SEND_OK;
+}
+
+static void accept_conns(){
+    while(1){
+        ipc_num_syscalls++;
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0){
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                perror("[ERROR HAPPENED] : Could not accept a connection");
+            }
+            return;
+        }
+        char *in_buf = malloc(TCP_IN_BUF_SIZE);
+        if(num_conns >= TCP_MAX_CONNS || in_buf == NULL){
+            fprintf(stderr, "[ERROR HAPPENED] : Too many TCP connections\n");
+            free(in_buf);
+            close(fd);
+            continue;
+        }
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(tcp_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        conns[num_conns].fd = fd;
+        conns[num_conns].start = conns[num_conns].end = 0;
+        conns[num_conns].in_buf = in_buf;
+        num_conns++;
+    }
+}
+
+static void drop_conn(int i){
+    epoll_ctl(tcp_epoll_fd, EPOLL_CTL_DEL, conns[i].fd, NULL);
+    close(conns[i].fd);
+    free(conns[i].in_buf);
+    conns[i] = conns[--num_conns];
+}
+
+//Length of the complete frame at the start of the buffer, 0 if it isn't complete yet and -1 if the stream is broken
+static long buffered_frame(const TcpConn *c){
+    uint32_t len;
+    if(c->end - c->start < TCP_PREFIX_SIZE){
+        return 0;
+    }
+    memcpy(&len, c->in_buf + c->start, TCP_PREFIX_SIZE);
+    if(len > IPC_MAX_MSG_SIZE){
+        return -1;
+    }
+    return c->end - c->start >= TCP_PREFIX_SIZE + len ? (long)len : 0;
+}
+
+//Reads as much as fits, so one syscall usually brings many frames; returns 0 if the peer closed the connection
+static int fill_conn(TcpConn *c){
+    if(c->start > 0){
+        memmove(c->in_buf, c->in_buf + c->start, c->end - c->start);
+        c->end -= c->start;
+        c->start = 0;
+    }
+    ipc_num_syscalls++;
+    ssize_t n = recv(c->fd, c->in_buf + c->end, TCP_IN_BUF_SIZE - c->end, MSG_DONTWAIT);
+    if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)){
+        return 0;
+    }
+    if(n > 0){
+        c->end += n;
+    }
+    return 1;
+}
+
+//Hands out one buffered frame, round robin over the connections so one busy sender can't starve the others
+static int take_frame(char *buf, size_t buf_size){
+    for(int k = 0; k < num_conns; k++){
+        int i = (next_conn + k) % num_conns;
+        TcpConn *c = &conns[i];
+        long len = buffered_frame(c);
+        if(len < 0){
+            fprintf(stderr, "[ERROR HAPPENED] : Broken frame stream, dropping the connection\n");
+            drop_conn(i);
+            return 0;
+        }
+        if(len == 0){
+            continue;
+        }
+        size_t copy_len = (size_t)len < buf_size - 1 ? (size_t)len : buf_size - 1;
+        memcpy(buf, c->in_buf + c->start + TCP_PREFIX_SIZE, copy_len);
+        buf[copy_len] = '\0';
+        c->start += TCP_PREFIX_SIZE + len;
+        next_conn = (i + 1) % num_conns;
+        return (int)copy_len;
+    }
+    return 0;
+}
+
+//Buffered frames first, then one epoll_wait without timeout tells which connections have data (instead of a read per connection)
+static int tcp_receive(char *buf, size_t buf_size, int *received_fd){
+    struct epoll_event events[TCP_MAX_CONNS + 2];
+    *received_fd = -1;
+    if(listen_fd < 0){
+        return 0;
+    }
+    int n = take_frame(buf, buf_size);
+    if(n > 0){
+        return n;
+    }
+
+    ipc_num_syscalls++;
+    int ready = epoll_wait(tcp_epoll_fd, events, TCP_MAX_CONNS + 2, 0);
+    for(int e = 0; e < ready; e++){
+        if(events[e].data.u64 & TCP_OUT_CONN_TAG){
+            int receiver_id = (int)(uint32_t)events[e].data.u64;
+            if((events[e].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && out_fds[receiver_id] >= 0){
+                drop_out_conn(receiver_id);
+            }
+            continue;
+        }
+        int fd = events[e].data.fd;
+        if(fd == listen_fd){
+            accept_conns();
+            continue;
+        }
+        for(int i = 0; i < num_conns; i++){
+            if(conns[i].fd == fd){
+                if(!fill_conn(&conns[i])){
+                    drop_conn(i);
+                }
+                break;
+            }
+        }
+    }
+    return take_frame(buf, buf_size);
+}
+
+static int frames_buffered(){
+    for(int i = 0; i < num_conns; i++){
+        if(buffered_frame(&conns[i]) != 0){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//Watches the connections with a partly sent frame, so we wake up once the receiver read some of the stream
+static void watch_blocked_conns(int add){
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = add ? EPOLLOUT | EPOLLRDHUP : EPOLLRDHUP;
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        if(out_rest_len[i] > 0 && out_fds[i] >= 0){
+            ev.data.u64 = TCP_OUT_CONN_TAG | (uint64_t)i;
+            epoll_ctl(tcp_epoll_fd, EPOLL_CTL_MOD, out_fds[i], &ev);
+        }
+    }
+}
+
+static int tcp_wait(int timeout_ms, int has_pending){
+    struct epoll_event events[2 * TCP_MAX_CONNS + 2];
+    if(frames_buffered()){
+        return 1;
+    }
+    //Queued messages may wait for a receiver that isn't listening yet, which no descriptor tells us about
+    if(has_pending && (timeout_ms < 0 || timeout_ms > IPC_PENDING_RETRY_MS)){
+        timeout_ms = IPC_PENDING_RETRY_MS;
+    }
+    watch_blocked_conns(1);
+    ipc_num_syscalls++;
+    int ready = epoll_wait(tcp_epoll_fd, events, 2 * TCP_MAX_CONNS + 2, timeout_ms);
+    watch_blocked_conns(0);
+    return ready > 0;
+}
+
+static void tcp_close(int process_id){
+    while(num_conns > 0){
+        drop_conn(num_conns - 1);
+    }
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        if(out_fds[i] >= 0){
+            drop_out_conn(i);
+        }
+        free(out_rest[i]);
+        out_rest[i] = NULL;
+    }
+    if(listen_fd >= 0){
+        close(listen_fd);
+        listen_fd = -1;
+    }
+    if(tcp_epoll_fd >= 0){
+        close(tcp_epoll_fd);
+        tcp_epoll_fd = -1;
+    }
+}
+
+const IPCTransport tcp_transport = {
+    .name = "tcp",
+    .passes_fds = 0,
+    .init = tcp_init,
+    .send = tcp_send,
+    .send_batch = NULL,
+    .receive = tcp_receive,
+    .receive_batch = NULL,
+    .wait = tcp_wait,
+    .close = tcp_close,
+};
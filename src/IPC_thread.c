@@ -0,0 +1,305 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "IPC.h"
+#include "IPC_transport.h"
+
+//In-process backend (IPC_TRANSPORT=thread): every node is a thread of the manager and owns a mailbox, a FIFO of
+//frames behind a mutex; a sender copies the frame into the receiver's mailbox and signals its condition variable
+//only when the receiver sleeps in wait. Nothing goes through the kernel except those wakeups, so what the nodes
+//measure is the cost of their summaries and handlers rather than of sockets and context switches
+//Descriptors travel like with SCM_RIGHTS, so sealed memfds (key segments, Bloom filters) work as with the other
+//backends and the receiving thread maps the same pages the sender filled. All nodes share one descriptor table, so a
+//buffer broadcast to every peer is held once by its frames and each receiver only gets its own dup when it takes one
+
+typedef struct{
+    int fd;
+    int refs;
+    dev_t dev;
+    ino_t ino;
+} ThreadFd;
+
+typedef struct ThreadFrame{
+    struct ThreadFrame *next;
+    ThreadFd *fd;               //NULL without a descriptor
+    size_t len;
+    char data[];
+} ThreadFrame;
+
+typedef struct{
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    ThreadFrame *head;
+    ThreadFrame *tail;
+    int open;                   //the owner called init and not yet close
+    int sleeping;               //the owner waits on ready
+} ThreadMailbox;
+
+static ThreadMailbox mailboxes[MAX_PROCESSES + 1];
+static pthread_once_t mailboxes_once = PTHREAD_ONCE_INIT;
+static int stopping = 0;
+
+static __thread ThreadMailbox *own_box = NULL;
+//The descriptor this thread passed last, the frames of one broadcast share it
+static __thread ThreadFd *last_passed = NULL;
+
+static void init_mailboxes(){
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        pthread_mutex_init(&mailboxes[i].lock, NULL);
+        pthread_cond_init(&mailboxes[i].ready, &attr);
+        mailboxes[i].head = NULL;
+        mailboxes[i].tail = NULL;
+        mailboxes[i].open = 0;
+        mailboxes[i].sleeping = 0;
+    }
+    pthread_condattr_destroy(&attr);
+}
+
+static void release_fd(ThreadFd *shared){
+    if(shared != NULL && __atomic_sub_fetch(&shared->refs, 1, __ATOMIC_ACQ_REL) == 0){
+        close(shared->fd);
+        free(shared);
+    }
+}
+
+//A reference to fd for one more frame, the same one as long as the sender passes the same buffer
+static ThreadFd *pass_fd(int fd){
+    struct stat st;
+    if(fstat(fd, &st) < 0){
+        return NULL;
+    }
+    if(last_passed == NULL || last_passed->dev != st.st_dev || last_passed->ino != st.st_ino){
+        ThreadFd *shared = malloc(sizeof(ThreadFd));
+        if(shared == NULL){
+            return NULL;
+        }
+        if((shared->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0)) < 0){
+            free(shared);
+            return NULL;
+        }
+        shared->refs = 1;
+        shared->dev = st.st_dev;
+        shared->ino = st.st_ino;
+        release_fd(last_passed);
+        last_passed = shared;
+    }
+    __atomic_add_fetch(&last_passed->refs, 1, __ATOMIC_RELAXED);
+    return last_passed;
+}
+
+static void free_frame(ThreadFrame *frame){
+    release_fd(frame->fd);
+    free(frame);
+}
+
+static int thread_init(int process_id, int socket_fd){
+    pthread_once(&mailboxes_once, init_mailboxes);
+    if(process_id < 0 || process_id > MAX_PROCESSES){
+        fprintf(stderr, "[ERROR HAPPENED] : No mailbox for id %d\n", process_id);
+        return -1;
+    }
+    own_box = &mailboxes[process_id];
+    pthread_mutex_lock(&own_box->lock);
+    own_box->open = 1;
+    pthread_mutex_unlock(&own_box->lock);
+    return 0;
+}
+
+//A receiver that has no open mailbox yet is retried from the pending queue, like a socket that isn't bound yet
+static int thread_send(int sender_id, int receiver_id, const void *msg, size_t msg_len, int fd){
+    if(receiver_id < 0 || receiver_id > MAX_PROCESSES){
+        return IPC_SEND_ERROR;
+    }
+    pthread_once(&mailboxes_once, init_mailboxes);
+    ThreadMailbox *box = &mailboxes[receiver_id];
+    if(!__atomic_load_n(&box->open, __ATOMIC_ACQUIRE)){
+        return IPC_SEND_RETRY;
+    }
+    ThreadFrame *frame = malloc(sizeof(ThreadFrame) + msg_len);
+    if(frame == NULL){
+        return IPC_SEND_RETRY;
+    }
+    frame->next = NULL;
+    frame->len = msg_len;
+    frame->fd = NULL;
+    memcpy(frame->data, msg, msg_len);
+    if(fd >= 0 && (frame->fd = pass_fd(fd)) == NULL){
+        fprintf(stderr, "[ERROR HAPPENED] : Could not pass a descriptor to %d: %s\n", receiver_id, strerror(errno));
+        free(frame);
+        return IPC_SEND_ERROR;
+    }
+
+    pthread_mutex_lock(&box->lock);
+    if(!box->open){
+        pthread_mutex_unlock(&box->lock);
+        free_frame(frame);
+        return IPC_SEND_RETRY;
+    }
+    if(box->tail != NULL){
+        box->tail->next = frame;
+    } else{
+        box->head = frame;
+    }
+    box->tail = frame;
+    int wake = box->sleeping;
+    pthread_mutex_unlock(&box->lock);
+    if(wake){
+        ipc_num_syscalls++;
+        pthread_cond_signal(&box->ready);
+    }
+    return IPC_SEND_OK;
+}
+
+//Takes up to max frames off the mailbox with one lock round trip
+static ThreadFrame *take_frames(int max){
+    if(own_box == NULL || __atomic_load_n(&own_box->head, __ATOMIC_RELAXED) == NULL){
+        return NULL;
+    }
+    pthread_mutex_lock(&own_box->lock);
+    ThreadFrame *first = own_box->head;
+    ThreadFrame *last = first;
+    for(int n = 1; last != NULL && n < max; n++){
+        if(last->next == NULL){
+            break;
+        }
+        last = last->next;
+    }
+    if(last != NULL){
+        own_box->head = last->next;
+        if(own_box->head == NULL){
+            own_box->tail = NULL;
+        }
+        last->next = NULL;
+    }
+    pthread_mutex_unlock(&own_box->lock);
+    return first;
+}
+
+//Frames are at most IPC_MAX_MSG_SIZE, the receive buffers of IPC.c hold that and the terminating zero
+static int copy_frame(ThreadFrame *frame, char *buf, size_t buf_size, int *received_fd){
+    size_t len = frame->len < buf_size - 1 ? frame->len : buf_size - 1;
+    memcpy(buf, frame->data, len);
+    buf[len] = '\0';
+    *received_fd = -1;
+    if(frame->fd != NULL && (*received_fd = fcntl(frame->fd->fd, F_DUPFD_CLOEXEC, 0)) < 0){
+        fprintf(stderr, "[ERROR HAPPENED] : Could not take a passed descriptor: %s\n", strerror(errno));
+    }
+    free_frame(frame);
+    return (int)len;
+}
+
+static int thread_receive(char *buf, size_t buf_size, int *received_fd){
+    *received_fd = -1;
+    ThreadFrame *frame = take_frames(1);
+    return frame != NULL ? copy_frame(frame, buf, buf_size, received_fd) : 0;
+}
+
+static int thread_receive_batch(char **bufs, size_t buf_size, int *lens, int *fds, int max_msgs){
+    ThreadFrame *frame = take_frames(max_msgs);
+    int n = 0;
+    while(frame != NULL){
+        ThreadFrame *next = frame->next;
+        lens[n] = copy_frame(frame, bufs[n], buf_size, &fds[n]);
+        n++;
+        frame = next;
+    }
+    return n;
+}
+
+static int thread_wait(int timeout_ms, int has_pending){
+    if(own_box == NULL){
+        return 0;
+    }
+    //A receiver that isn't up yet can't wake us, retry it after IPC_PENDING_RETRY_MS
+    if(has_pending && (timeout_ms < 0 || timeout_ms > IPC_PENDING_RETRY_MS)){
+        timeout_ms = IPC_PENDING_RETRY_MS;
+    }
+    pthread_mutex_lock(&own_box->lock);
+    if(own_box->head == NULL && !__atomic_load_n(&stopping, __ATOMIC_ACQUIRE) && timeout_ms != 0){
+        own_box->sleeping = 1;
+        ipc_num_syscalls++;
+        if(timeout_ms < 0){
+            pthread_cond_wait(&own_box->ready, &own_box->lock);
+        } else{
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += timeout_ms / 1000;
+            deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+            if(deadline.tv_nsec >= 1000000000L){
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&own_box->ready, &own_box->lock, &deadline);
+        }
+        own_box->sleeping = 0;
+    }
+    int ready = own_box->head != NULL;
+    pthread_mutex_unlock(&own_box->lock);
+    return ready;
+}
+
+//Frames still in the mailbox are dropped, senders that come later get IPC_SEND_RETRY
+static void thread_close(int process_id){
+    if(own_box == NULL){
+        return;
+    }
+    pthread_mutex_lock(&own_box->lock);
+    own_box->open = 0;
+    ThreadFrame *frame = own_box->head;
+    own_box->head = NULL;
+    own_box->tail = NULL;
+    pthread_mutex_unlock(&own_box->lock);
+    while(frame != NULL){
+        ThreadFrame *next = frame->next;
+        free_frame(frame);
+        frame = next;
+    }
+    release_fd(last_passed);
+    last_passed = NULL;
+    own_box = NULL;
+}
+
+//There is no socket next to the mailboxes, nothing to read there
+static int thread_socket_readable(){
+    return 0;
+}
+
+void ipc_threads_stop(){
+    pthread_once(&mailboxes_once, init_mailboxes);
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        pthread_mutex_lock(&mailboxes[i].lock);
+        pthread_cond_broadcast(&mailboxes[i].ready);
+        pthread_mutex_unlock(&mailboxes[i].lock);
+    }
+}
+
+int ipc_threads_stopping(){
+    return __atomic_load_n(&stopping, __ATOMIC_ACQUIRE);
+}
+
+const IPCTransport thread_transport = {
+    .name = "thread",
+    .passes_fds = 1,
+    .init = thread_init,
+    .send = thread_send,
+    .send_batch = NULL,
+    .receive = thread_receive,
+    .receive_batch = thread_receive_batch,
+    .wait = thread_wait,
+    .close = thread_close,
+    .socket_readable = thread_socket_readable,
+    .socket_drained = NULL,
+    .peer_replaced = NULL,
+};
@@ -0,0 +1,57 @@
+#ifndef IPC_TRANSPORT_H
+
+#define IPC_TRANSPORT_H
+#include <stddef.h>
+#include "IPC.h"
+
+//A transport moves whole frames between processes, everything above it (flow control, queueing, descriptors,
+//coalesced frames) lives in IPC.c and works the same for every backend
+//The backend is picked with IPC_TRANSPORT ("unix", "shm", "tcp", "uring" or "thread"), children inherit it from the manager
+//The Unix datagram socket is opened with every backend but "thread" (whose nodes all live in the manager): it carries
+//the descriptors of backends that can't pass them (see MSG_FD_CARRIER) and takes the frames a backend reports as
+//IPC_SEND_UNAVAILABLE
+
+//Results of send (and the per-message status of send_batch)
+#define IPC_SEND_OK 0
+#define IPC_SEND_RETRY 1            //receiver not up or full, the frame is queued and retried
+#define IPC_SEND_ERROR -1           //the frame is dropped
+#define IPC_SEND_UNAVAILABLE 2      //the backend can't reach this receiver, the frame goes over the Unix socket
+
+#define SOCKET_DIR "/tmp/distributed_cache_sockets"
+
+//How long ipc_wait sleeps at most while messages are queued for a receiver that can't be watched
+#define IPC_PENDING_RETRY_MS 1
+
+typedef struct{
+    const char *name;
+    int passes_fds;                 //send can attach a descriptor to the frame
+    //socket_fd is the Unix socket, backends that wait on their own should wake up for it as well
+    int (*init)(int process_id, int socket_fd);
+    int (*send)(int sender_id, int receiver_id, const void *msg, size_t msg_len, int fd);
+    //Optional, NULL sends the messages one by one; once a receiver failed, its later messages must not be sent either
+    int (*send_batch)(int sender_id, const IPCOutMsg *msgs, int num_msgs, int *status);
+    //Returns the frame length, 0 if there is nothing to read and -1 on errors; *received_fd is -1 without a descriptor
+    int (*receive)(char *buf, size_t buf_size, int *received_fd);
+    //Optional, NULL receives the messages one by one
+    int (*receive_batch)(char **bufs, size_t buf_size, int *lens, int *fds, int max_msgs);
+    //Blocks until a frame may be available or timeout_ms passes (-1 waits forever)
+    int (*wait)(int timeout_ms, int has_pending);
+    void (*close)(int process_id);
+    //Optional, for backends that are told when the Unix socket has data: socket_readable says whether it is worth reading
+    //and socket_drained is called once a read found it empty (NULL reads the socket on every receive)
+    int (*socket_readable)();
+    void (*socket_drained)();
+    //Optional: another node took over receiver_id (ipc_rejoin), drop connections that may still lead to the old one
+    void (*peer_replaced)(int receiver_id);
+} IPCTransport;
+
+extern const IPCTransport unix_transport;
+extern const IPCTransport shm_transport;
+extern const IPCTransport tcp_transport;
+extern const IPCTransport uring_transport;
+extern const IPCTransport thread_transport;
+
+//Syscalls the backends made to move frames (sends, receives, waits), reported by ipc_print_stats
+extern __thread uint64_t ipc_num_syscalls;
+
+#endif
@@ -0,0 +1,657 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <linux/io_uring.h>
+#include "IPC.h"
+#include "IPC_transport.h"
+
+//io_uring backend, driven with the raw syscalls (no liburing)
+//Every process binds a second datagram socket (proc_<id>.uring.sock) with one multishot receive armed on it:
+//the kernel drops each datagram into a buffer of a registered buffer ring and posts a completion,
+//so receiving is a read of the completion ring without any syscall
+//Sends are copied and queued as SQEs, one io_uring_enter submits everything queued so far (a whole batch with send_batch)
+//Only one send per receiver is in flight, the next one is submitted when its completion comes back, which keeps the order
+//(a receiver with room completes it right away, only a full one holds up the sends behind it)
+//A multishot poll on the Unix socket tells us when descriptors or fallback frames arrived there
+//IPC_URING_SQPOLL=1 lets a kernel thread pick up the SQEs, then sends need no syscall either
+
+#define URING_ENTRIES 256
+#define URING_CQ_ENTRIES 1024
+#define URING_NUM_BUFS 64
+#define URING_BUF_SIZE IPC_MAX_MSG_SIZE
+#define URING_BUF_GROUP 0
+#define URING_SQPOLL_IDLE_MS 1000
+//How long close waits for the queued sends to go out
+#define URING_CLOSE_DRAIN_MS 1000
+#define URING_SOCKET_FORMAT "%s/proc_%d.uring.sock"
+
+//user_data of the multishot requests, everything else is a pointer to a UringSend
+#define URING_TAG_RECV 1
+#define URING_TAG_POLL 2
+
+typedef struct UringSend{
+    struct UringSend *next;
+    int receiver_id;
+    size_t len;
+    char data[];
+} UringSend;
+
+//head is the send in flight (if in_flight), the rest waits for it
+typedef struct{
+    UringSend *head;
+    UringSend *tail;
+    int in_flight;
+    int reconnect;              //the receiver was replaced while a send was in flight, connect again once it is done
+} UringPeer;
+
+static int ring_fd = -1;
+static struct io_uring_params params;
+static void *sq_ptr = NULL;
+static void *cq_ptr = NULL;
+static size_t sq_size = 0;
+static size_t cq_size = 0;
+static struct io_uring_sqe *sqes = NULL;
+static uint32_t *sq_head, *sq_tail, *sq_mask, *sq_array, *sq_flags;
+static uint32_t *cq_head, *cq_tail, *cq_mask;
+static struct io_uring_cqe *cqes;
+static uint32_t to_submit = 0;
+
+static struct io_uring_buf_ring *buf_ring = NULL;
+static size_t buf_ring_size = 0;
+static char *recv_bufs = NULL;
+static uint16_t buf_tail = 0;
+
+static int recv_fd = -1;
+static int unix_fd = -1;
+static int own_id = -1;
+static int recv_armed = 0;
+static int poll_armed = 0;
+static int socket_flag = 1;
+
+//Received frames still sitting in their buffers, oldest first
+static uint16_t ready_bids[URING_NUM_BUFS];
+static int ready_lens[URING_NUM_BUFS];
+static int ready_first = 0;
+static int num_ready = 0;
+
+static int peer_fds[MAX_PROCESSES + 1];
+static UringPeer peers[MAX_PROCESSES + 1];
+
+static void uring_path(int process_id, char *path, size_t size){
+    snprintf(path, size, URING_SOCKET_FORMAT, SOCKET_DIR, process_id);
+}
+
+//timeout_ms only matters when we wait for completions (-1 waits forever)
+static int uring_enter(unsigned submit, unsigned wait_nr, unsigned flags, int timeout_ms){
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    void *argp = NULL;
+    size_t argsz = 0;
+    if(wait_nr > 0 && timeout_ms >= 0){
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        argp = &arg;
+        argsz = sizeof(arg);
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+    ipc_num_syscalls++;
+    return syscall(__NR_io_uring_enter, ring_fd, submit, wait_nr, flags, argp, argsz);
+}
+
+static void submit(){
+    if(to_submit == 0){
+        return;
+    }
+    if(params.flags & IORING_SETUP_SQPOLL){
+        //The kernel thread sleeps after URING_SQPOLL_IDLE_MS without work and has to be woken up
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if(__atomic_load_n(sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP){
+            uring_enter(0, 0, IORING_ENTER_SQ_WAKEUP, -1);
+        }
+        to_submit = 0;
+        return;
+    }
+    int ret = uring_enter(to_submit, 0, 0, -1);
+    if(ret < 0){
+        if(errno != EAGAIN && errno != EBUSY && errno != EINTR){
+            perror("[ERROR HAPPENED] : io_uring_enter failed");
+        }
+        return;
+    }
+    to_submit -= ret;
+}
+
+//Free SQE or NULL if the submission queue is full; it is handed to the kernel with commit_sqe
+static struct io_uring_sqe *get_sqe(){
+    uint32_t tail = *sq_tail;
+    if(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries){
+        submit();
+        if(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries){
+            return NULL;
+        }
+    }
+    uint32_t idx = tail & *sq_mask;
+    memset(&sqes[idx], 0, sizeof(sqes[idx]));
+    sq_array[idx] = idx;
+    return &sqes[idx];
+}
+
+static void commit_sqe(){
+    __atomic_store_n(sq_tail, *sq_tail + 1, __ATOMIC_RELEASE);
+    to_submit++;
+}
+
+static void provide_buf(uint16_t bid){
+    struct io_uring_buf *buf = &buf_ring->bufs[buf_tail & (URING_NUM_BUFS - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(recv_bufs + (size_t)bid * URING_BUF_SIZE);
+    buf->len = URING_BUF_SIZE;
+    buf->bid = bid;
+    buf_tail++;
+    __atomic_store_n(&buf_ring->tail, buf_tail, __ATOMIC_RELEASE);
+}
+
+static void arm_recv(){
+    struct io_uring_sqe *sqe = get_sqe();
+    if(sqe == NULL){
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = recv_fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = URING_TAG_RECV;
+    commit_sqe();
+    recv_armed = 1;
+}
+
+static void arm_poll(){
+    struct io_uring_sqe *sqe = get_sqe();
+    if(sqe == NULL){
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = unix_fd;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = URING_TAG_POLL;
+    commit_sqe();
+    poll_armed = 1;
+}
+
+static void unmap_rings(){
+    if(sqes != NULL){
+        munmap(sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+        sqes = NULL;
+    }
+    if(cq_ptr != NULL && cq_ptr != sq_ptr){
+        munmap(cq_ptr, cq_size);
+    }
+    if(sq_ptr != NULL){
+        munmap(sq_ptr, sq_size);
+    }
+    sq_ptr = cq_ptr = NULL;
+    if(buf_ring != NULL){
+        munmap(buf_ring, buf_ring_size);
+        buf_ring = NULL;
+    }
+    free(recv_bufs);
+    recv_bufs = NULL;
+    if(ring_fd >= 0){
+        close(ring_fd);
+        ring_fd = -1;
+    }
+}
+
+static int setup_ring(){
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_CQ_ENTRIES;
+    const char *sqpoll_env = getenv("IPC_URING_SQPOLL");
+    if(sqpoll_env != NULL && atoi(sqpoll_env) > 0){
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = URING_SQPOLL_IDLE_MS;
+    }
+    ring_fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if(ring_fd < 0){
+        fprintf(stderr, "[ERROR HAPPENED] : io_uring is not available: %s\n", strerror(errno));
+        return -1;
+    }
+    if(!(params.features & IORING_FEAT_EXT_ARG)){
+        fprintf(stderr, "[ERROR HAPPENED] : io_uring is too old (no IORING_FEAT_EXT_ARG)\n");
+        return -1;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP){
+        sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+    }
+    sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if(sq_ptr == MAP_FAILED){
+        sq_ptr = NULL;
+        return -1;
+    }
+    cq_ptr = sq_ptr;
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP)){
+        cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if(cq_ptr == MAP_FAILED){
+            cq_ptr = NULL;
+            return -1;
+        }
+    }
+    sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED){
+        sqes = NULL;
+        return -1;
+    }
+    sq_head = (uint32_t *)((char *)sq_ptr + params.sq_off.head);
+    sq_tail = (uint32_t *)((char *)sq_ptr + params.sq_off.tail);
+    sq_mask = (uint32_t *)((char *)sq_ptr + params.sq_off.ring_mask);
+    sq_array = (uint32_t *)((char *)sq_ptr + params.sq_off.array);
+    sq_flags = (uint32_t *)((char *)sq_ptr + params.sq_off.flags);
+    cq_head = (uint32_t *)((char *)cq_ptr + params.cq_off.head);
+    cq_tail = (uint32_t *)((char *)cq_ptr + params.cq_off.tail);
+    cq_mask = (uint32_t *)((char *)cq_ptr + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *)((char *)cq_ptr + params.cq_off.cqes);
+
+    //Registered buffer ring for the multishot receive
+    struct io_uring_buf_reg reg;
+    buf_ring_size = URING_NUM_BUFS * sizeof(struct io_uring_buf);
+    buf_ring = mmap(NULL, buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    recv_bufs = malloc((size_t)URING_NUM_BUFS * URING_BUF_SIZE);
+    if(buf_ring == MAP_FAILED || recv_bufs == NULL){
+        if(buf_ring == MAP_FAILED) buf_ring = NULL;
+        return -1;
+    }
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)buf_ring;
+    reg.ring_entries = URING_NUM_BUFS;
+    reg.bgid = URING_BUF_GROUP;
+    if(syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0){
+        fprintf(stderr, "[ERROR HAPPENED] : Could not register the io_uring buffer ring: %s\n", strerror(errno));
+        return -1;
+    }
+    buf_tail = 0;
+    for(int i = 0; i < URING_NUM_BUFS; i++){
+        provide_buf(i);
+    }
+    return 0;
+}
+
+static int uring_init(int process_id, int socket_fd){
+    char path[108];
+    struct sockaddr_un addr;
+
+    own_id = process_id;
+    unix_fd = socket_fd;
+    socket_flag = 1;
+    recv_armed = poll_armed = 0;
+    to_submit = 0;
+    ready_first = num_ready = 0;
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        peer_fds[i] = -1;
+        peers[i].head = peers[i].tail = NULL;
+        peers[i].in_flight = 0;
+        peers[i].reconnect = 0;
+    }
+    if(setup_ring() < 0){
+        unmap_rings();
+        return -1;
+    }
+
+    recv_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(recv_fd < 0){
+        perror("[ERROR HAPPENED] : When creating the io_uring socket");
+        unmap_rings();
+        return -1;
+    }
+    int rcvbuf = 1048576;
+    setsockopt(recv_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    uring_path(process_id, path, sizeof(path));
+    unlink(path);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if(bind(recv_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+        perror("[ERROR HAPPENED] : Error happened when binding the io_uring socket");
+        close(recv_fd);
+        recv_fd = -1;
+        unmap_rings();
+        return -1;
+    }
+
+    arm_recv();
+    arm_poll();
+    submit();
+    return 0;
+}
+
+//Blocking socket on purpose: a send to a full receiver is parked inside io_uring until there is room, it never fails with EAGAIN
+//Returns -1 if the receiver has no io_uring socket (not up yet, or it runs another backend)
+static int get_peer_socket(int receiver_id){
+    char path[108];
+    struct sockaddr_un addr;
+    if(peer_fds[receiver_id] >= 0){
+        return peer_fds[receiver_id];
+    }
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+        perror("[ERROR HAPPENED] : Tried to initialize socket when sending a message, but failed\n");
+        return -1;
+    }
+    uring_path(receiver_id, path, sizeof(path));
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    ipc_num_syscalls++;
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+        close(fd);
+        return -1;
+    }
+    peer_fds[receiver_id] = fd;
+    return fd;
+}
+
+static void submit_peer(int receiver_id){
+    UringPeer *peer = &peers[receiver_id];
+    if(peer->head == NULL || peer->in_flight){
+        return;
+    }
+    //Frames behind one to a receiver that went away wait until its id is bound again
+    if(get_peer_socket(receiver_id) < 0){
+        return;
+    }
+    struct io_uring_sqe *sqe = get_sqe();
+    if(sqe == NULL){
+        //Submitted once a completion frees an entry
+        return;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = peer_fds[receiver_id];
+    sqe->addr = (uint64_t)(uintptr_t)peer->head->data;
+    sqe->len = peer->head->len;
+    sqe->user_data = (uint64_t)(uintptr_t)peer->head;
+    commit_sqe();
+    peer->in_flight = 1;
+}
+
+//Copies the frame into a send of its own, the caller's buffer is free as soon as we return
+static int queue_send(int receiver_id, const void *msg, size_t msg_len){
+    if(get_peer_socket(receiver_id) < 0){
+        return IPC_SEND_UNAVAILABLE;
+    }
+    UringSend *item = malloc(sizeof(UringSend) + msg_len);
+    if(item == NULL){
+        fprintf(stderr, "[ERROR HAPPENED] : Could not queue a message of %zu bytes\n", msg_len);
+        return IPC_SEND_RETRY;
+    }
+    item->next = NULL;
+    item->receiver_id = receiver_id;
+    item->len = msg_len;
+    memcpy(item->data, msg, msg_len);
+    UringPeer *peer = &peers[receiver_id];
+    if(peer->tail != NULL){
+        peer->tail->next = item;
+    } else{
+        peer->head = item;
+    }
+    peer->tail = item;
+    submit_peer(receiver_id);
+    return IPC_SEND_OK;
+}
+
+static void send_done(UringSend *item, int res){
+    int receiver_id = item->receiver_id;
+    UringPeer *peer = &peers[receiver_id];
+    if(peer->reconnect){
+        peer->reconnect = 0;
+        close(peer_fds[receiver_id]);
+        peer_fds[receiver_id] = -1;
+    }
+    //Under load a send to a full receiver can complete with 0 bytes (or EAGAIN) instead of waiting for room:
+    //the datagram never left, so it goes out again; dropping it would also lose the receiver's credit for good
+    if((res >= 0 && (size_t)res < item->len) || res == -EAGAIN || res == -EINTR || res == -ENOBUFS){
+        peer->in_flight = 0;
+        submit_peer(receiver_id);
+        return;
+    }
+    if(res == -ECONNREFUSED || res == -ENOTCONN){
+        //The receiver went away (a load generator client of an earlier phase), the frame goes to the next one under its id
+        if(peer_fds[receiver_id] >= 0){
+            close(peer_fds[receiver_id]);
+            peer_fds[receiver_id] = -1;
+        }
+        peer->in_flight = 0;
+        submit_peer(receiver_id);
+        return;
+    }
+    if(res < 0){
+        fprintf(stderr, "[ERROR HAPPENED] : Sending a message to process %d failed: %s\n", receiver_id, strerror(-res));
+    }
+    peer->head = item->next;
+    if(peer->head == NULL){
+        peer->tail = NULL;
+    }
+    peer->in_flight = 0;
+    free(item);
+    submit_peer(receiver_id);
+}
+
+//The old receiver's socket outlives it until the kernel tore down its ring, sends on our connection would still
+//succeed into it; the next send connects to the socket bound under the id now
+//A send in flight keeps the descriptor, it is closed once that send is done
+static void uring_peer_replaced(int receiver_id){
+    if(peer_fds[receiver_id] < 0){
+        return;
+    }
+    if(peers[receiver_id].in_flight){
+        peers[receiver_id].reconnect = 1;
+        return;
+    }
+    close(peer_fds[receiver_id]);
+    peer_fds[receiver_id] = -1;
+}
+
+static int cq_ready(){
+    return *cq_head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+}
+
+//Works through the completion ring: received frames are kept in their buffers until uring_receive hands them out,
+//finished sends make room for the next send to their receiver
+//Sends to a receiver with room complete while they are submitted, so reaping right after a submit keeps them from
+//waiting behind a completion nobody looked at (the manager only receives every few queries)
+static void reap(){
+    //Completions that didn't fit into the ring wait in the kernel until we ask for them
+    if(!cq_ready() && (__atomic_load_n(sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)){
+        uring_enter(0, 0, IORING_ENTER_GETEVENTS, -1);
+    }
+    while(cq_ready()){
+        uint32_t head = *cq_head;
+        while(head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)){
+            struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+            uint64_t tag = cqe->user_data;
+            int res = cqe->res;
+            uint32_t flags = cqe->flags;
+            head++;
+
+            if(tag == URING_TAG_RECV){
+                if(!(flags & IORING_CQE_F_MORE)){
+                    recv_armed = 0;
+                }
+                if(flags & IORING_CQE_F_BUFFER){
+                    uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+                    if(res > 0){
+                        //At most URING_NUM_BUFS buffers can be handed out, so the queue never overflows
+                        int slot = (ready_first + num_ready) % URING_NUM_BUFS;
+                        ready_bids[slot] = bid;
+                        ready_lens[slot] = res;
+                        num_ready++;
+                    } else{
+                        provide_buf(bid);
+                    }
+                } else if(res < 0 && res != -ENOBUFS){
+                    fprintf(stderr, "[ERROR HAPPENED] : io_uring receive failed: %s\n", strerror(-res));
+                }
+            } else if(tag == URING_TAG_POLL){
+                if(!(flags & IORING_CQE_F_MORE)){
+                    poll_armed = 0;
+                }
+                socket_flag = 1;
+            } else{
+                send_done((UringSend *)(uintptr_t)tag, res);
+            }
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+        //A multishot request ends when it ran out of buffers or hit an error, arm it again
+        if(!recv_armed){
+            arm_recv();
+        }
+        if(!poll_armed){
+            arm_poll();
+        }
+        submit();
+    }
+}
+
+static int uring_send(int sender_id, int receiver_id, const void *msg, size_t msg_len, int fd){
+    int ret = queue_send(receiver_id, msg, msg_len);
+    submit();
+    reap();
+    return ret;
+}
+
+//All sends of the batch go to the kernel with one io_uring_enter
+static int uring_send_batch(int sender_id, const IPCOutMsg *msgs, int num_msgs, int *status){
+    int sent = 0;
+    for(int i = 0; i < num_msgs; i++){
+        status[i] = queue_send(msgs[i].receiver_id, msgs[i].msg, msgs[i].msg_len);
+        sent += status[i] == IPC_SEND_OK;
+    }
+    submit();
+    reap();
+    return sent;
+}
+
+//Hands out the oldest received frame (0 if there is none)
+static int uring_receive(char *buf, size_t buf_size, int *received_fd){
+    *received_fd = -1;
+    if(ring_fd < 0){
+        return 0;
+    }
+    if(num_ready == 0){
+        reap();
+        if(num_ready == 0){
+            return 0;
+        }
+    }
+    uint16_t bid = ready_bids[ready_first];
+    size_t copy_len = (size_t)ready_lens[ready_first] < buf_size - 1 ? (size_t)ready_lens[ready_first] : buf_size - 1;
+    ready_first = (ready_first + 1) % URING_NUM_BUFS;
+    num_ready--;
+    memcpy(buf, recv_bufs + (size_t)bid * URING_BUF_SIZE, copy_len);
+    buf[copy_len] = '\0';
+    provide_buf(bid);
+    return (int)copy_len;
+}
+
+static int uring_wait(int timeout_ms, int has_pending){
+    if(num_ready > 0 || cq_ready() || socket_flag){
+        return 1;
+    }
+    if(has_pending && (timeout_ms < 0 || timeout_ms > IPC_PENDING_RETRY_MS)){
+        timeout_ms = IPC_PENDING_RETRY_MS;
+    }
+    submit();
+    uring_enter(0, 1, IORING_ENTER_GETEVENTS, timeout_ms);
+    return cq_ready();
+}
+
+static int uring_socket_readable(){
+    return socket_flag;
+}
+
+static void uring_socket_drained(){
+    socket_flag = 0;
+}
+
+//1 while a send is queued for a receiver we are connected to, frames for one that went away can't leave anyway
+static int sends_queued(){
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        if(peers[i].head != NULL && peer_fds[i] >= 0){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//The last frames a node sends (the credits close_communication hands back) are only queued here, reap until they left
+static void drain_sends(){
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while(ring_fd >= 0 && sends_queued()){
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        if(elapsed_ms >= URING_CLOSE_DRAIN_MS){
+            fprintf(stderr, "[ERROR HAPPENED] : Process %d closes with sends still queued after %d ms\n", own_id, URING_CLOSE_DRAIN_MS);
+            return;
+        }
+        submit();
+        uring_enter(0, 1, IORING_ENTER_GETEVENTS, URING_CLOSE_DRAIN_MS - elapsed_ms);
+        reap();
+    }
+}
+
+static void uring_close(int process_id){
+    char path[108];
+    drain_sends();
+    for(int i = 0; i <= MAX_PROCESSES; i++){
+        while(peers[i].head != NULL){
+            UringSend *item = peers[i].head;
+            peers[i].head = item->next;
+            free(item);
+        }
+        peers[i].tail = NULL;
+        if(peer_fds[i] >= 0){
+            close(peer_fds[i]);
+            peer_fds[i] = -1;
+        }
+    }
+    //Closing the ring cancels whatever is still in flight
+    unmap_rings();
+    if(recv_fd >= 0){
+        close(recv_fd);
+        recv_fd = -1;
+    }
+    uring_path(process_id, path, sizeof(path));
+    unlink(path);
+}
+
+//The io_uring socket gets plain frames only, descriptors go ahead of them over the Unix socket
+const IPCTransport uring_transport = {
+    .name = "uring",
+    .passes_fds = 0,
+    .init = uring_init,
+    .send = uring_send,
+    .send_batch = uring_send_batch,
+    .receive = uring_receive,
+    .receive_batch = NULL,
+    .wait = uring_wait,
+    .close = uring_close,
+    .socket_readable = uring_socket_readable,
+    .socket_drained = uring_socket_drained,
+    .peer_replaced = uring_peer_replaced,
+};
@@ -0,0 +1,732 @@
+#define _POSIX_C_SOURCE 199309L
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include "IPC.h"
+#include "barrier.h"
+#include "loadgen.h"
+#include "workload.h"
+#include "inflight.h"
+#include "trace.h"
+#include "scenario.h"
+#include "manager_backend.h"
+#include "key_segment.h"
+#include "keygen.h"
+#include "process_stats.h"
+#include "results.h"
+#include "placement.h"
+
+//The manager of every summary structure: it starts the processes, hands out the keys through the structure's
+//backend (manager_backend.h) and runs the phases of the scenario (scenario.h) against them
+//Usage: ./manager <bloom|counting_bloom|cqf> <num_processes> <keys_per_process> [scenario file]
+
+#define MAX_MSG_LEN 65536
+
+const ManagerBackend *backend;
+ManagerFleet fleet;
+
+int num_processes;
+int keys_per_process;
+
+pid_t *process_pids;
+int manager_fd;
+
+//With IPC_TRANSPORT=thread the processes are threads of the manager that run the backend's process_main
+typedef struct{
+    pthread_t thread;
+    int cpu;
+    char id_str[16];
+    char num_str[16];
+    char *argv[4];
+} ProcessThread;
+ProcessThread *process_threads = NULL;
+
+//The keys of all processes live in one key segment (key_segment.h), process p's keys_per_process keys start at
+//all_keys + p * keys_per_process; the processes get the segment itself, the manager reads it through all_keys
+KeySegment key_segment;
+int *all_keys;
+int total_keys;
+//Keys are numbered from 0 (keygen.h): the build takes the first total_keys, the insert phases the ones after them
+KeyGen keygen;
+Placement placement;
+uint64_t next_key_index;
+Workload workload;           //which keys the hits of the query mix ask for
+
+//The keys a process holds as far as the deletes and inserts went: the build keys not deleted yet, in the order of one
+//permutation that the deletes of every phase continue, and the inserted keys not deleted yet
+typedef struct{
+    KeyPermutation build_order;
+    uint64_t build_deleted;     //the first build_deleted build keys of build_order are gone
+    int *inserted;
+    int num_inserted;
+    int inserted_capacity;
+} LiveKeys;
+LiveKeys *live_keys = NULL;
+uint64_t num_delete_picks;
+
+//The local/remote/miss mix of the current query phase and what it drew
+int pct_local;
+int pct_remote;
+int num_local_query = 0;
+int num_remote_query = 0;
+int num_nonexisting_query = 0;
+
+//Queries of the paced loop that wait for an answer, keyed by their request id (index + 1)
+InflightTable pending_queries;
+Histogram query_latency;
+uint64_t queries_start_ns = 0;
+int queries_found = 0;
+int queries_not_found = 0;
+
+static void *run_process_thread(void *arg){
+    ProcessThread *t = arg;
+    placement_pin(t->cpu);
+    backend->process_main(3, t->argv);
+    return NULL;
+}
+
+//The same argv as the process binaries get, the threads pin themselves like the children do before exec
+static void create_process_threads(){
+    process_threads = calloc(num_processes, sizeof(ProcessThread));
+    for(int i = 0; i < num_processes; i++){
+        ProcessThread *t = &process_threads[i];
+        t->cpu = placement.process_cpus[i];
+        snprintf(t->id_str, sizeof(t->id_str), "%d", i);
+        snprintf(t->num_str, sizeof(t->num_str), "%d", num_processes);
+        t->argv[0] = "process";
+        t->argv[1] = t->id_str;
+        t->argv[2] = t->num_str;
+        t->argv[3] = NULL;
+        if(pthread_create(&t->thread, NULL, run_process_thread, t) != 0){
+            fprintf(stderr, "[ERROR HAPPENED] : Could not start the thread of process %d\n", i);
+            exit(1);
+        }
+    }
+}
+
+//Starts the processes of the backend (PROCESS_BINARY overrides the binary) and returns once every process reported MSG_READY
+//With IPC_TRANSPORT=thread they are threads of the manager instead (PROCESS_BINARY is not used)
+void create_processes(){
+    process_pids = malloc(num_processes * sizeof(pid_t));
+    phase_begin("startup");
+    if(ipc_in_process()){
+        create_process_threads();
+        phase_barrier(manager_fd, MSG_READY, phase_id(), num_processes);
+        phase_end();
+        return;
+    }
+
+    const char *process_binary = getenv("PROCESS_BINARY");
+    if(process_binary == NULL){
+        process_binary = backend->process_binary;
+    }
+
+    for(int i = 0; i < num_processes; i++){
+        pid_t pid = fork();
+
+        if(pid == 0){
+            char process_id_str[16];
+            placement_pin(placement.process_cpus[i]);
+            char num_proc_str[16];
+
+            snprintf(process_id_str, sizeof(process_id_str), "%d", i);
+            snprintf(num_proc_str, sizeof(num_proc_str), "%d", num_processes);
+
+            execl(process_binary, "process", process_id_str, num_proc_str, NULL);
+            perror("ERROR HAPPENED: execl failed");
+            exit(1);
+        } else if(pid > 0){
+            process_pids[i] = pid;
+        } else{
+            perror("ERROR HAPPENED : fork failed");
+            exit(1);
+        }
+    }
+    phase_barrier(manager_fd, MSG_READY, phase_id(), num_processes);
+    phase_end();
+}
+
+//Same number of keys for every owner, the layout of a key segment for deletes and inserts too
+int *per_process_counts(int count){
+    static int counts[MAX_PROCESSES];
+    for(int p = 0; p < num_processes; p++){
+        counts[p] = count;
+    }
+    return counts;
+}
+
+//This function creates unique random keys for all processes straight into the key segment, owner by owner, and seals it
+//The query mix draws from workload_rand() seeded with the same seed (the clients with seeds drawn from it), so
+//KEYGEN_SEED repeats the whole run
+void create_random_keys(){
+    total_keys = num_processes * keys_per_process;
+    if(key_segment_create(&key_segment, "keys", num_processes, per_process_counts(keys_per_process)) < 0){
+        fprintf(stderr, "[ERROR HAPPENED] Manager failed to allocate memory for %d keys\n", total_keys);
+        exit(1);
+    }
+
+    printf("Manager creating %d random keys\n", total_keys);
+
+    workload_seed(keygen.seed);
+    keygen_fill(&keygen, key_segment.keys, 0, total_keys);
+    next_key_index = total_keys;
+    if(key_segment_seal(&key_segment) < 0){
+        exit(1);
+    }
+    all_keys = key_segment.keys;
+}
+
+//Once the process looks for a key in its own hash table, peers' bloom/cq/cb filters, and queries peer processes,
+//it sends a response to the manager/user
+//The message type is either MSG_FOUND or MSG_NOTFOUND, carrying the request id of the query, so the answer is matched
+//in O(1) and each query of a key that was asked several times gets its own answer
+//Returns 1 if the message answered a query that was still pending
+int handle_process_response(const char *msg, int len){
+    MsgHeader hdr;
+    const char *payload;
+    if(decode_msg(msg, len, &hdr, &payload) < 0 || (hdr.type != MSG_FOUND && hdr.type != MSG_NOTFOUND)){
+        return 0;
+    }
+    InflightEntry *query = inflight_find(&pending_queries, hdr.request_id);
+    if(query == NULL){
+        //a second FOUND, for a key that more than one process holds
+        return 0;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(hdr.type == MSG_FOUND){
+        queries_found++;
+    } else{
+        queries_not_found++;
+    }
+    //The paced loop sends on its own pace whatever the answers do, so the samples need no coordinated omission correction
+    if(!histogram_in_warmup(&query_latency, queries_start_ns, query->start_ns)){
+        histogram_record(&query_latency, timespec_to_ns(&now) - query->start_ns);
+    }
+    inflight_remove(&pending_queries, query);
+    return 1;
+}
+
+void start_tracking_queries(int num_queries){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    inflight_init(&pending_queries, num_queries);
+    histogram_init(&query_latency);
+    queries_start_ns = timespec_to_ns(&now);
+    queries_found = 0;
+    queries_not_found = 0;
+}
+
+void track_query(uint32_t request_id, int key){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    InflightEntry *query = inflight_insert(&pending_queries, request_id);
+    if(query != NULL){
+        query->key = key;
+        query->start_ns = timespec_to_ns(&now);
+    }
+}
+
+void print_query_results(int num_queries){
+    printf("\nRESULTS:\n");
+    printf("Queries sent: %d\n", num_queries);
+    printf("Queries answered: %d (found %d, not found %d)\n", queries_found + queries_not_found, queries_found, queries_not_found);
+    printf("Queries unanswered: %u\n", pending_queries.count);
+    printf("Avg time: %.2f ms\n", histogram_mean(&query_latency) / 1000000.0);
+    printf("Min time: %.2f ms\n", query_latency.total > 0 ? query_latency.min / 1000000.0 : 0);
+    printf("Max time: %.2f ms\n", query_latency.max / 1000000.0);
+    histogram_print(stdout, "Latency", &query_latency);
+    inflight_destroy(&pending_queries);
+}
+
+//Picks one query of the local/remote/miss mix of the phase
+//Keys are drawn from [0, KEYGEN_KEY_RANGE), so a miss asks for a key above that range which no cache has
+LoadgenQueryKind pick_random_query(int *key, int *target_process){
+    int r = workload_rand() % 100;
+    int actual_process = -1;
+    if(r < (pct_local + pct_remote)){
+        int key_index = (int)workload_pick(&workload);
+        actual_process = key_index / keys_per_process;
+        *key = all_keys[key_index];
+    } else{
+        *key = KEYGEN_KEY_RANGE + workload_rand() % KEYGEN_KEY_RANGE;
+    }
+
+    if(r < pct_local){
+        *target_process = actual_process;
+        return LOADGEN_QUERY_LOCAL;
+    } else if(r < pct_local + pct_remote){
+        do{
+            *target_process = workload_rand() % num_processes;
+        } while(*target_process == actual_process);
+        return LOADGEN_QUERY_REMOTE;
+    } else{
+        *target_process = workload_rand() % num_processes;
+    }
+    return LOADGEN_QUERY_MISS;
+}
+
+//For specific queries: we do not send queries to a process for a key that exists in local
+//So that each process needs to check the blooms/cqfs/cbfs and query peer processes
+//ALso we make sure that the key exists in at least one cache
+//A single process has no peer to send it to, it gets its own keys and the query counts as local
+LoadgenQueryKind pick_specific_query(int *key, int *target_process){
+    int key_index = workload_rand() % total_keys;
+    int actual_process = key_index / keys_per_process;
+    *key = all_keys[key_index];
+    *target_process = actual_process;
+    if(num_processes == 1){
+        return LOADGEN_QUERY_LOCAL;
+    }
+    while(*target_process == actual_process){
+        *target_process = workload_rand() % num_processes;
+    }
+    return LOADGEN_QUERY_REMOTE;
+}
+
+//The original loop: one query every usleep(100), with a drain every fifth query
+void run_paced_queries(const char *phase_name, int num_queries, LoadgenPickQuery pick){
+    char response_buf[MAX_MSG_LEN] __attribute__((aligned(8)));
+    start_tracking_queries(num_queries);
+
+    int responses_collected = 0;
+
+    for(int i = 0; i < num_queries; i++){
+        int query_key;
+        int target_process;
+        switch(pick(&query_key, &target_process)){
+            case LOADGEN_QUERY_LOCAL: num_local_query++; break;
+            case LOADGEN_QUERY_REMOTE: num_remote_query++; break;
+            default: num_nonexisting_query++; break;
+        }
+
+        track_query(i + 1, query_key);
+        send_key_frame(num_processes, target_process, MSG_QUERY, i + 1, 0, query_key);
+
+        if(i%5 == 0){
+            while(1){
+                int n = receive_msg(manager_fd, response_buf, sizeof(response_buf));
+                if(n <= 0) break;
+
+                responses_collected += handle_process_response(response_buf, n);
+            }
+        }
+
+        usleep(100);
+    }
+
+    int max_wait_iterations = 10000;
+    int iterations = 0;
+
+    while(pending_queries.count > 0 && iterations < max_wait_iterations){
+        int n = receive_msg(manager_fd, response_buf, sizeof(response_buf));
+        if(n > 0){
+            responses_collected += handle_process_response(response_buf, n);
+        }
+        usleep(100);
+        iterations++;
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    results_query_phase(phase_name, num_queries, queries_found, queries_not_found, pending_queries.count,
+                        (timespec_to_ns(&end) - queries_start_ns) / 1000000.0, &query_latency);
+    print_query_results(num_queries);
+}
+
+//Runs num_queries queries from pick() in the load generator mode of LOADGEN_MODE, phase_name labels them in the results
+void do_queries(const char *phase_name, int num_queries, LoadgenPickQuery pick){
+    LoadgenConfig loadgen;
+    loadgen_config_from_env(&loadgen);
+    num_local_query = 0;
+    num_remote_query = 0;
+    num_nonexisting_query = 0;
+    workload_init(&workload, total_keys);
+    workload_print(stdout, &workload);
+    if(loadgen.mode != LOADGEN_PACED){
+        static LoadgenResult result;
+        loadgen_run(&loadgen, manager_fd, num_processes, num_queries, pick, &result);
+        loadgen_print(stdout, &loadgen, &result);
+        results_query_phase(phase_name, result.sent, result.found, result.not_found, result.timed_out, result.duration_ms,
+                            &result.latency);
+        //Every client counted what its pick() drew, loadgen_finish added them up
+        num_local_query = result.num_by_kind[LOADGEN_QUERY_LOCAL];
+        num_remote_query = result.num_by_kind[LOADGEN_QUERY_REMOTE];
+        num_nonexisting_query = result.num_by_kind[LOADGEN_QUERY_MISS];
+    } else{
+        run_paced_queries(phase_name, num_queries, pick);
+    }
+    workload_destroy(&workload);
+    printf("Local queries:%d\n", num_local_query);
+    printf("Remote queries:%d\n", num_remote_query);
+    printf("Nonexisting queries:%d\n", num_nonexisting_query);
+}
+
+//Trace batches go through the backend's update path; a fresh step id keeps the acks of the last batch out
+void apply_trace_updates(TraceOp op, KeySegment *keys){
+    backend->update(&fleet, op, keys, phase_step());
+}
+
+//Replays a binary trace (see trace.h) instead of the synthetic mix
+void replay_trace(const char *path){
+    LoadgenConfig loadgen;
+    TraceConfig config;
+    Trace trace;
+    static TraceResult result;
+    TraceUpdater updater = {apply_trace_updates};
+    loadgen_config_from_env(&loadgen);
+    trace_config_from_env(&config);
+    if(trace_open(&trace, path) < 0){
+        return;
+    }
+    if(backend->update == NULL){
+        printf("%s has no update path, the trace's inserts and deletes are skipped\n", backend->name);
+    }
+    trace_replay(&trace, &config, &loadgen, manager_fd, num_processes, num_processes,
+                 backend->update != NULL ? &updater : NULL, &result);
+    trace_close(&trace);
+    trace_print(stdout, &config, &loadgen, &result);
+    results_query_phase("trace", result.queries.sent, result.queries.found, result.queries.not_found,
+                        result.queries.timed_out, result.queries.duration_ms, &result.queries.latency);
+    //Every get goes to the node the trace names
+    printf("Local queries:%llu\n", (unsigned long long)result.queries.num_by_kind[LOADGEN_QUERY_LOCAL]);
+}
+
+static void init_live_keys(){
+    if(live_keys != NULL){
+        return;
+    }
+    live_keys = calloc(num_processes, sizeof(LiveKeys));
+    for(int p = 0; p < num_processes; p++){
+        key_permutation_init(&live_keys[p].build_order, keys_per_process, keygen_random(keygen.seed, p));
+    }
+}
+
+static uint64_t num_live_keys(const LiveKeys *live){
+    return keys_per_process - live->build_deleted + live->num_inserted;
+}
+
+//A live key drawn uniformly and taken out of live: the next build key of the permutation or an inserted key
+static int take_live_key(LiveKeys *live, int p){
+    uint64_t build_left = keys_per_process - live->build_deleted;
+    uint64_t pick = live->num_inserted > 0 ? keygen_random(keygen.seed, num_processes + num_delete_picks++) % num_live_keys(live) : 0;
+    if(pick < build_left){
+        return all_keys[key_permutation_at(&live->build_order, live->build_deleted++) + (uint64_t)p * keys_per_process];
+    }
+    int i = (int)(pick - build_left);
+    int key = live->inserted[i];
+    live->inserted[i] = live->inserted[--live->num_inserted];
+    return key;
+}
+
+//Every process deletes num_deletes of the keys it holds, drawn without repeats from its build keys and the keys
+//inserted since, so no delete names a key that is already gone (at most as many as it has left)
+int create_deletes(KeySegment *deletes, int num_deletes){
+    init_live_keys();
+    for(int p = 0; p < num_processes; p++){
+        if((uint64_t)num_deletes > num_live_keys(&live_keys[p])){
+            num_deletes = (int)num_live_keys(&live_keys[p]);
+        }
+    }
+    if(key_segment_create(deletes, "deletes", num_processes, per_process_counts(num_deletes)) < 0){
+        return -1;
+    }
+    for(int p = 0; p < num_processes; p++){
+        int *delete_keys = key_segment_owner_keys(deletes, p);
+        for(int di = 0; di < num_deletes; di++){
+            delete_keys[di] = take_live_key(&live_keys[p], p);
+        }
+    }
+    return 0;
+}
+
+//Every process gets num_inserts new keys, none of them was used before; later deletes may pick them
+int create_inserts(KeySegment *inserts, int num_inserts){
+    init_live_keys();
+    if(key_segment_create(inserts, "inserts", num_processes, per_process_counts(num_inserts)) < 0){
+        return -1;
+    }
+    for(int p = 0; p < num_processes; p++){
+        int *update_keys = key_segment_owner_keys(inserts, p);
+        keygen_fill(&keygen, update_keys, next_key_index, num_inserts);
+        next_key_index += num_inserts;
+        LiveKeys *live = &live_keys[p];
+        if(live->num_inserted + num_inserts > live->inserted_capacity){
+            int capacity = live->num_inserted + num_inserts > 2 * live->inserted_capacity ? live->num_inserted + num_inserts
+                                                                                           : 2 * live->inserted_capacity;
+            int *inserted = realloc(live->inserted, (size_t)capacity * sizeof(int));
+            if(inserted == NULL){
+                fprintf(stderr, "[ERROR HAPPENED] : Could not keep track of the inserted keys, later deletes skip them\n");
+                continue;
+            }
+            live->inserted = inserted;
+            live->inserted_capacity = capacity;
+        }
+        memcpy(live->inserted + live->num_inserted, update_keys, (size_t)num_inserts * sizeof(int));
+        live->num_inserted += num_inserts;
+    }
+    return 0;
+}
+
+void send_deletes(int num_deletes){
+    KeySegment deletes;
+    if(create_deletes(&deletes, num_deletes) < 0){
+        return;
+    }
+    printf("Sent all deletions\n");
+    backend->update(&fleet, TRACE_DELETE, &deletes, phase_id());
+    key_segment_destroy(&deletes);
+}
+
+void send_inserts(int num_inserts){
+    KeySegment inserts;
+    if(create_inserts(&inserts, num_inserts) < 0){
+        return;
+    }
+    backend->update(&fleet, TRACE_INSERT, &inserts, phase_id());
+    key_segment_destroy(&inserts);
+}
+
+//One churn round: every process deletes batch of its keys and gets as many new ones through the backend's update path,
+//which for Bloom also waits until every process holds the rebuilt filters of all peers; returns the time it took in ns
+uint64_t churn_round(int batch){
+    struct timespec start, end;
+    KeySegment deletes, inserts;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(create_deletes(&deletes, batch) == 0){
+        backend->update(&fleet, TRACE_DELETE, &deletes, phase_step());
+        key_segment_destroy(&deletes);
+    }
+    if(create_inserts(&inserts, batch) == 0){
+        backend->update(&fleet, TRACE_INSERT, &inserts, phase_step());
+        key_segment_destroy(&inserts);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return timespec_to_ns(&end) - timespec_to_ns(&start);
+}
+
+//Queries of the mix from background clients while the manager deletes and inserts update_rate keys per second in
+//rounds of CHURN_BATCH keys per process (default 1000); update_rate 0 runs the rounds back to back
+//The clients split their latencies by whether an update round was in progress (loadgen.h), the rounds bump a shared
+//epoch before and after. Queries keep asking for the keys of the build, so the deleted ones turn into misses, the
+//processes drop them from their own key tables as well as from the filters
+//Paced mode has no background clients, the churn runs the open loop instead
+void run_churn(const char *phase_name, int num_queries, int update_rate){
+    LoadgenConfig loadgen;
+    loadgen_config_from_env(&loadgen);
+    if(loadgen.mode == LOADGEN_PACED){
+        loadgen.mode = LOADGEN_OPEN;
+    }
+    int batch = getenv("CHURN_BATCH") != NULL ? atoi(getenv("CHURN_BATCH")) : CHURN_DEFAULT_BATCH;
+    if(batch <= 0){
+        batch = CHURN_DEFAULT_BATCH;
+    }
+    if(backend->update == NULL){
+        printf("%s has no update path, the churn runs its queries only\n", backend->name);
+    }
+    uint32_t *epoch = mmap(NULL, sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(epoch == MAP_FAILED){
+        perror("[ERROR HAPPENED] : Could not map the churn epoch");
+        return;
+    }
+    *epoch = 0;
+    loadgen.rebuild_epoch = epoch;
+    num_local_query = 0;
+    num_remote_query = 0;
+    num_nonexisting_query = 0;
+    workload_init(&workload, total_keys);
+    workload_print(stdout, &workload);
+
+    LoadgenBackground background;
+    loadgen_start(&loadgen, manager_fd, num_processes, num_queries, pick_random_query, &background);
+    uint64_t interval_ns = update_rate > 0 ? (uint64_t)(1e9 * batch * num_processes / update_rate) : 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    //The first round starts with the queries, a phase shorter than one interval still sees a rebuild
+    uint64_t next_round = timespec_to_ns(&now);
+    uint64_t rounds = 0, round_ns = 0, max_round_ns = 0;
+    while(backend->update != NULL && !loadgen_done(&background)){
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if(timespec_to_ns(&now) < next_round){
+            uint64_t wait_ns = next_round - timespec_to_ns(&now);
+            usleep(wait_ns < 1000000 ? wait_ns / 1000 : 1000);
+            continue;
+        }
+        __atomic_add_fetch(epoch, 1, __ATOMIC_RELEASE);
+        uint64_t ns = churn_round(batch);
+        __atomic_add_fetch(epoch, 1, __ATOMIC_RELEASE);
+        rounds++;
+        round_ns += ns;
+        if(ns > max_round_ns){
+            max_round_ns = ns;
+        }
+        //A round that took longer than the interval starts the next one right away, without catching up
+        next_round += interval_ns;
+        if(next_round < timespec_to_ns(&now) + ns){
+            next_round = timespec_to_ns(&now) + ns;
+        }
+    }
+    static LoadgenResult result;
+    loadgen_finish(&background, &result);
+    loadgen_print(stdout, &loadgen, &result);
+    if(backend->update != NULL){
+        printf("Churn: %llu rounds of %d deletes and %d inserts per process, %.1f ms per round (max %.1f ms), "
+               "%.1f%% of the phase rebuilding\n", (unsigned long long)rounds, batch, batch,
+               rounds > 0 ? round_ns / 1000000.0 / rounds : 0.0, max_round_ns / 1000000.0,
+               result.duration_ms > 0 ? round_ns / 10000.0 / result.duration_ms : 0.0);
+        if(rounds == 0){
+            printf("The queries were over before a round started, nothing was measured while rebuilding\n");
+        }
+    }
+    printf("p99 while rebuilding: %.3f ms (%llu queries), p99 otherwise: %.3f ms (%llu queries)\n",
+           histogram_percentile(&result.latency_rebuild, 99.0) / 1000000.0, (unsigned long long)result.latency_rebuild.total,
+           histogram_percentile(&result.latency_steady, 99.0) / 1000000.0, (unsigned long long)result.latency_steady.total);
+    results_query_phase(phase_name, result.sent, result.found, result.not_found, result.timed_out, result.duration_ms,
+                        &result.latency);
+    results_query_windows(&result.latency_rebuild, &result.latency_steady);
+    num_local_query = result.num_by_kind[LOADGEN_QUERY_LOCAL];
+    num_remote_query = result.num_by_kind[LOADGEN_QUERY_REMOTE];
+    num_nonexisting_query = result.num_by_kind[LOADGEN_QUERY_MISS];
+    munmap(epoch, sizeof(uint32_t));
+    workload_destroy(&workload);
+    printf("Local queries:%d\n", num_local_query);
+    printf("Remote queries:%d\n", num_remote_query);
+    printf("Nonexisting queries:%d\n", num_nonexisting_query);
+}
+
+void run_phase(const ScenarioPhase *phase){
+    phase_begin(scenario_phase_name(phase->type));
+    pct_local = phase->pct_local;
+    pct_remote = phase->pct_remote;
+    //A single process has no peer that holds a key, the remote share of the mix asks for keys nobody has instead
+    if(num_processes == 1 && pct_remote > 0 && (phase->type == SCENARIO_QUERIES || phase->type == SCENARIO_CHURN)){
+        printf("One process: the %d%% remote queries of the mix are misses\n", pct_remote);
+        pct_remote = 0;
+    }
+    switch(phase->type){
+        case SCENARIO_QUERIES:
+            if(getenv("TRACE_FILE") != NULL){
+                replay_trace(getenv("TRACE_FILE"));
+            } else{
+                do_queries(scenario_phase_name(phase->type), phase->count, pick_random_query);
+            }
+            break;
+        case SCENARIO_SPECIFIC:
+            do_queries(scenario_phase_name(phase->type), phase->count, pick_specific_query);
+            break;
+        case SCENARIO_TRACE:
+            replay_trace(phase->path);
+            break;
+        case SCENARIO_CHURN:
+            run_churn(scenario_phase_name(phase->type), phase->count, phase->update_rate);
+            break;
+        case SCENARIO_DELETES:
+        case SCENARIO_INSERTS:
+            if(backend->update == NULL){
+                printf("%s has no update path, skipping the %s\n", backend->name, scenario_phase_name(phase->type));
+            } else if(phase->type == SCENARIO_DELETES){
+                send_deletes(phase->count);
+            } else{
+                send_inserts(phase->count);
+            }
+            break;
+    }
+    phase_end();
+}
+
+//The processes write their stats on the way out, the threads once ipc_threads_stop woke them up
+static void stop_processes(){
+    if(process_threads != NULL){
+        ipc_threads_stop();
+        for(int i = 0; i < num_processes; i++){
+            pthread_join(process_threads[i].thread, NULL);
+        }
+        free(process_threads);
+        process_threads = NULL;
+        return;
+    }
+    for(int i = 0; i < num_processes; i++){
+        kill(process_pids[i], SIGTERM);
+    }
+    for(int i = 0; i < num_processes; i++){
+        waitpid(process_pids[i], NULL, 0);
+    }
+}
+
+int main(int argc, char *argv[]){
+    if(argc < 4){
+        fprintf(stderr, "Usage: %s <", argv[0]);
+        manager_backend_list(stderr);
+        fprintf(stderr, "> <num_processes> <keys_per_process> [scenario file]\n");
+        exit(1);
+    }
+
+    backend = manager_backend_find(argv[1]);
+    if(backend == NULL){
+        fprintf(stderr, "[ERROR HAPPENED] : Unknown structure %s, use one of ", argv[1]);
+        manager_backend_list(stderr);
+        fprintf(stderr, "\n");
+        exit(1);
+    }
+    num_processes = atoi(argv[2]);
+    keys_per_process = atoi(argv[3]);
+    if(num_processes < 1 || num_processes >= MAX_PROCESSES || keys_per_process < 1){
+        fprintf(stderr, "[ERROR HAPPENED] : Need 1 to %d processes and at least one key per process\n", MAX_PROCESSES - 1);
+        exit(1);
+    }
+
+    Scenario scenario;
+    if(argc > 4){
+        if(scenario_load(&scenario, argv[4]) < 0){
+            exit(1);
+        }
+    } else{
+        scenario_default(&scenario);
+    }
+    printf("Structure: %s, %d processes, %d keys per process\n", backend->name, num_processes, keys_per_process);
+    scenario_print(stdout, &scenario);
+    placement_init(&placement, num_processes);
+    placement_print(stdout, &placement);
+
+    fleet.num_processes = num_processes;
+    for(int p = 0; p < num_processes; p++){
+        fleet.all_processes[p] = p;
+    }
+    manager_fd = initiate_communication(num_processes);
+    fleet.fd = manager_fd;
+
+    // Create processes, and communication, random keys, and send the keys to the corresponding processes
+    process_stats_remove(num_processes);
+    create_processes();
+    keygen_config_from_env(&keygen);
+    keygen_print(stdout, &keygen);
+    create_random_keys();
+    placement_pin(placement.manager_cpu);
+    backend->build(&fleet, &key_segment);
+
+    for(int i = 0; i < scenario.num_phases; i++){
+        run_phase(&scenario.phases[i]);
+    }
+
+    stop_processes();
+    printf("\n");
+    phase_print(stdout);
+    printf("\n");
+    ipc_print_stats(stdout);
+    LoadgenConfig loadgen;
+    loadgen_config_from_env(&loadgen);
+    ResultsConfig results = {backend->name, num_processes, keys_per_process, scenario.name, keygen.seed,
+                             loadgen_mode_name(loadgen.mode), loadgen.clients, &placement};
+    results_write(&results);
+    close_communication(num_processes, manager_fd);
+    key_segment_destroy(&key_segment);
+    free(process_pids);
+    return 0;
+}
@@ -1,43 +1,58 @@
-#define _POSIX_C_SOURCE 199309L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
 #include "IPC.h"
+#include "event_loop.h"
+#include "coalesce.h"
+#include "inflight.h"
 #include "bloom.h"
-#include <search.h>
+#include "key_segment.h"
+#include "process_stats.h"
+#include "key_set.h"
 #include <time.h>
 
 
 
-#define BUF_SIZE 256          
 #define BLOOM_MSG_SIZE 262144 
 #define FALSE_POSITIVE_RATE 0.01
-#define BLOOM_FILE_DIR "/tmp"
 
-int process_id; 
+//Node state is per thread, so that the manager can also run the nodes as threads (IPC_TRANSPORT=thread)
+static __thread int process_id; 
 
-int num_processes; 
+static __thread int num_processes; 
 
-int *keys = NULL; 
-int num_keys = 0;
-int keys_capacity = 0;
+static __thread int *keys = NULL; 
+static __thread int num_keys = 0;
+static __thread int keys_capacity = 0;
 
-int keys_finalized = 0;
-int deletes_finalized = 0;
-int inserts_finalized = 0;
+static __thread int keys_finalized = 0;
+//Our own keys (key_set.h), kept in step with deletes and inserts so local queries see them
+static __thread KeySet key_table;
+static __thread int deletes_finalized = 0;
+static __thread int inserts_finalized = 0;
 
-BloomFilter own_bloom;
-BloomFilter *peer_bloom_filters = NULL;
+static __thread BloomFilter own_bloom;
+static __thread BloomFilter *peer_bloom_filters = NULL;
 
-int bloom_initialized = 0;
-int *peer_bloom_received = NULL;
-int bloom_broadcasted = 0;
+static __thread int bloom_initialized = 0;
+static __thread int *peer_bloom_received = NULL;
+//Phase of every peer's filter we hold (the request_id of its MSG_BLOOM_FILTER)
+static __thread uint32_t *peer_bloom_phase = NULL;
+static __thread int bloom_broadcasted = 0;
+static __thread int broadcast_acked = 0;
+//Phase of our last build, the key build or an update; our filter goes out under it and its MSG_BROADCAST_DONE waits
+//for the peers' filters of the same phase
+static __thread uint32_t build_phase = 0;
 
-int comm_fd = -1;
+static __thread int comm_fd = -1;
+//Queries forwarded to peers whose answers are still missing
+static __thread InflightTable peer_queries;
+static __thread EventLoop event_loop;
 
-struct {
+static __thread struct {
     double total_own_lookup_ms;
     double total_all_peer_bloom_checks_ms;
     double total_single_bloom_check_ms;
@@ -48,62 +63,40 @@ struct {
     int num_updates;
 } bloom_stats = {0, 0, 0, 0, 0, 0, 0, 0};
 
-void signal_handler(int signum);
-int check_own_keys(int key);
-void assign_keys_from_message(const char *msg);
-void create_own_bloom_filter();
-void broadcast_bloom_filter();
-void update_peer_bloom_filter_from_file(int peer_id, const char *bloom_data);
-void handle_query_from_manager(const char *msg);
-void handle_bloom_message(const char *msg);
-void handle_query_from_process(const char *msg);
-void remove_keys_from_message(const char *msg);
-void insert_keys_from_message(const char *msg);
-void rebuild_hash_and_bloom_and_broadcast();
+static void shutdown_process();
+static void destroy_peer_filter(int peer_id);
+static int check_own_keys(int key);
+static void append_keys(const int *new_keys, int count);
+static void assign_keys_from_segment(const MsgHeader *hdr, const char *payload);
+static void create_own_bloom_filter();
+static void broadcast_bloom_filter();
+static void update_peer_bloom_filter_from_fd(int peer_id, int fd);
+static void handle_query_from_manager(const MsgHeader *hdr, const char *payload);
+static void handle_bloom_message(const MsgHeader *hdr, const char *payload);
+static void handle_query_from_process(const MsgHeader *hdr, const char *payload);
+static void handle_response_from_process(const MsgHeader *hdr, const char *payload);
+static void send_ack(MsgType type, uint32_t phase);
+static void check_broadcast_done();
+static void remove_keys(const int *del_list, int del_count);
+static void insert_keys(const int *new_keys_in_msg, int count);
+static void delete_keys_from_segment(const MsgHeader *hdr, const char *payload);
+static void insert_keys_from_segment(const MsgHeader *hdr, const char *payload);
+static void finalize_keys(const MsgHeader *hdr, const char *payload);
+static void finalize_deletes(const MsgHeader *hdr, const char *payload);
+static void finalize_inserts(const MsgHeader *hdr, const char *payload);
+static void rebuild_hash_and_bloom_and_broadcast();
 
 //This is used to remove the "delete keys" from the array before creating the hash table and bloom filters
-void remove_keys_from_message(const char *msg){
+static void remove_keys(const int *del_list, int del_count){
     int deleted_count = 0;
-    const char *ptr = msg+strlen("DELETE_KEYS:");
-    char *copy = strdup(ptr);
-    char *tok = strtok(copy, ",");
-    if(tok == NULL){
-        free(copy);
+    if(del_count == 0){
         return;
     }
-    while(tok != NULL){
-        int del_key = atoi(tok);
-        int write_idx = 0;
-        for(int i = 0; i < num_keys; i++){
-            if(keys[i] == del_key){
-                deleted_count++;
-                continue;
-            }else{
-                keys[write_idx++] = keys[i];
-            }
-        }
-        tok = strtok(NULL, ",");
+    for(int j = 0; j < del_count; j++){
+        key_set_remove(&key_table, del_list[j]);
     }
-    free(copy);
-
-    const char *ptr2 = msg+strlen("DELETE_KEYS:");
-    char *copy2 = strdup(ptr2);
-    char *tok2 = strtok(copy2, ",");
 
     //the rest is to delete the keys that could be duplicate
-    int del_capacity = 1024;
-    int del_count = 0;
-    int *del_list = malloc(del_capacity * sizeof(int));
-    while(tok2 != NULL){
-        if(del_count >= del_capacity){
-            del_capacity *= 2;
-            del_list = realloc(del_list, del_capacity * sizeof(int));
-        }
-        del_list[del_count++] = atoi(tok2);
-        tok2 = strtok(NULL, ",");
-    }
-    free(copy2);
-
     int write = 0;
     for(int i = 0; i < num_keys; i++){
         int keep = 1;
@@ -119,7 +112,6 @@ void remove_keys_from_message(const char *msg){
         }
     }
     num_keys = write;
-    free(del_list);
     
 
     //so the deleted count can be a little larger than the normal delete count because of duplicates
@@ -128,12 +120,9 @@ void remove_keys_from_message(const char *msg){
 }
 
 //This is to insert (update) new keys for measuring time to recreate bloom filters
-void insert_keys_from_message(const char *msg){
-    const char *ptr = msg + strlen("UPDATE_KEYS:");
-    char *copy = strdup(ptr);
-    char *tok = strtok(copy, ",");
+static void insert_keys(const int *new_keys_in_msg, int count){
     int inserted_count = 0;
-    while(tok != NULL){
+    for(int k = 0; k < count; k++){
         if(num_keys >= keys_capacity){
             int new_capacity;
             if(keys_capacity == 0){
@@ -145,51 +134,93 @@ void insert_keys_from_message(const char *msg){
             keys = new_keys;
             keys_capacity = new_capacity;
         }
-        keys[num_keys++] = atoi(tok);
+        keys[num_keys++] = new_keys_in_msg[k];
+        if(key_set_add(&key_table, new_keys_in_msg[k]) < 0){
+            fprintf(stderr, "Process %d failed to insert key %d\n", process_id, new_keys_in_msg[k]);
+        }
         inserted_count++;
-        tok = strtok(NULL, ",");
     }
-    free(copy);
     
     bloom_stats.num_updates += inserted_count;
 }
 
+//The keys come in one key segment (key_segment.h) of all processes, we only need our own slice
+//The segment is mapped just for the handler, so the slice is copied: inserts grow the key array later
+static void assign_keys_from_segment(const MsgHeader *hdr, const char *payload){
+    const int *own;
+    int count = key_segment_slice(hdr, payload, process_id, &own);
+    append_keys(own, count);
+    finalize_keys(hdr, payload);
+}
+
+//Deletes and inserts come as key segments too, every process rebuilds its bloom from its slice and reports MSG_BUILT
+static void delete_keys_from_segment(const MsgHeader *hdr, const char *payload){
+    const int *own;
+    int count = key_segment_slice(hdr, payload, process_id, &own);
+    remove_keys(own, count);
+    finalize_deletes(hdr, payload);
+}
+
+static void insert_keys_from_segment(const MsgHeader *hdr, const char *payload){
+    const int *own;
+    int count = key_segment_slice(hdr, payload, process_id, &own);
+    insert_keys(own, count);
+    finalize_inserts(hdr, payload);
+}
+
 //Once we receive the command to reconstruct the bloom
-void finalize_deletes(){
+static void finalize_deletes(const MsgHeader *hdr, const char *payload){
     if(deletes_finalized){
         return;
     }
     printf("Received all keys, now hashing and broadcasting\n");
+    build_phase = hdr->request_id;
     rebuild_hash_and_bloom_and_broadcast();
+    send_ack(MSG_BUILT, hdr->request_id);
 }
 
 //Once we receive the command that insert keys are completed, so start reconstructing the bloom
-void finalize_inserts(){
+static void finalize_inserts(const MsgHeader *hdr, const char *payload){
     if(inserts_finalized){
         return;
     }
+    build_phase = hdr->request_id;
     rebuild_hash_and_bloom_and_broadcast();
+    send_ack(MSG_BUILT, hdr->request_id);
 }
 
 
 //To reconstruct the bloom after receiving deletes and inserts
-//We do not rebuild hash table, because it does not play a role
-void rebuild_hash_and_bloom_and_broadcast(){
+//The hash table of our own keys is not rebuilt, remove_keys and insert_keys already updated it
+//The new filter goes out to all peers right away, each of them swaps it in for the one it held; the update is over
+//once we hold the new filters of all peers too (check_broadcast_done)
+static void rebuild_hash_and_bloom_and_broadcast(){
     printf("Building bloom and broadcasting\n");
     
     keys_finalized = 1;
     struct timespec bloom_update_start, bloom_update_end;
     clock_gettime(CLOCK_MONOTONIC, &bloom_update_start);
     create_own_bloom_filter();
-    //bloom_broadcasted = 0;
-    //broadcast_bloom_filter();
+    bloom_broadcasted = 0;
+    broadcast_acked = 0;
+    broadcast_bloom_filter();
     clock_gettime(CLOCK_MONOTONIC, &bloom_update_end);
     double bloom_update_timing_ms = (bloom_update_end.tv_sec - bloom_update_start.tv_sec) * 1000.0 + (bloom_update_end.tv_nsec - bloom_update_start.tv_nsec) / 1000000.0;
     bloom_stats.total_update_time += bloom_update_timing_ms;
 }
 
 
-void signal_handler(int signum){
+//Peer filters live in the mappings of ipc_memfd_map, which are shared between the node threads of the manager
+static void destroy_peer_filter(int peer_id){
+    BloomFilter *filter = &peer_bloom_filters[peer_id];
+    const void *addr = filter->bloom;
+    size_t size = filter->__filesize;
+    bloom_filter_destroy(filter);
+    ipc_memfd_unmap(addr, size);
+}
+
+//Writes the stats and releases everything, on SIGTERM or when the manager stops the node threads
+static void shutdown_process(){
     if(bloom_stats.num_own_lookups > 0 || bloom_stats.num_query_rounds > 0){
         char stats_file[256];
         snprintf(stats_file, sizeof(stats_file), "/tmp/process_%d_bloom_stats.txt", process_id);
@@ -215,17 +246,38 @@ void signal_handler(int signum){
             fprintf(fp, "Avg time to check all peers: %.6f ms (%.2f μs)\n", (bloom_stats.total_all_peer_bloom_checks_ms / bloom_stats.num_query_rounds), (bloom_stats.total_all_peer_bloom_checks_ms / bloom_stats.num_query_rounds) * 1000);
             fprintf(fp, "Total time to recreate and broadcast bloom after deletes first and then inserts again : %.6f ms\n", bloom_stats.total_update_time);
             fprintf(fp, "Total updates: %d\n", bloom_stats.num_updates);
+            fprintf(fp, "\n");
+            fprintf(fp, "Event loop:\n");
+            fprintf(fp, "Messages caught while spinning: %llu\n", (unsigned long long)event_loop.num_spin_hits);
+            fprintf(fp, "Blocking waits: %llu\n", (unsigned long long)event_loop.num_blocks);
+            fprintf(fp, "Receive batches: %llu (%.2f messages per call)\n", (unsigned long long)event_loop.num_batches,
+                    event_loop.num_batches > 0 ? (double)event_loop.num_msgs / event_loop.num_batches : 0.0);
+            fprintf(fp, "\n");
+            coalesce_print_stats(fp);
+            fprintf(fp, "\n");
+            ipc_print_stats(fp);
             fclose(fp);
             printf("Process %d Stats written to %s\n", process_id, stats_file);
         }
     }
+    ProcessStats stats = {0};
+    stats.summary_bytes = bloom_initialized ? own_bloom.bloom_length : 0;
+    stats.num_keys = num_keys;
+    stats.own_lookups = bloom_stats.num_own_lookups;
+    stats.own_lookup_ms = bloom_stats.total_own_lookup_ms;
+    stats.query_rounds = bloom_stats.num_query_rounds;
+    stats.summary_checks = bloom_stats.num_individual_bloom_checks;
+    stats.summary_check_ms = bloom_stats.total_single_bloom_check_ms;
+    stats.updates = bloom_stats.num_updates;
+    stats.update_ms = bloom_stats.total_update_time;
+    process_stats_write(process_id, "bloom", &stats);
     if(bloom_initialized){
         bloom_filter_destroy(&own_bloom);
     }
     if(peer_bloom_filters != NULL){
         for(int i = 0; i < num_processes; i++){
             if(peer_bloom_received && peer_bloom_received[i]){
-                bloom_filter_destroy(&peer_bloom_filters[i]);
+                destroy_peer_filter(i);
             }
         }
         free(peer_bloom_filters);
@@ -234,85 +286,83 @@ void signal_handler(int signum){
     if(peer_bloom_received != NULL){
         free(peer_bloom_received);
     }
+    free(peer_bloom_phase);
     if(keys != NULL){
         free(keys);
     }
 
-    hdestroy();
+    key_set_destroy(&key_table);
     if(comm_fd >= 0){
         close_communication(process_id, comm_fd);
     }
+}
 
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "%s/bloom_process_%d.dat", BLOOM_FILE_DIR, process_id);
-    unlink(filepath);
+static void signal_handler(int signum){
+    shutdown_process();
     exit(0);
 }
 
 //Checking own hash table
-int check_own_keys(int key){
+static int check_own_keys(int key){
     if(!keys_finalized) return 0;
-    char key_str[32];
-    snprintf(key_str, sizeof(key_str), "%d", key);
-
-    ENTRY e, *ep;
-    e.key = key_str;
-    e.data = NULL;
-
-    ep = hsearch(e, FIND);
-    return (ep != NULL);
-
+    return key_set_contains(&key_table, key);
 }
 
 //Receive keys and add to array before hashing
-void assign_keys_from_message(const char *msg){
-    const char *ptr = msg+5;
-    char *copy = strdup(ptr);
-    char *tok = strtok(copy, ",");
-    while(tok != NULL){
+static void append_keys(const int *msg_key_list, int count){
+    for(int k = 0; k < count; k++){
         if(num_keys >= keys_capacity){
             int new_capacity = keys_capacity == 0 ? 100000 : keys_capacity * 2;
             int *new_keys = realloc(keys, new_capacity * sizeof(int));
             if(new_keys == NULL){
                 fprintf(stderr, "ERROR HAPPENED: process %d failed to allocate memory for keys \n", process_id);
-                free(copy);
                 exit(1);
             }
             keys = new_keys;
             keys_capacity = new_capacity;
         }
-        keys[num_keys++] = atoi(tok);
-        tok = strtok(NULL, ",");
+        keys[num_keys++] = msg_key_list[k];
     }
-    free(copy);
 }
 
 //Once received all keys, hash and create bloom
-void finalize_keys(){
+static void finalize_keys(const MsgHeader *hdr, const char *payload){
     if(keys_finalized) return;
-    if(hcreate(num_keys * 2) == 0){
+    if(key_set_init(&key_table, num_keys) != 0){
         fprintf(stderr, "[ERROR HAPPENED] Process %d failed to create hash table \n", process_id);
         exit(1);
     }
 
     for(int i = 0; i < num_keys; i++){
-        char *key_str = malloc(32);
-        snprintf(key_str, 32, "%d", keys[i]);
-
-        ENTRY e;
-        e.key = key_str;
-        e.data = (void*)(long)1;
-        if(hsearch(e, ENTER) == NULL){
+        if(key_set_add(&key_table, keys[i]) < 0){
             fprintf(stderr, "Process %d failed to insert key %d\n", process_id, keys[i]);
         }
     }
 
     keys_finalized = 1;
     create_own_bloom_filter();
+    build_phase = hdr->request_id;
+    send_ack(MSG_BUILT, build_phase);
+}
+
+//Acks for the manager's phase barriers (barrier.h), phase is the request_id of the command that started the phase
+static void send_ack(MsgType type, uint32_t phase){
+    send_frame(process_id, num_processes, type, phase, process_id, NULL, 0);
+}
+
+//MSG_BROADCAST_DONE once our filter went out and the filters all peers built in the same phase came in
+static void check_broadcast_done(){
+    if(broadcast_acked || !bloom_broadcasted) return;
+    for(int p = 0; p < num_processes; p++){
+        if(p == process_id) continue;
+        if(peer_bloom_received == NULL || !peer_bloom_received[p] || peer_bloom_phase[p] != build_phase) return;
+    }
+    broadcast_acked = 1;
+    send_ack(MSG_BROADCAST_DONE, build_phase);
 }
 
 //Create own bloom filter after receiving all keys
-void create_own_bloom_filter(){
+static void create_own_bloom_filter(){
     if(bloom_initialized){
         bloom_filter_destroy(&own_bloom);
     }
@@ -327,70 +377,68 @@ void create_own_bloom_filter(){
 }
 
 //Once blooms are ready, broadcast to peers
-void broadcast_bloom_filter(){
+//The filter is exported once into a sealed memfd and every peer maps that same buffer, nothing goes through the filesystem
+static void broadcast_bloom_filter(){
     if(bloom_broadcasted) return;
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "%s/bloom_process_%d.dat", BLOOM_FILE_DIR, process_id);
-    int result = bloom_filter_export(&own_bloom, filepath);
-    if(result != BLOOM_SUCCESS){
+    uint64_t size = bloom_filter_export_size(&own_bloom);
+    void *addr;
+    int fd = ipc_memfd_create("bloom_process", size, &addr);
+    if(fd < 0 || bloom_filter_export_to_memory(&own_bloom, addr, size) != BLOOM_SUCCESS || ipc_memfd_seal(fd, addr, size) < 0){
         fprintf(stderr, "ERROR HAPPENED: process %d failed to export bloom filter", process_id);
+        if(fd >= 0) close(fd);
         return;
     }
+    printf("Process %d Bloom Filter size: %lu bytes (%.2f KB, %.2f MB)\n", process_id, (unsigned long)size, size/1024.0, size/(1024.0*1024.0));
 
-    FILE *fp = fopen(filepath, "rb");
-    if(fp){
-        fseek(fp, 0, SEEK_END);
-        long size = ftell(fp);
-        fclose(fp);
-        printf("Process %d Bloom Filter size: %ld bytes (%.2f KB, %.2f MB)\n", 
-               process_id, size, size/1024.0, size/(1024.0*1024.0));
-    }
-
-    char msg[256];
-    snprintf(msg, sizeof(msg), "BLOOM_FILE:%d:%s", process_id, filepath);
-
+    int peers[MAX_PROCESSES];
+    int num_peers = 0;
     for (int p = 0; p < num_processes; p++){
         if(p == process_id) continue;
-        send_msg(process_id, p, msg);
+        peers[num_peers++] = p;
     }
+    send_fd_frame(process_id, peers, num_peers, MSG_BLOOM_FILTER, build_phase, process_id, fd, 0);
+    close(fd);
     bloom_broadcasted = 1;
 }
 
 //receive blooms from peers
-void handle_bloom_message(const char *msg){
-    if(strncmp(msg, "BLOOM_FILE:", 11) != 0){
+static void handle_bloom_message(const MsgHeader *hdr, const char *payload){
+    int peer_id = hdr->arg;
+    int fd = msg_fd(hdr, payload);
+    if(peer_id < 0 || peer_id >= num_processes || fd < 0){
         fprintf(stderr, "Process %d invalid bloom message \n", process_id);
+        if(fd >= 0) close(fd);
         return;
     }
-
-    int peer_id = atoi(msg+11);
-    const char *colon = strchr(msg+11, ':');
-    if(colon == NULL) return;
-
-    const char *filepath = colon + 1;
-    update_peer_bloom_filter_from_file(peer_id, filepath);
+    update_peer_bloom_filter_from_fd(peer_id, fd);
+    peer_bloom_phase[peer_id] = hdr->request_id;
 }
 
-//once received blooms from peers, recreate it from the file for peers
-void update_peer_bloom_filter_from_file(int peer_id, const char *filepath){
+//once received blooms from peers, use the peer's buffer in place (read-only mapping, no copy)
+static void update_peer_bloom_filter_from_fd(int peer_id, int fd){
     if(peer_bloom_filters == NULL){
         peer_bloom_filters = calloc(num_processes, sizeof(BloomFilter));
         peer_bloom_received = calloc(num_processes, sizeof(int));
+        peer_bloom_phase = calloc(num_processes, sizeof(uint32_t));
     }
     if(peer_bloom_received[peer_id]){
-        bloom_filter_destroy(&peer_bloom_filters[peer_id]);
+        destroy_peer_filter(peer_id);
+        peer_bloom_received[peer_id] = 0;
     }
-    int result = bloom_filter_import(&peer_bloom_filters[peer_id], (char*)filepath);
-    if(result == BLOOM_SUCCESS){
+    size_t size;
+    const void *addr = ipc_memfd_map(fd, &size);
+    if(addr != NULL && bloom_filter_import_mapped(&peer_bloom_filters[peer_id], addr, size) == BLOOM_SUCCESS){
         peer_bloom_received[peer_id] = 1;
     } else {
+        ipc_memfd_unmap(addr, size);
         fprintf(stderr, "[ERROR HAPPENED] : Process %d failed to import bloom filter from %d\n", process_id, peer_id);
     }
 }
 
 //User query is below, it will come from manager (manager.c simulates users)
-void handle_query_from_manager(const char *msg){
-    int key = atoi(msg + 6);
+static void handle_query_from_manager(const MsgHeader *hdr, const char *payload){
+    int count;
+    int key = msg_keys(hdr, payload, &count)[0];
 
     struct timespec own_start, own_end;
     clock_gettime(CLOCK_MONOTONIC, &own_start);
@@ -402,9 +450,7 @@ void handle_query_from_manager(const char *msg){
     bloom_stats.num_own_lookups++;
 
     if(found_locally){
-        char response[BUF_SIZE];
-        snprintf(response, sizeof(response), "FOUND:%d:PROCESS_%d", key, process_id);
-        send_msg(process_id, num_processes, response);
+        coalesce_send_key_frame(process_id, hdr->sender, MSG_FOUND, hdr->request_id, process_id, key);
         return;
     }
     char key_str[32];
@@ -414,6 +460,7 @@ void handle_query_from_manager(const char *msg){
     clock_gettime(CLOCK_MONOTONIC, &all_peers_start);
 
     int queries_sent = 0;
+    int pquery_targets[MAX_PROCESSES];
     for (int p = 0; p < num_processes; p++){
         if(p == process_id) continue;
         if(peer_bloom_received != NULL && peer_bloom_received[p]){
@@ -427,141 +474,127 @@ void handle_query_from_manager(const char *msg){
             bloom_stats.num_individual_bloom_checks++;
             
             if(check_result != BLOOM_FAILURE){
-                char buf[BUF_SIZE];
-                snprintf(buf, sizeof(buf), "PQUERY:%d:FROM_%d", key, process_id);
-                send_msg(process_id, p, buf);
+                pquery_targets[queries_sent] = p;
                 queries_sent++;
             }
         }
     }
 
+    //All peers that may have the key get the PQUERY with a single send call
+    //Their answers find the client through the in-flight entry, so with the table full the query is answered right
+    //away instead, like by a process that isn't ready (MSG_NOTFOUND from -1)
+    if(queries_sent > 0){
+        InflightEntry *pending = inflight_insert(&peer_queries, hdr->request_id);
+        if(pending != NULL){
+            pending->owner = hdr->sender;
+            pending->key = key;
+            pending->remaining = queries_sent;
+            coalesce_send_key_frame_batch(process_id, pquery_targets, queries_sent, MSG_PQUERY, hdr->request_id, process_id, key);
+        } else{
+            coalesce_send_key_frame(process_id, hdr->sender, MSG_NOTFOUND, hdr->request_id, -1, key);
+        }
+    }
+
     clock_gettime(CLOCK_MONOTONIC, &all_peers_end);
     double all_peers_ms = (all_peers_end.tv_sec - all_peers_start.tv_sec) * 1000.0 + (all_peers_end.tv_nsec - all_peers_start.tv_nsec) / 1000000.0;
     bloom_stats.total_all_peer_bloom_checks_ms += all_peers_ms;
     bloom_stats.num_query_rounds++;
     
     if(queries_sent == 0){
-        char response[BUF_SIZE];
-        snprintf(response, sizeof(response), "NOTFOUND:%d:CHECKED_BY_PROCESS_%d", key, process_id);
-        send_msg(process_id, num_processes, response);
+        coalesce_send_key_frame(process_id, hdr->sender, MSG_NOTFOUND, hdr->request_id, process_id, key);
     }
 }
 
 //This is for handling the "redirected" query from a peer cache
-void handle_query_from_process(const char *msg){
-    if(strncmp(msg, "PQUERY:", 7) != 0){
-        return;
-    }
-    int key = atoi(msg+7);
-    const char *from_marker = strstr(msg, ":FROM_");
-    int sender_process = -1;
-    if(from_marker != NULL){
-        sender_process = atoi(from_marker + 6);
-    }
+static void handle_query_from_process(const MsgHeader *hdr, const char *payload){
+    int count;
+    int key = msg_keys(hdr, payload, &count)[0];
+    int sender_process = hdr->sender;
     if(check_own_keys(key)){
         if(sender_process >= 0){
-            char response[BUF_SIZE];
-            snprintf(response, sizeof(response), "PFOUND:%d:IN_PROCESS_%d", key, process_id);
-            send_msg(process_id, sender_process, response);
+            coalesce_send_key_frame(process_id, sender_process, MSG_PFOUND, hdr->request_id, process_id, key);
         }
     } else{
         if(sender_process >= 0){
-            char response[BUF_SIZE];
-            snprintf(response, sizeof(response), "PNOTFOUND:%d:IN_PROCESS_%d", key, process_id);
-            send_msg(process_id, sender_process, response);
+            coalesce_send_key_frame(process_id, sender_process, MSG_PNOTFOUND, hdr->request_id, process_id, key);
         }
     }
 }
 
 //To see if peer found or not the peer redirected key locally
-//We can later use this function to redirect the "not found" key to the web server
-void handle_response_from_process(const char *msg){
-    if(strncmp(msg, "PFOUND:", 7) == 0){
-        int key = atoi(msg + 7);
-        const char *process_marker = strstr(msg, ":IN_PROCESS_");
-        int found_in_process = -1;
-        if(process_marker != NULL){
-            found_in_process = atoi(process_marker + 12);
+//A PFOUND is forwarded to the client that asked right away; once every peer we asked answered and none of them had
+//the key (all summary hits were false positives) it gets MSG_NOTFOUND, so every query with a request id is answered
+//Only forwarded queries have an entry, an answer without one has nobody left to go to
+static void handle_response_from_process(const MsgHeader *hdr, const char *payload){
+    int count;
+    int key = msg_keys(hdr, payload, &count)[0];
+    InflightEntry *pending = inflight_find(&peer_queries, hdr->request_id);
+    if(pending == NULL){
+        return;
+    }
+    if(hdr->type == MSG_PFOUND){
+        int found_in_process = hdr->arg;
+        coalesce_send_key_frame(process_id, pending->owner, MSG_FOUND, hdr->request_id, found_in_process, key);
+        pending->found = 1;
+    }
+    if(--pending->remaining == 0){
+        if(!pending->found){
+            coalesce_send_key_frame(process_id, pending->owner, MSG_NOTFOUND, hdr->request_id, process_id, key);
         }
-        char response[BUF_SIZE];
-        snprintf(response, sizeof(response), "FOUND:%d:PROCESS_%d", key, found_in_process);
-        send_msg(process_id, num_processes, response);
-    } else if (strncmp(msg, "PNOTFOUND:", 10) == 0){
-        int key = atoi(msg + 10);
-        const char *process_marker = strstr(msg, ":IN_PROCESS_");
-        //int checked_process = -1;
-        //if(process_marker != NULL){
-          //  checked_process = atoi(process_marker + 12);
-        //}
+        inflight_remove(&peer_queries, pending);
     }
 }
 
+static const MsgHandler handlers[MSG_TYPE_COUNT] = {
+    [MSG_KEY_SEGMENT] = assign_keys_from_segment,
+    [MSG_QUERY] = handle_query_from_manager,
+    [MSG_BLOOM_FILTER] = handle_bloom_message,
+    [MSG_PQUERY] = handle_query_from_process,
+    [MSG_PFOUND] = handle_response_from_process,
+    [MSG_PNOTFOUND] = handle_response_from_process,
+    [MSG_DELETE_SEGMENT] = delete_keys_from_segment,
+    [MSG_INSERT_SEGMENT] = insert_keys_from_segment,
+};
 
 
 
-
-int main(int argc, char *argv[]){
+//The node: a process of its own, or a thread of the manager with IPC_TRANSPORT=thread (see Manager.c)
+int bloom_process_main(int argc, char *argv[]){
     process_id = atoi(argv[1]);
     num_processes = atoi(argv[2]);
 
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    if(!ipc_in_process()){
+        signal(SIGINT, signal_handler);
+        signal(SIGTERM, signal_handler);
+    }
 
     comm_fd = initiate_communication(process_id);
+    send_ack(MSG_READY, 0);
 
-    char *buf = malloc(BLOOM_MSG_SIZE);
 
-    if(buf == NULL){
-        fprintf(stderr, "Process %d failed to allocate receive buffer\n", process_id);
-        return 1;
-    }
+    event_loop_init(&event_loop, comm_fd, BLOOM_MSG_SIZE);
+    coalesce_init(&event_loop);
+    inflight_init(&peer_queries, INFLIGHT_PEER_QUERIES);
 
-    while(1){
+    while(!ipc_threads_stopping()){
         if(bloom_initialized && !bloom_broadcasted){
             broadcast_bloom_filter();
         }
+        check_broadcast_done();
 
-        int messages_processed = 0;
-        while(1){
-            int n = receive_msg(comm_fd, buf, BLOOM_MSG_SIZE);
-            if(n <= 0) break;
-            messages_processed++;
-            if (strncmp(buf, "KEYS:", 5) == 0) {
-                assign_keys_from_message(buf);
-            } else if(strncmp(buf, "KEYS_DONE", 9) == 0){
-                finalize_keys();
-            } else if (strncmp(buf, "QUERY:", 6) == 0) {
-                handle_query_from_manager(buf);
-            } else if (strncmp(buf, "BLOOM_FILE:", 11) == 0) {
-                handle_bloom_message(buf);
-            } else if (strncmp(buf, "PQUERY:", 7) == 0) {
-                handle_query_from_process(buf);
-            } else if (strncmp(buf, "PFOUND:", 7) == 0 || strncmp(buf, "PNOTFOUND:", 10) == 0) {
-                handle_response_from_process(buf);
-            } else if(strncmp(buf, "DELETE_KEYS:", 12) == 0){
-                remove_keys_from_message(buf);
-            } else if(strncmp(buf, "UPDATE_KEYS:", 12) == 0){
-                insert_keys_from_message(buf);
-            }else if(strncmp(buf, "UPDATES_DONE", 12) == 0){
-                finalize_inserts();
-            } else if(strncmp(buf, "DELETE_KEYS_DONE", 16) == 0){
-                finalize_deletes();
-            }
-            else {
-                fprintf(stderr, "[Process %d] Unknown message: %s\n", process_id, buf);
-            }
-        }
-        if (messages_processed == 0) {
-            usleep(1000);
+        const char *msg;
+        int n = event_loop_next_msg(&event_loop, &msg);
+        if(n <= 0) continue;
+        if(dispatch_msg(handlers, msg, n) < 0){
+            fprintf(stderr, "[Process %d] Unknown message of %d bytes\n", process_id, n);
         }
     }
-    free(buf);
-    signal_handler(0);
-    
+    shutdown_process();
     return 0;
 }
 
-
-
-
-
+#ifndef PROCESS_IN_MANAGER
+int main(int argc, char *argv[]){
+    return bloom_process_main(argc, argv);
+}
+#endif
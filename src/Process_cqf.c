@@ -1,46 +1,43 @@
-#define _POSIX_C_SOURCE 199309L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
-#include <search.h>
 #include <time.h>
 #include "IPC.h"
+#include "event_loop.h"
+#include "coalesce.h"
+#include "inflight.h"
+#include "key_segment.h"
+#include "process_stats.h"
+#include "key_set.h"
 #include "../cqf/include/gqf.h"
 #include "../cqf/include/gqf_int.h"
 #include "../cqf/include/gqf_file.h"
 
-#define BUF_SIZE 256
 #define DT_MSG_SIZE 262144 
 #define CQF_FILE_DIR "/tmp"
 
-int process_id; 
-int num_processes; 
+//Node state is per thread, so that the manager can also run the nodes as threads (IPC_TRANSPORT=thread)
+static __thread int process_id; 
+static __thread int num_processes; 
 
 
-int *own_keys = NULL;
-int num_own_keys = 0;
-int own_keys_capacity = 0;
+static __thread int num_keys = 0;
+static __thread int keys_finalized = 0;
+//Our own keys (key_set.h), kept in step with deletes and inserts so local queries see them
+static __thread KeySet key_table;
 
-typedef struct{
-    int key;
-    int owner_process_id;
-} KeyOwnerPair;    
+static __thread QF global_cqf;
+static __thread int cqf_initialized = 0;
 
-KeyOwnerPair *all_keys = NULL;
+static __thread int comm_fd = -1;
+//Queries forwarded to peers whose answers are still missing
+static __thread InflightTable peer_queries;
+static __thread EventLoop event_loop;
 
-int num_all_keys = 0;
-int all_keys_capacity = 0;
-
-int keys_finalized = 0;
-
-QF global_cqf;
-int cqf_initialized = 0;
-
-int comm_fd = -1;
-
-struct {
+static __thread struct {
     double total_own_lookup_ms;
     double total_all_cqf_checks_ms;
     double total_single_cqf_check_ms;
@@ -51,19 +48,21 @@ struct {
     int num_cqf_updates;
 } cqf_stats = {0, 0, 0, 0, 0, 0, 0, 0};
 
-void signal_handler(int signum);
-int check_own_keys(int key);
-void assign_own_keys_from_message(const char *msg);
-void assign_all_keys_from_message(const char *msg);
-void finalize_keys();
-void create_cqf();
-void handle_query_from_manager(const char *msg);
-void handle_query_from_process(const char *msg);
-void handle_response_from_process(const char *msg);
-void handle_delete_keys(const char *msg);
-void handle_insert_keys(const char *msg);
-
-uint64_t hash_key(int key){
+static void shutdown_process();
+static int check_own_keys(int key);
+static void assign_keys_from_segment(const MsgHeader *hdr, const char *payload);
+static void insert_keys_from_segment(const MsgHeader *hdr, const char *payload);
+static void delete_keys_from_segment(const MsgHeader *hdr, const char *payload);
+static void insert_owner_keys(int owner_id, const int *msg_key_list, int count);
+static void delete_owner_keys(int owner_id, const int *msg_key_list, int count);
+static void finalize_keys(const int *own_keys, int num_own_keys);
+static void create_cqf(const MsgHeader *hdr, const char *payload);
+static void handle_query_from_manager(const MsgHeader *hdr, const char *payload);
+static void handle_query_from_process(const MsgHeader *hdr, const char *payload);
+static void handle_response_from_process(const MsgHeader *hdr, const char *payload);
+static void send_ack(MsgType type, uint32_t phase);
+
+static uint64_t hash_key(int key){
     uint64_t x = (uint64_t)key;
     x = ((x >> 16) ^ x) * 0x45d9f3b;
     x = ((x >> 16) ^ x) * 0x45d9f3b;
@@ -71,7 +70,8 @@ uint64_t hash_key(int key){
     return x;
 }
 
-void signal_handler(int signum){
+//Writes the stats and releases everything, on SIGTERM or when the manager stops the node threads
+static void shutdown_process(){
     if(cqf_stats.num_own_lookups >0 || cqf_stats.num_query_rounds > 0){
         char stats_file[256];
         snprintf(stats_file, sizeof(stats_file), "/tmp/process_%d_stats.txt", process_id);
@@ -97,96 +97,114 @@ void signal_handler(int signum){
             fprintf(fp, "Total time to update: %.6f ms (%.2f μs)\n",cqf_stats.total_cqf_update_ms, cqf_stats.total_cqf_update_ms * 1000);
             fprintf(fp, "Total updates: %d\n", cqf_stats.num_cqf_updates);
             
+            fprintf(fp, "\n");
+            fprintf(fp, "Event loop:\n");
+            fprintf(fp, "Messages caught while spinning: %llu\n", (unsigned long long)event_loop.num_spin_hits);
+            fprintf(fp, "Blocking waits: %llu\n", (unsigned long long)event_loop.num_blocks);
+            fprintf(fp, "Receive batches: %llu (%.2f messages per call)\n", (unsigned long long)event_loop.num_batches,
+                    event_loop.num_batches > 0 ? (double)event_loop.num_msgs / event_loop.num_batches : 0.0);
+            fprintf(fp, "\n");
+            coalesce_print_stats(fp);
+            fprintf(fp, "\n");
+            ipc_print_stats(fp);
             fclose(fp);
             printf("Process %d Stats written to %s\n", process_id, stats_file);
         }
     }
+    ProcessStats stats = {0};
+    stats.summary_bytes = cqf_initialized ? sizeof(qfmetadata) + global_cqf.metadata->total_size_in_bytes : 0;
+    stats.num_keys = num_keys;
+    stats.own_lookups = cqf_stats.num_own_lookups;
+    stats.own_lookup_ms = cqf_stats.total_own_lookup_ms;
+    stats.query_rounds = cqf_stats.num_query_rounds;
+    stats.summary_checks = cqf_stats.num_individual_cqf_checks;
+    stats.summary_check_ms = cqf_stats.total_single_cqf_check_ms;
+    stats.updates = cqf_stats.num_cqf_updates;
+    stats.update_ms = cqf_stats.total_cqf_update_ms;
+    process_stats_write(process_id, "cqf", &stats);
 
     if(cqf_initialized){
         qf_deletefile(&global_cqf);
     }
 
-    if(own_keys != NULL){
-        free(own_keys);
-    }
-
-    if(all_keys != NULL){
-        free(all_keys);
-    }
-
-    hdestroy();
+    key_set_destroy(&key_table);
 
     if(comm_fd >= 0){
         close_communication(process_id, comm_fd);
     }
+}
 
+static void signal_handler(int signum){
+    shutdown_process();
     exit(0);
 }
 
 //Checking own hash table
-int check_own_keys(int key){
+static int check_own_keys(int key){
     if(!keys_finalized) return 0;
+    return key_set_contains(&key_table, key);
+}
 
-    char key_str[32];
-    snprintf(key_str, sizeof(key_str), "%d", key);
-
-    ENTRY e, *ep;
-    e.key = key_str;
-    e.data = NULL;
-
-    ep = hsearch(e, FIND);
-    return (ep != NULL);
+//The keys come in one key segment (key_segment.h): our own slice goes into the hash table and the slices
+//of all processes into the CQF, both read in place from the mapped segment
+static void assign_keys_from_segment(const MsgHeader *hdr, const char *payload){
+    const int *own_keys;
+    int num_own_keys = key_segment_slice(hdr, payload, process_id, &own_keys);
+    num_keys = num_own_keys;
+    finalize_keys(own_keys, num_own_keys);
+    create_cqf(hdr, payload);
+    send_ack(MSG_BUILT, hdr->request_id);
 }
 
-//Receive own keys and add to array before hashing
-void assign_own_keys_from_message(const char *msg){
-    const char *ptr = msg + 10; // "OWN_KEYS:"
-    char *copy = strdup(ptr);
-    char *tok = strtok(copy, ",");
-
-    while (tok != NULL){
-        if(num_own_keys >= own_keys_capacity){
-            int new_capacity = own_keys_capacity == 0 ? 100000 : own_keys_capacity * 2;
-            int *new_keys = realloc(own_keys, new_capacity * sizeof(int));
-            if(new_keys == NULL){
-                fprintf(stderr, "[ERROR HAPPENED] : process %d failed to allocate own_keys\n", process_id);
-                free(copy);
-                exit(1);
+//Insert the update keys of every owner, the CQF is updated on fly
+//Our own slice goes into the hash table too, outside insert_owner_keys so it doesn't count as CQF update time
+static void insert_keys_from_segment(const MsgHeader *hdr, const char *payload){
+    int owners = key_segment_owners(hdr, payload);
+    for(int p = 0; p < owners; p++){
+        const int *msg_key_list;
+        int count = key_segment_slice(hdr, payload, p, &msg_key_list);
+        insert_owner_keys(p, msg_key_list, count);
+        if(p == process_id){
+            for(int k = 0; k < count; k++){
+                if(key_set_add(&key_table, msg_key_list[k]) < 0){
+                    fprintf(stderr, "[ERROR HAPPENED] : Process %d failed to insert into hash table\n", process_id);
+                }
             }
-            own_keys = new_keys;
-            own_keys_capacity = new_capacity;
         }
-        own_keys[num_own_keys++] = atoi(tok);
-        tok = strtok(NULL, ",");
     }
-    free(copy);
-
+    send_ack(MSG_BUILT, hdr->request_id);
+}
 
+static void delete_keys_from_segment(const MsgHeader *hdr, const char *payload){
+    int owners = key_segment_owners(hdr, payload);
+    for(int p = 0; p < owners; p++){
+        const int *msg_key_list;
+        int count = key_segment_slice(hdr, payload, p, &msg_key_list);
+        delete_owner_keys(p, msg_key_list, count);
+        if(p == process_id){
+            for(int k = 0; k < count; k++){
+                key_set_remove(&key_table, msg_key_list[k]);
+            }
+        }
+    }
+    send_ack(MSG_BUILT, hdr->request_id);
 }
 
 //While receving update keys from Manager, update the CQF on fly (insert)
-void update_all_keys_from_message(const char *msg){
-    const char *ptr = msg + 16; // "ALL_UPDATE_KEYS:"
-    int owner_id = atoi(ptr);
-    const char *colon = strchr(ptr, ':');
-    const char *key_str = colon + 1;
-    char *copy = strdup(key_str);
-    char *tok = strtok(copy, ",");
+static void insert_owner_keys(int owner_id, const int *msg_key_list, int count){
     int inserts = 0;
     struct timespec start, end;
     clock_gettime(CLOCK_MONOTONIC, &start);
 
-    while(tok != NULL){
-        int key = atoi(tok);
+    for(int k = 0; k < count; k++){
+        int key = msg_key_list[k];
         uint64_t hash = hash_key(key);
         uint64_t cqf_key = hash % global_cqf.metadata->range;
         int ret = qf_insert(&global_cqf, cqf_key, owner_id, 1, QF_NO_LOCK);
         if(ret >= 0){
             inserts++;
         }
-        tok = strtok(NULL, ",");
     }
-    free(copy);
     clock_gettime(CLOCK_MONOTONIC, &end);
     double elapsed_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
     cqf_stats.num_cqf_updates += inserts;
@@ -196,69 +214,42 @@ void update_all_keys_from_message(const char *msg){
 
 }
 
-//Receive all keys and add to array before hashing
-void assign_all_keys_from_message(const char *msg){
-    const char *ptr = msg+9; //"ALL_KEYS:"
-    int owner_id = atoi(ptr);
-
-    const char *colon = strchr(ptr, ':');
-    const char *key_str = colon + 1;
-    char *copy = strdup(key_str);
-    char *tok = strtok(copy, ",");
-
-    while(tok != NULL){
-        if(num_all_keys >= all_keys_capacity){
-            int new_capacity = all_keys_capacity == 0 ? 200000 : all_keys_capacity * 2;
-            KeyOwnerPair *new_array = realloc(all_keys, new_capacity * sizeof(KeyOwnerPair));
-            if(new_array == NULL){
-                fprintf(stderr, "[ERROR HAPPENED] : process %d failed to allocate all_keys\n", process_id);
-                free(copy);
-                exit(1);
-            }
-            all_keys = new_array;
-            all_keys_capacity = new_capacity;
-        }
-        all_keys[num_all_keys].key = atoi(tok);
-        all_keys[num_all_keys].owner_process_id = owner_id;
-        num_all_keys++;
-        tok = strtok(NULL, ",");
-    }
-    free(copy);
-
-}
-
-//Once received all keys, create hash table
-void finalize_keys(){
+//Create the hash table of our own keys
+static void finalize_keys(const int *own_keys, int num_own_keys){
     if(keys_finalized) return;
 
 
-    if(hcreate(num_own_keys * 2) == 0){
+    if(key_set_init(&key_table, num_own_keys) != 0){
         fprintf(stderr, "[ERROR HAPPENED] : Process %d failed to create hash table\n", process_id);
         exit(1);
     }
     for(int i = 0; i < num_own_keys; i++){
-        char *key_str = malloc(32);
-        snprintf(key_str, 32, "%d", own_keys[i]);
-
-        ENTRY e;
-        e.key = key_str;
-        e.data = (void*)(long)1;
-
-        if(hsearch(e, ENTER) == NULL){
+        if(key_set_add(&key_table, own_keys[i]) < 0){
             fprintf(stderr, "[ERROR HAPPENED] : Process %d failed to insert into hash table\n", process_id);
         }
     }
 
     keys_finalized = 1;
-    create_cqf();
 }
 
-//Once received all keys, create cqf
-void create_cqf(){
+//Acks for the manager's phase barriers (barrier.h), phase is the request_id of the command that started the phase
+static void send_ack(MsgType type, uint32_t phase){
+    send_frame(process_id, num_processes, type, phase, process_id, NULL, 0);
+}
+
+//Create the cqf from the slices of all owners in the key segment
+static void create_cqf(const MsgHeader *hdr, const char *payload){
     if(cqf_initialized){
         qf_deletefile(&global_cqf);
     }
 
+    int owners = key_segment_owners(hdr, payload);
+    uint64_t num_all_keys = 0;
+    for(int p = 0; p < owners; p++){
+        const int *slice;
+        num_all_keys += key_segment_slice(hdr, payload, p, &slice);
+    }
+
     uint64_t qbits = 0;
     uint64_t temp_qbits = num_all_keys - 1;
     while(temp_qbits > 0){
@@ -293,20 +284,23 @@ void create_cqf(){
     int failed_inserts = 0;
     int duplicate_skips = 0;
 
-    for(int i = 0; i < num_all_keys; i++){
-        uint64_t hash = hash_key(all_keys[i].key);
-        uint64_t cqf_key = hash % global_cqf.metadata->range;
-        int owner_id = all_keys[i].owner_process_id;
-        //WE CAN COMMENT THIS OUT AS WELL, FOR DEBUGGING THE RANDOM KEY ISSUES
-        uint64_t existing_count = qf_count_key_value(&global_cqf, cqf_key, owner_id, 0);
-        if(existing_count > 0){
-            duplicate_skips++;
-        } else{
-            int ret = qf_insert(&global_cqf, cqf_key, owner_id, 1, QF_NO_LOCK);
-            if(ret >= 0){
-                successful_inserts++;
-            }else{
-                failed_inserts++;
+    for(int owner_id = 0; owner_id < owners; owner_id++){
+        const int *slice;
+        int count = key_segment_slice(hdr, payload, owner_id, &slice);
+        for(int i = 0; i < count; i++){
+            uint64_t hash = hash_key(slice[i]);
+            uint64_t cqf_key = hash % global_cqf.metadata->range;
+            //WE CAN COMMENT THIS OUT AS WELL, FOR DEBUGGING THE RANDOM KEY ISSUES
+            uint64_t existing_count = qf_count_key_value(&global_cqf, cqf_key, owner_id, 0);
+            if(existing_count > 0){
+                duplicate_skips++;
+            } else{
+                int ret = qf_insert(&global_cqf, cqf_key, owner_id, 1, QF_NO_LOCK);
+                if(ret >= 0){
+                    successful_inserts++;
+                }else{
+                    failed_inserts++;
+                }
             }
         }
     }
@@ -330,27 +324,17 @@ void create_cqf(){
     fflush(stdout);
     cqf_initialized = 1;
     printf("Success - %d, duplicate - %d, failed - %d\n", successful_inserts, duplicate_skips, failed_inserts);
-    free(all_keys);
-    all_keys = NULL;
-    num_all_keys = 0;
-    all_keys_capacity = 0;
 }
 
 //Delete keys on fly
-void handle_delete_keys(const char *msg){
-    const char *ptr = msg + 12; //DELETE_KEYS:
-    int owner_id = atoi(ptr);
-    const char *colon = strchr(ptr, ':');
-    const char *key_str = colon + 1;
-    char *copy = strdup(key_str);
-    char *tok = strtok(copy, ",");
+static void delete_owner_keys(int owner_id, const int *msg_key_list, int count){
     int deletes = 0;
     struct timespec start, end;
     clock_gettime(CLOCK_MONOTONIC, &start);
 
     
-    while(tok != NULL){
-        int key = atoi(tok);
+    for(int k = 0; k < count; k++){
+        int key = msg_key_list[k];
         if(cqf_initialized){
             uint64_t hash = hash_key(key);
             uint64_t cqf_key = hash % global_cqf.metadata->range;
@@ -358,20 +342,19 @@ void handle_delete_keys(const char *msg){
             deletes++;
             (void)ret;
         }
-        tok = strtok(NULL, ",");
     }
     clock_gettime(CLOCK_MONOTONIC, &end);
     double elapsed_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
     cqf_stats.total_cqf_update_ms += elapsed_ms;
     
-    free(copy);
     cqf_stats.num_cqf_updates += deletes;
     //printf("Process %d deleted %d keys in %.3f ms\n", process_id, deletes, elapsed_ms);
 }
 
 //User query is below, it will come from manager (manager.c simulates users)
-void handle_query_from_manager(const char *msg){
-    int key = atoi(msg+6);
+static void handle_query_from_manager(const MsgHeader *hdr, const char *payload){
+    int count;
+    int key = msg_keys(hdr, payload, &count)[0];
 
 
     struct timespec own_start, own_end;
@@ -383,22 +366,20 @@ void handle_query_from_manager(const char *msg){
     cqf_stats.num_own_lookups++;
 
     if(found_locally){
-        char response[BUF_SIZE];
-        snprintf(response, sizeof(response), "FOUND:%d:PROCESS_%d", key, process_id);
-        send_msg(process_id, num_processes, response);
+        coalesce_send_key_frame(process_id, hdr->sender, MSG_FOUND, hdr->request_id, process_id, key);
         return;
     }
 
+    //arg = -1 means the CQF is not ready yet
     if(!cqf_initialized){
-        char response[BUF_SIZE];
-        snprintf(response, sizeof(response), "NOTFOUND:%d:CQF_NOT_READY", key);
-        send_msg(process_id, num_processes, response);
+        coalesce_send_key_frame(process_id, hdr->sender, MSG_NOTFOUND, hdr->request_id, -1, key);
         return;
     }
     struct timespec all_cqf_start, all_cqf_end;
     clock_gettime(CLOCK_MONOTONIC, &all_cqf_start);
 
     int queries_sent = 0;
+    int pquery_targets[MAX_PROCESSES];
     uint64_t hash = hash_key(key);
     uint64_t cqf_key = hash % global_cqf.metadata->range;
 
@@ -416,119 +397,123 @@ void handle_query_from_manager(const char *msg){
         cqf_stats.num_individual_cqf_checks++;
 
         if(count > 0){
-            char buf[BUF_SIZE];
-            snprintf(buf, sizeof(buf), "PQUERY:%d:FROM_%d", key, process_id);
-            send_msg(process_id, p, buf);
+            pquery_targets[queries_sent] = p;
             queries_sent++;
         }
     }
 
+    //All peers that may have the key get the PQUERY with a single send call
+    //Their answers find the client through the in-flight entry, so with the table full the query is answered right
+    //away instead, like by a process that isn't ready (MSG_NOTFOUND from -1)
+    if(queries_sent > 0){
+        InflightEntry *pending = inflight_insert(&peer_queries, hdr->request_id);
+        if(pending != NULL){
+            pending->owner = hdr->sender;
+            pending->key = key;
+            pending->remaining = queries_sent;
+            coalesce_send_key_frame_batch(process_id, pquery_targets, queries_sent, MSG_PQUERY, hdr->request_id, process_id, key);
+        } else{
+            coalesce_send_key_frame(process_id, hdr->sender, MSG_NOTFOUND, hdr->request_id, -1, key);
+        }
+    }
+
     clock_gettime(CLOCK_MONOTONIC, &all_cqf_end);
     double all_cqf_ms = (all_cqf_end.tv_sec - all_cqf_start.tv_sec) * 1000.0 + (all_cqf_end.tv_nsec - all_cqf_start.tv_nsec) / 1000000.0;
     cqf_stats.total_all_cqf_checks_ms += all_cqf_ms;
     cqf_stats.num_query_rounds++;
 
     if(queries_sent == 0){
-        char response[BUF_SIZE];
-        snprintf(response, sizeof(response), "NOTFOUND:%d:CHECKED_BY_PROCESS_%d", key, process_id);
-        send_msg(process_id, num_processes, response);
+        coalesce_send_key_frame(process_id, hdr->sender, MSG_NOTFOUND, hdr->request_id, process_id, key);
     }
 }
 
 //This is for handling the "redirected" query from a peer cache
-void handle_query_from_process(const char *msg){
-    if(strncmp(msg, "PQUERY:", 7) != 0) return;
+static void handle_query_from_process(const MsgHeader *hdr, const char *payload){
+    int count;
+    int key = msg_keys(hdr, payload, &count)[0];
 
-    int key = atoi(msg+7);
-
-    const char *from_marker = strstr(msg, ":FROM_");
-    int sender_process = -1;
-
-    if(from_marker != NULL){
-        sender_process = atoi(from_marker + 6);
-    }
+    int sender_process = hdr->sender;
 
     if(check_own_keys(key)){
         if(sender_process >= 0){
-            char response[BUF_SIZE];
-            snprintf(response, sizeof(response), "PFOUND:%d:IN_PROCESS_%d", key, process_id);
-            send_msg(process_id, sender_process, response);
+            coalesce_send_key_frame(process_id, sender_process, MSG_PFOUND, hdr->request_id, process_id, key);
         }
 
     } else {
         if(sender_process >= 0){
-            char response[BUF_SIZE];
-            snprintf(response, sizeof(response), "PNOTFOUND:%d:IN_PROCESS_%d", key, process_id);
-            send_msg(process_id, sender_process, response);
+            coalesce_send_key_frame(process_id, sender_process, MSG_PNOTFOUND, hdr->request_id, process_id, key);
         }
     }
 }
 
 //To see if peer found or not the peer redirected key locally
-//We can later use this function to redirect the "not found" key to the web server
-void handle_response_from_process(const char *msg){
-    if(strncmp(msg, "PFOUND:", 7) == 0){
-        int key = atoi(msg + 7);
-        const char *process_marker = strstr(msg, ":IN_PROCESS_");
-        int found_in_process = -1;
-        if(process_marker != NULL){
-            found_in_process = atoi(process_marker + 12);
+//A PFOUND is forwarded to the client that asked right away; once every peer we asked answered and none of them had
+//the key (all summary hits were false positives) it gets MSG_NOTFOUND, so every query with a request id is answered
+//Only forwarded queries have an entry, an answer without one has nobody left to go to
+static void handle_response_from_process(const MsgHeader *hdr, const char *payload){
+    int count;
+    int key = msg_keys(hdr, payload, &count)[0];
+    InflightEntry *pending = inflight_find(&peer_queries, hdr->request_id);
+    if(pending == NULL){
+        return;
+    }
+    if(hdr->type == MSG_PFOUND){
+        int found_in_process = hdr->arg;
+        coalesce_send_key_frame(process_id, pending->owner, MSG_FOUND, hdr->request_id, found_in_process, key);
+        pending->found = 1;
+    }
+    if(--pending->remaining == 0){
+        if(!pending->found){
+            coalesce_send_key_frame(process_id, pending->owner, MSG_NOTFOUND, hdr->request_id, process_id, key);
         }
-
-        char response[BUF_SIZE];
-
-        snprintf(response, sizeof(response), "FOUND:%d:PROCESS_%d", key, found_in_process);
-        send_msg(process_id, num_processes, response);
+        inflight_remove(&peer_queries, pending);
     }
 }
 
+static const MsgHandler handlers[MSG_TYPE_COUNT] = {
+    [MSG_KEY_SEGMENT] = assign_keys_from_segment,
+    [MSG_QUERY] = handle_query_from_manager,
+    [MSG_PQUERY] = handle_query_from_process,
+    [MSG_PFOUND] = handle_response_from_process,
+    [MSG_PNOTFOUND] = handle_response_from_process,
+    [MSG_INSERT_SEGMENT] = insert_keys_from_segment,
+    [MSG_DELETE_SEGMENT] = delete_keys_from_segment,
+};
 
-int main(int argc, char *argv[]){
+
+//The node: a process of its own, or a thread of the manager with IPC_TRANSPORT=thread (see Manager.c)
+int cqf_process_main(int argc, char *argv[]){
     process_id = atoi(argv[1]);
     num_processes = atoi(argv[2]);
 
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    if(!ipc_in_process()){
+        signal(SIGINT, signal_handler);
+        signal(SIGTERM, signal_handler);
+    }
 
     comm_fd = initiate_communication(process_id);
     printf("SUCCESS: Process %d started\n", process_id);
+    send_ack(MSG_READY, 0);
 
-    char *buf = malloc(DT_MSG_SIZE);
-
-    while(1){
-        int messages_processed = 0;
-
-        while(1){
-            int n = receive_msg(comm_fd, buf, DT_MSG_SIZE);
-            if(n <= 0) break;
-
-            messages_processed++;
-
-            if(strncmp(buf, "OWN_KEYS:", 9) == 0){
-                assign_own_keys_from_message(buf);
-            } else if(strncmp(buf, "ALL_KEYS:", 9) == 0){
-                assign_all_keys_from_message(buf);
-            } else if(strncmp(buf, "KEYS_DONE", 9) == 0){
-                finalize_keys();
-            } else if(strncmp(buf, "QUERY:", 6) == 0){
-                handle_query_from_manager(buf);
-            } else if(strncmp(buf, "PQUERY:", 7) == 0){
-                handle_query_from_process(buf);
-            } else if(strncmp(buf, "PFOUND:", 7) == 0 || strncmp(buf, "PNOTFOUND:", 10) == 0){
-                handle_response_from_process(buf);
-            } else if(strncmp(buf, "DELETE_KEYS:", 12) == 0){
-                handle_delete_keys(buf);
-            } else if(strncmp(buf, "ALL_UPDATE_KEYS:", 16) == 0){
-                update_all_keys_from_message(buf);
-            }
-        }
 
-        if(messages_processed == 0){
-            usleep(1000);
-        }
+    event_loop_init(&event_loop, comm_fd, DT_MSG_SIZE);
+    coalesce_init(&event_loop);
+    inflight_init(&peer_queries, INFLIGHT_PEER_QUERIES);
+
+    while(!ipc_threads_stopping()){
+        const char *msg;
+        int n = event_loop_next_msg(&event_loop, &msg);
+        if(n <= 0) continue;
+
+        dispatch_msg(handlers, msg, n);
     }
 
-    free(buf);
-    signal_handler(0);
+    shutdown_process();
     return 0;
 }
+
+#ifndef PROCESS_IN_MANAGER
+int main(int argc, char *argv[]){
+    return cqf_process_main(argc, argv);
+}
+#endif
@@ -0,0 +1,159 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "IPC.h"
+#include "barrier.h"
+
+#define NUM_ACK_TYPES (MSG_BROADCAST_DONE - MSG_READY + 1)
+
+static PhaseTiming phases[BARRIER_MAX_PHASES];
+static int num_phases = 0;
+static struct timespec phase_start;
+static const char *phase_name = NULL;
+static uint32_t current_id = 0;
+static uint32_t next_id = 0;
+static int phase_acked = -1;
+static int phase_expected = 0;
+
+//Phase id of the last ack of every type from every process, -1 before the first one
+//Acks are recorded whenever they come in, a process may already be done with the next barrier of the same phase
+static int64_t last_ack[NUM_ACK_TYPES][MAX_PROCESSES];
+static int acks_initialized = 0;
+static uint64_t num_dropped = 0;
+
+static double elapsed_ms(const struct timespec *start){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static int barrier_timeout_ms(){
+    const char *env = getenv("BARRIER_TIMEOUT_S");
+    int timeout_s = env != NULL ? atoi(env) : BARRIER_DEFAULT_TIMEOUT_S;
+    return (timeout_s > 0 ? timeout_s : BARRIER_DEFAULT_TIMEOUT_S) * 1000;
+}
+
+static void record_ack(const char *buf, int len){
+    MsgHeader hdr;
+    const char *payload;
+    if(decode_msg(buf, len, &hdr, &payload) < 0 || hdr.type < MSG_READY || hdr.type > MSG_BROADCAST_DONE
+       || hdr.sender < 0 || hdr.sender >= MAX_PROCESSES){
+        //Nothing is waiting for other messages any more (e.g. answers to queries that timed out)
+        num_dropped++;
+        return;
+    }
+    last_ack[hdr.type - MSG_READY][hdr.sender] = hdr.request_id;
+}
+
+//The first phase gets id 0, which is what the processes send with MSG_READY
+void phase_begin(const char *name){
+    if(!acks_initialized){
+        for(int t = 0; t < NUM_ACK_TYPES; t++){
+            for(int p = 0; p < MAX_PROCESSES; p++){
+                last_ack[t][p] = -1;
+            }
+        }
+        acks_initialized = 1;
+    }
+    phase_name = name;
+    current_id = next_id++;
+    phase_acked = -1;
+    phase_expected = 0;
+    clock_gettime(CLOCK_MONOTONIC, &phase_start);
+}
+
+//request_id for the commands of the current phase, the processes echo it in their acks
+uint32_t phase_id(){
+    return current_id;
+}
+
+//Starts a new step of the current phase with a fresh request_id, for phases that wait at the same barrier more than once
+//(the acks of the first step would otherwise end the second one right away); the phase keeps its name and clock
+uint32_t phase_step(){
+    current_id = next_id++;
+    return current_id;
+}
+
+//Waits until every process sent ack_type for phase id (usually phase_id(), an earlier id for acks that a command of an
+//earlier phase triggers, like MSG_BROADCAST_DONE after the build) or the timeout passed, returns how many did
+int phase_barrier(int fd, MsgType ack_type, uint32_t id, int num_processes){
+    static char buf[IPC_MAX_MSG_SIZE + 1] __attribute__((aligned(8)));
+    struct timespec start;
+    int timeout_ms = barrier_timeout_ms();
+    int t = ack_type - MSG_READY;
+    int acked = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while(1){
+        acked = 0;
+        for(int p = 0; p < num_processes; p++){
+            acked += last_ack[t][p] == id;
+        }
+        if(acked == num_processes){
+            break;
+        }
+        double waited_ms = elapsed_ms(&start);
+        if(waited_ms >= timeout_ms){
+            fprintf(stderr, "[ERROR HAPPENED] : %s barrier of phase %s timed out after %d ms, missing:", msg_type_name(ack_type),
+                    phase_name, timeout_ms);
+            for(int p = 0; p < num_processes; p++){
+                if(last_ack[t][p] != id){
+                    fprintf(stderr, " %d", p);
+                }
+            }
+            fprintf(stderr, "\n");
+            break;
+        }
+        ipc_wait(fd, timeout_ms - (int)waited_ms);
+        int n;
+        while((n = receive_msg(fd, buf, sizeof(buf))) > 0){
+            record_ack(buf, n);
+        }
+    }
+    phase_acked = acked;
+    phase_expected = num_processes;
+    return acked;
+}
+
+void phase_end(){
+    if(phase_name == NULL){
+        return;
+    }
+    PhaseTiming *timing = &phases[num_phases < BARRIER_MAX_PHASES ? num_phases++ : BARRIER_MAX_PHASES - 1];
+    timing->name = phase_name;
+    timing->elapsed_ms = elapsed_ms(&phase_start);
+    timing->acked = phase_acked;
+    timing->expected = phase_expected;
+    if(timing->acked >= 0){
+        printf("Phase %s: %.1f ms (%d/%d processes)\n", timing->name, timing->elapsed_ms, timing->acked, timing->expected);
+    } else{
+        printf("Phase %s: %.1f ms\n", timing->name, timing->elapsed_ms);
+    }
+    fflush(stdout);
+    phase_name = NULL;
+}
+
+//The phases that ended so far, for the results record
+int phase_timings(const PhaseTiming **timings){
+    *timings = phases;
+    return num_phases;
+}
+
+void phase_print(FILE *fp){
+    double total_ms = 0;
+    fprintf(fp, "Phases:\n");
+    for(int i = 0; i < num_phases; i++){
+        fprintf(fp, "%-12s %12.1f ms", phases[i].name, phases[i].elapsed_ms);
+        if(phases[i].acked >= 0 && phases[i].acked < phases[i].expected){
+            fprintf(fp, " (only %d/%d processes)", phases[i].acked, phases[i].expected);
+        }
+        fprintf(fp, "\n");
+        total_ms += phases[i].elapsed_ms;
+    }
+    fprintf(fp, "%-12s %12.1f ms\n", "total", total_ms);
+    if(num_dropped > 0){
+        fprintf(fp, "Messages dropped while waiting: %llu\n", (unsigned long long)num_dropped);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef BARRIER_H
+
+#define BARRIER_H
+#include <stdio.h>
+#include <stdint.h>
+#include "IPC.h"
+
+//Manager side of the phase barriers: instead of sleeping a fixed time, the manager waits until every process
+//acknowledged the phase (MSG_READY after start, MSG_BUILT once its summary is built, MSG_BROADCAST_DONE once it holds
+//every peer's summary), so the next phase starts as soon as the slowest process is done
+//Processes echo the request_id of the command that started the phase, so a late ack can't end a later phase
+//BARRIER_TIMEOUT_S (default 600) bounds every barrier; the run goes on after a timeout and names the missing processes
+
+#define BARRIER_DEFAULT_TIMEOUT_S 600
+#define BARRIER_MAX_PHASES 40         //startup, build, broadcast and SCENARIO_MAX_PHASES scenario phases
+
+typedef struct{
+    const char *name;
+    double elapsed_ms;
+    int acked;              //processes that acknowledged (-1 for phases without a barrier)
+    int expected;
+} PhaseTiming;
+
+void phase_begin(const char *name);
+uint32_t phase_id();
+uint32_t phase_step();
+int phase_barrier(int fd, MsgType ack_type, uint32_t id, int num_processes);
+void phase_end();
+void phase_print(FILE *fp);
+int phase_timings(const PhaseTiming **timings);
+
+#endif
@@ -93,10 +93,10 @@ void bloom_filter_set_hash_function(BloomFilter *bf, BloomHashFunction hash_func
 int bloom_filter_destroy(BloomFilter *bf) {
     if (bf->__is_on_disk == 0) {
         free(bf->bloom);
-    } else {
+    } else if (bf->__is_on_disk == 1) {
         fclose(bf->filepointer);
         munmap(bf->bloom, bf->__filesize);
-    }
+    }  // mapped read-only (bloom_filter_import_mapped_alt): the caller unmaps it
     bf->bloom = NULL;
     bf->filepointer = NULL;
     bf->elements_added = 0;
@@ -224,6 +224,40 @@ int bloom_filter_export(BloomFilter *bf, const char *filepath) {
     return BLOOM_SUCCESS;
 }
 
+int bloom_filter_export_to_memory(BloomFilter *bf, void *buf, uint64_t buf_size) {
+    if (buf_size < bloom_filter_export_size(bf)) {
+        return BLOOM_FAILURE;
+    }
+    unsigned char *p = (unsigned char*)buf;
+    memcpy(p, bf->bloom, bf->bloom_length);
+    p += bf->bloom_length;
+    memcpy(p, &bf->estimated_elements, sizeof(uint64_t));
+    memcpy(p + sizeof(uint64_t), &bf->elements_added, sizeof(uint64_t));
+    memcpy(p + 2 * sizeof(uint64_t), &bf->false_positive_probability, sizeof(float));
+    return BLOOM_SUCCESS;
+}
+
+int bloom_filter_import_mapped_alt(BloomFilter *bf, const void *addr, uint64_t size, BloomHashFunction hash_function) {
+    uint64_t trailer = sizeof(uint64_t) * 2 + sizeof(float);
+    if (addr == NULL || size < trailer) {
+        return BLOOM_FAILURE;
+    }
+    const unsigned char *p = (const unsigned char*)addr + size - trailer;
+    memcpy(&bf->estimated_elements, p, sizeof(uint64_t));
+    memcpy(&bf->elements_added, p + sizeof(uint64_t), sizeof(uint64_t));
+    memcpy(&bf->false_positive_probability, p + 2 * sizeof(uint64_t), sizeof(float));
+    __calculate_optimal_hashes(bf);
+    if (bf->bloom_length + trailer != size) {
+        return BLOOM_FAILURE;
+    }
+    bf->bloom = (unsigned char*)addr;
+    bf->filepointer = NULL;
+    bf->__filesize = size;
+    bf->__is_on_disk = 2; // mapped read-only
+    bloom_filter_set_hash_function(bf, hash_function);
+    return BLOOM_SUCCESS;
+}
+
 int bloom_filter_import_alt(BloomFilter *bf, const char *filepath, BloomHashFunction hash_function) {
     FILE *fp;
     fp = fopen(filepath, "r+b");
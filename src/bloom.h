@@ -91,6 +91,16 @@ static __inline__ int bloom_filter_import_on_disk(BloomFilter *bf, const char *f
 /* Export the current bloom filter to file */
 int bloom_filter_export(BloomFilter *bf, const char *filepath);
 
+/*  Export the bloom filter into a buffer of bloom_filter_export_size() bytes; same layout as the file */
+int bloom_filter_export_to_memory(BloomFilter *bf, void *buf, uint64_t buf_size);
+
+/*  Use an exported bloom filter that is mapped read-only (e.g. a sealed memfd from a peer) in place, without
+    copying it. The filter must not be modified; the mapping stays the caller's, unmap it after bloom_filter_destroy. */
+int bloom_filter_import_mapped_alt(BloomFilter *bf, const void *addr, uint64_t size, BloomHashFunction hash_function);
+static __inline__ int bloom_filter_import_mapped(BloomFilter *bf, const void *addr, uint64_t size) {
+    return bloom_filter_import_mapped_alt(bf, addr, size, NULL);
+}
+
 /*  Export and import as a hex string; not space effecient but allows for storing
     multiple blooms in a single file or in a database, etc.
 
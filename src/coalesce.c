@@ -0,0 +1,210 @@
+#define _POSIX_C_SOURCE 200112L
+#define _ISOC11_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "IPC.h"
+#include "event_loop.h"
+#include "coalesce.h"
+
+//Frames for one receiver, the first MSG_HEADER_SIZE bytes are kept free for the MSG_COALESCED header
+typedef struct{
+    int sender_id;
+    int count;
+    size_t len;
+    uint64_t first_ns;          //when the oldest frame was buffered
+    uint64_t sum_enqueued_ns;   //sum of the buffering times, gives the total hold time at flush
+    char frame[IPC_MAX_MSG_SIZE] __attribute__((aligned(8)));
+} CoalesceBuffer;
+
+typedef enum{
+    FLUSH_SIZE,
+    FLUSH_TIMER,
+    FLUSH_IDLE
+} FlushReason;
+
+__thread CoalesceStats coalesce_stats;
+
+static __thread CoalesceBuffer *buffers[MAX_PROCESSES + 1];
+static __thread int num_buffered = 0;
+static __thread uint64_t max_delay_ns = 0;
+static __thread int max_batch = COALESCE_DEFAULT_MAX_BATCH;
+
+static void flush_buffer(int receiver_id, FlushReason reason, uint64_t now){
+    CoalesceBuffer *b = buffers[receiver_id];
+    if(b->count == 1){
+        //A lone frame goes out as it is, the batch header would only cost bytes
+        MsgHeader inner;
+        memcpy(&inner, b->frame + MSG_HEADER_SIZE, MSG_HEADER_SIZE);
+        send_msg(b->sender_id, receiver_id, b->frame + MSG_HEADER_SIZE, MSG_HEADER_SIZE + inner.payload_len);
+    } else{
+        encode_msg(b->frame, MSG_HEADER_SIZE, MSG_COALESCED, b->sender_id, 0, b->count, NULL, 0);
+        ((MsgHeader *)b->frame)->payload_len = b->len - MSG_HEADER_SIZE;
+        send_msg(b->sender_id, receiver_id, b->frame, b->len);
+    }
+
+    coalesce_stats.num_frames++;
+    coalesce_stats.total_hold_ns += (uint64_t)b->count * now - b->sum_enqueued_ns;
+    if(now - b->first_ns > coalesce_stats.max_hold_ns){
+        coalesce_stats.max_hold_ns = now - b->first_ns;
+    }
+    if(reason == FLUSH_SIZE){
+        coalesce_stats.size_flushes++;
+    } else if(reason == FLUSH_TIMER){
+        coalesce_stats.timer_flushes++;
+    } else{
+        coalesce_stats.idle_flushes++;
+    }
+
+    b->count = 0;
+    b->len = MSG_HEADER_SIZE;
+    b->sum_enqueued_ns = 0;
+    num_buffered--;
+}
+
+static void flush_all(FlushReason reason){
+    uint64_t now = event_loop_now_ns();
+    for(int i = 0; i <= MAX_PROCESSES && num_buffered > 0; i++){
+        if(buffers[i] != NULL && buffers[i]->count > 0){
+            flush_buffer(i, reason, now);
+        }
+    }
+}
+
+//Sends the buffers whose oldest frame reached the maximum delay
+static void coalesce_timer(void *arg){
+    if(num_buffered == 0){
+        return;
+    }
+    uint64_t now = event_loop_now_ns();
+    for(int i = 0; i <= MAX_PROCESSES && num_buffered > 0; i++){
+        if(buffers[i] != NULL && buffers[i]->count > 0 && now - buffers[i]->first_ns >= max_delay_ns){
+            flush_buffer(i, FLUSH_TIMER, now);
+        }
+    }
+}
+
+//Nothing else to do, so nothing is gained by holding the frames back any longer
+static void coalesce_idle(void *arg){
+    if(num_buffered > 0){
+        flush_all(FLUSH_IDLE);
+    }
+}
+
+//Reads COALESCE_MAX_DELAY_US and COALESCE_MAX_BATCH and hooks the flushes into the event loop
+int coalesce_init(EventLoop *loop){
+    const char *delay_env = getenv("COALESCE_MAX_DELAY_US");
+    const char *batch_env = getenv("COALESCE_MAX_BATCH");
+    long delay_us = delay_env != NULL ? atol(delay_env) : 0;
+    max_batch = batch_env != NULL ? atoi(batch_env) : COALESCE_DEFAULT_MAX_BATCH;
+    if(max_batch < 1){
+        max_batch = 1;
+    }
+    memset(&coalesce_stats, 0, sizeof(coalesce_stats));
+    max_delay_ns = delay_us > 0 ? (uint64_t)delay_us * 1000 : 0;
+    if(max_delay_ns == 0){
+        return 0;
+    }
+    //Checking at half the delay keeps the worst case hold time at 1.5 times the delay
+    uint64_t interval_us = delay_us / 2 > 0 ? delay_us / 2 : 1;
+    if(event_loop_add_timer(loop, interval_us, coalesce_timer, NULL) < 0){
+        max_delay_ns = 0;
+        return -1;
+    }
+    event_loop_set_idle(loop, coalesce_idle, NULL);
+    return 0;
+}
+
+int coalesce_enabled(){
+    return max_delay_ns > 0;
+}
+
+static int coalesce_frame(int sender_id, int receiver_id, MsgType type, uint32_t request_id, int32_t arg, const void *payload, size_t payload_len){
+    if(receiver_id < 0 || receiver_id > MAX_PROCESSES){
+        fprintf(stderr, "[ERROR HAPPENED] : Invalid receiver %d\n", receiver_id);
+        return -1;
+    }
+    size_t frame_len = MSG_HEADER_SIZE + payload_len;
+    if(MSG_HEADER_SIZE + MSG_COALESCED_ALIGN(frame_len) > IPC_MAX_MSG_SIZE){
+        return send_frame(sender_id, receiver_id, type, request_id, arg, payload, payload_len);
+    }
+    CoalesceBuffer *b = buffers[receiver_id];
+    if(b == NULL){
+        b = aligned_alloc(8, sizeof(CoalesceBuffer));
+        if(b == NULL){
+            return send_frame(sender_id, receiver_id, type, request_id, arg, payload, payload_len);
+        }
+        b->count = 0;
+        b->len = MSG_HEADER_SIZE;
+        b->sum_enqueued_ns = 0;
+        buffers[receiver_id] = b;
+    }
+
+    uint64_t now = event_loop_now_ns();
+    if(b->count > 0 && (b->len + MSG_COALESCED_ALIGN(frame_len) > IPC_MAX_MSG_SIZE || b->sender_id != sender_id)){
+        flush_buffer(receiver_id, FLUSH_SIZE, now);
+    }
+    if(b->count == 0){
+        b->sender_id = sender_id;
+        b->first_ns = now;
+        num_buffered++;
+    }
+    encode_msg(b->frame + b->len, IPC_MAX_MSG_SIZE - b->len, type, sender_id, request_id, arg, payload, payload_len);
+    b->len += MSG_COALESCED_ALIGN(frame_len);
+    b->count++;
+    b->sum_enqueued_ns += now;
+    coalesce_stats.num_msgs++;
+
+    if(b->count >= max_batch){
+        flush_buffer(receiver_id, FLUSH_SIZE, now);
+    }
+    return 0;
+}
+
+//Same as send_key_frame, but the frame may wait in the receiver's buffer for up to the maximum delay
+int coalesce_send_key_frame(int sender_id, int receiver_id, MsgType type, uint32_t request_id, int32_t arg, int key){
+    int32_t k = key;
+    if(!coalesce_enabled()){
+        return send_key_frame(sender_id, receiver_id, type, request_id, arg, key);
+    }
+    return coalesce_frame(sender_id, receiver_id, type, request_id, arg, &k, sizeof(k));
+}
+
+//Same as send_key_frame_batch: with coalescing the frame is added to the buffer of every receiver instead
+int coalesce_send_key_frame_batch(int sender_id, const int *receivers, int num_receivers, MsgType type, uint32_t request_id, int32_t arg, int key){
+    int32_t k = key;
+    int sent = 0;
+    if(!coalesce_enabled()){
+        return send_key_frame_batch(sender_id, receivers, num_receivers, type, request_id, arg, key);
+    }
+    for(int i = 0; i < num_receivers; i++){
+        if(coalesce_frame(sender_id, receivers[i], type, request_id, arg, &k, sizeof(k)) == 0){
+            sent++;
+        }
+    }
+    return sent;
+}
+
+void coalesce_flush(){
+    if(num_buffered > 0){
+        flush_all(FLUSH_IDLE);
+    }
+}
+
+//Frames per send is what coalescing saves in syscalls and wakeups, the hold time is what it costs in latency
+void coalesce_print_stats(FILE *fp){
+    fprintf(fp, "Coalescing:\n");
+    if(!coalesce_enabled()){
+        fprintf(fp, "Disabled (COALESCE_MAX_DELAY_US=0)\n");
+        return;
+    }
+    fprintf(fp, "Max delay: %llu μs, max batch: %d frames\n", (unsigned long long)(max_delay_ns / 1000), max_batch);
+    fprintf(fp, "Frames coalesced: %llu into %llu sends (%.2f frames per send)\n", (unsigned long long)coalesce_stats.num_msgs,
+            (unsigned long long)coalesce_stats.num_frames,
+            coalesce_stats.num_frames > 0 ? (double)coalesce_stats.num_msgs / coalesce_stats.num_frames : 0.0);
+    fprintf(fp, "Flushes: %llu on size, %llu on timer, %llu on idle\n", (unsigned long long)coalesce_stats.size_flushes,
+            (unsigned long long)coalesce_stats.timer_flushes, (unsigned long long)coalesce_stats.idle_flushes);
+    fprintf(fp, "Avg added latency: %.2f μs, max: %.2f μs\n",
+            coalesce_stats.num_msgs > 0 ? (double)coalesce_stats.total_hold_ns / coalesce_stats.num_msgs / 1000.0 : 0.0,
+            coalesce_stats.max_hold_ns / 1000.0);
+}
@@ -0,0 +1,36 @@
+#ifndef COALESCE_H
+
+#define COALESCE_H
+#include <stdio.h>
+#include <stdint.h>
+#include "IPC.h"
+#include "event_loop.h"
+
+//Optional coalescing of the small query frames (PQUERY, PFOUND/PNOTFOUND, FOUND/NOTFOUND)
+//Frames for the same receiver are packed back to back into one MSG_COALESCED frame, which is sent once it holds
+//COALESCE_MAX_BATCH frames (or is full), once its oldest frame waited COALESCE_MAX_DELAY_US, or when the event loop is about to block
+//COALESCE_MAX_DELAY_US=0 (the default) turns it off and every frame is sent on its own
+//The receiving side unpacks the batch inside IPC.c, so handlers and the manager's response loops still see single frames
+
+#define COALESCE_DEFAULT_MAX_BATCH 32
+
+typedef struct{
+    uint64_t num_msgs;          //frames that went through the coalescer
+    uint64_t num_frames;        //frames that actually left (batches and single frames)
+    uint64_t size_flushes;
+    uint64_t timer_flushes;
+    uint64_t idle_flushes;
+    uint64_t total_hold_ns;     //time the frames spent waiting in a buffer
+    uint64_t max_hold_ns;
+} CoalesceStats;
+
+extern __thread CoalesceStats coalesce_stats;
+
+int coalesce_init(EventLoop *loop);
+int coalesce_enabled();
+int coalesce_send_key_frame(int sender_id, int receiver_id, MsgType type, uint32_t request_id, int32_t arg, int key);
+int coalesce_send_key_frame_batch(int sender_id, const int *receivers, int num_receivers, MsgType type, uint32_t request_id, int32_t arg, int key);
+void coalesce_flush();
+void coalesce_print_stats(FILE *fp);
+
+#endif
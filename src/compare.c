@@ -0,0 +1,71 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "manager_run.h"
+
+//Runs the same scenario against several structures, one ./manager after the other, and prints their RESULTS_CSV
+//rows (results.h) side by side, one line per metric
+//Usage: ./compare <num_processes> <keys_per_process> [scenario file]
+//COMPARE_STRUCTURES picks the structures (default "bloom,counting_bloom,cqf"), COMPARE_CSV the table the rows go to
+//(default /tmp/compare_results.csv, started over on every run). Every manager writes its JSON record to
+///tmp/compare_<structure>.json and its output to /tmp/compare_<structure>.log; the rest of the environment
+//(transport, load generator, KEYGEN_SEED, ...) is passed on, so all structures see the same keys and the same queries
+
+#define COMPARE_DEFAULT_STRUCTURES "bloom,counting_bloom,cqf"
+#define COMPARE_DEFAULT_CSV "/tmp/compare_results.csv"
+#define COMPARE_MAX_RUNS 8
+
+int main(int argc, char *argv[]){
+    if(argc < 3){
+        fprintf(stderr, "Usage: %s <num_processes> <keys_per_process> [scenario file]\n", argv[0]);
+        exit(1);
+    }
+    const char *structures_env = getenv("COMPARE_STRUCTURES");
+    const char *csv_env = getenv("COMPARE_CSV");
+    char structures[512];
+    snprintf(structures, sizeof(structures), "%s", structures_env != NULL ? structures_env : COMPARE_DEFAULT_STRUCTURES);
+    const char *csv = csv_env != NULL ? csv_env : COMPARE_DEFAULT_CSV;
+    unlink(csv);
+
+    int num_runs = 0;
+    for(char *structure = strtok(structures, ","); structure != NULL; structure = strtok(NULL, ",")){
+        if(num_runs >= COMPARE_MAX_RUNS){
+            fprintf(stderr, "[ERROR HAPPENED] : At most %d structures, %s is left out\n", COMPARE_MAX_RUNS, structure);
+            break;
+        }
+        char *manager_argv[] = {"./manager", structure, argv[1], argv[2], argc > 3 ? argv[3] : NULL, NULL};
+        char json[256], log[256];
+        snprintf(json, sizeof(json), "/tmp/compare_%s.json", structure);
+        snprintf(log, sizeof(log), "/tmp/compare_%s.log", structure);
+        struct timespec start, end;
+        printf("Running %s ... ", structure);
+        fflush(stdout);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int status = manager_run(manager_argv, csv, json, log);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        printf("%s in %.1f s (%s)\n", status == 0 ? "done" : "FAILED",
+               (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9, log);
+        num_runs++;
+    }
+
+    static CsvRow header;
+    static CsvRow rows[COMPARE_MAX_RUNS];
+    int num_rows = csv_read(csv, &header, rows, COMPARE_MAX_RUNS);
+    if(num_rows < 0){
+        exit(1);
+    }
+
+    printf("\n");
+    for(int c = 0; c < header.num_fields; c++){
+        printf("%-20s", header.fields[c]);
+        for(int r = 0; r < num_rows; r++){
+            printf(" %18s", c < rows[r].num_fields ? rows[r].fields[c] : "-");
+        }
+        printf("\n");
+    }
+    printf("\nTable in %s, records in /tmp/compare_<structure>.json\n", csv);
+    return 0;
+}
@@ -86,10 +86,10 @@ int counting_bloom_init_on_disk_alt(CountingBloom* cb, uint64_t estimated_elemen
 int counting_bloom_destroy(CountingBloom* cb) {
     if (cb->__is_on_disk == 0) {
         free(cb->bloom);
-    } else {
+    } else if (cb->__is_on_disk == 1) {
         fclose(cb->filepointer);
         munmap(cb->bloom, cb->__filesize);
-    }
+    }  // mapped read-only (counting_bloom_import_mapped_alt): the caller unmaps it
     cb->estimated_elements = 0;
     cb->false_positive_probability = 0.0;
     cb->number_hashes = 0;
@@ -233,6 +233,40 @@ int counting_bloom_export(const CountingBloom* cb, const char* filepath) {
     return COUNTING_BLOOM_SUCCESS;
 }
 
+int counting_bloom_export_to_memory(const CountingBloom* cb, void* buf, uint64_t buf_size) {
+    if (buf_size < counting_bloom_export_size(cb)) {
+        return COUNTING_BLOOM_FAILURE;
+    }
+    unsigned char* p = (unsigned char*)buf;
+    memcpy(p, cb->bloom, cb->number_bits * sizeof(uint32_t));
+    p += cb->number_bits * sizeof(uint32_t);
+    memcpy(p, &cb->estimated_elements, sizeof(uint64_t));
+    memcpy(p + sizeof(uint64_t), &cb->elements_added, sizeof(uint64_t));
+    memcpy(p + 2 * sizeof(uint64_t), &cb->false_positive_probability, sizeof(float));
+    return COUNTING_BLOOM_SUCCESS;
+}
+
+int counting_bloom_import_mapped_alt(CountingBloom* cb, const void* addr, uint64_t size, CountBloomHashFunction hash_function) {
+    uint64_t trailer = sizeof(uint64_t) * 2 + sizeof(float);
+    if (addr == NULL || size < trailer) {
+        return COUNTING_BLOOM_FAILURE;
+    }
+    const unsigned char* p = (const unsigned char*)addr + size - trailer;
+    memcpy(&cb->estimated_elements, p, sizeof(uint64_t));
+    memcpy(&cb->elements_added, p + sizeof(uint64_t), sizeof(uint64_t));
+    memcpy(&cb->false_positive_probability, p + 2 * sizeof(uint64_t), sizeof(float));
+    __calculate_optimal_hashes(cb);
+    if (cb->number_bits * sizeof(uint32_t) + trailer != size) {
+        return COUNTING_BLOOM_FAILURE;
+    }
+    cb->bloom = (uint32_t*)addr;
+    cb->filepointer = NULL;
+    cb->__filesize = size;
+    cb->__is_on_disk = 2; // mapped read-only
+    cb->hash_function = (hash_function == NULL) ? __default_hash : hash_function;
+    return COUNTING_BLOOM_SUCCESS;
+}
+
 int counting_bloom_import_alt(CountingBloom* cb, const char* filepath, CountBloomHashFunction hash_function) {
     FILE* fp;
     fp = fopen(filepath, "r+b");
@@ -296,7 +330,7 @@ uint64_t counting_bloom_count_set_bits(const CountingBloom* cb) {
 }
 
 uint64_t counting_bloom_export_size(const CountingBloom* cb) {
-    return (uint64_t)((cb->number_bits * sizeof(uint32_t)) + (2 * sizeof(uint32_t)) + sizeof(float));
+    return (uint64_t)((cb->number_bits * sizeof(uint32_t)) + (2 * sizeof(uint64_t)) + sizeof(float));
 }
 
 
@@ -129,6 +129,19 @@ int counting_bloom_remove_string_alt(CountingBloom* cb, const uint64_t* hashes,
 /* Export the current counting bloom to file */
 int counting_bloom_export(const CountingBloom* cb, const char* filepath);
 
+/* Export the counting bloom into a buffer of counting_bloom_export_size() bytes; same layout as the file */
+int counting_bloom_export_to_memory(const CountingBloom* cb, void* buf, uint64_t buf_size);
+
+/*
+    Use an exported counting bloom that is mapped read-only (e.g. a sealed memfd from a peer) in place,
+    without copying it. The counting bloom must not be modified; the mapping stays the caller's, unmap it after
+    counting_bloom_destroy.
+*/
+int counting_bloom_import_mapped_alt(CountingBloom* cb, const void* addr, uint64_t size, CountBloomHashFunction hash_function);
+static __inline__ int counting_bloom_import_mapped(CountingBloom* cb, const void* addr, uint64_t size) {
+    return counting_bloom_import_mapped_alt(cb, addr, size, NULL);
+}
+
 /* Import a previously exported counting bloom from a file into memory */
 int counting_bloom_import_alt(CountingBloom* cb, const char* filepath, CountBloomHashFunction hash_function);
 static __inline__ int counting_bloom_import(CountingBloom* cb, const char* filepath) {
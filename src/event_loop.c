@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200112L
+#define _ISOC11_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "IPC.h"
+#include "event_loop.h"
+
+uint64_t event_loop_now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void cpu_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+//The maximum spin window comes from EVENT_LOOP_SPIN_US (0 disables spinning); node threads (IPC_TRANSPORT=thread)
+//don't spin by default, with hundreds of them on a few CPUs a spinning node only holds up the ones with work
+//buf_size is the size of every batch slot, i.e. the largest message the process accepts
+void event_loop_init(EventLoop *loop, int fd, size_t buf_size){
+    const char *spin_env = getenv("EVENT_LOOP_SPIN_US");
+    long spin_us = spin_env != NULL ? atol(spin_env) : (ipc_in_process() ? 0 : EVENT_LOOP_DEFAULT_SPIN_US);
+    if(spin_us < 0){
+        spin_us = 0;
+    }
+    loop->fd = fd;
+    loop->max_spin_ns = (uint64_t)spin_us * 1000;
+    loop->spin_ns = loop->max_spin_ns;
+    loop->num_timers = 0;
+    loop->idle_callback = NULL;
+    loop->idle_arg = NULL;
+    loop->num_spin_hits = 0;
+    loop->num_blocks = 0;
+    loop->num_batches = 0;
+    loop->num_msgs = 0;
+    loop->batch_count = 0;
+    loop->batch_pos = 0;
+    loop->buf_size = buf_size;
+    for(int i = 0; i < IPC_BATCH_SIZE; i++){
+        //8-byte aligned so the int32 keys of a frame can be read in place
+        loop->batch_bufs[i] = aligned_alloc(8, (buf_size + 7) & ~(size_t)7);
+        if(loop->batch_bufs[i] == NULL){
+            fprintf(stderr, "[ERROR HAPPENED] : Could not allocate the event loop buffers\n");
+            exit(1);
+        }
+    }
+}
+
+//Periodic timer, the callback runs from event_loop_next_msg once its deadline passed
+int event_loop_add_timer(EventLoop *loop, uint64_t interval_us, EventTimerCallback callback, void *arg){
+    if(loop->num_timers >= EVENT_LOOP_MAX_TIMERS){
+        fprintf(stderr, "[ERROR HAPPENED] : Too many event loop timers\n");
+        return -1;
+    }
+    EventTimer *timer = &loop->timers[loop->num_timers++];
+    timer->interval_ns = interval_us * 1000;
+    timer->next_deadline_ns = event_loop_now_ns() + timer->interval_ns;
+    timer->callback = callback;
+    timer->arg = arg;
+    return 0;
+}
+
+void event_loop_set_idle(EventLoop *loop, EventIdleCallback callback, void *arg){
+    loop->idle_callback = callback;
+    loop->idle_arg = arg;
+}
+
+//Runs every expired timer and returns how long we may block before the next one (-1 if there is no timer)
+static int run_timers(EventLoop *loop, uint64_t now){
+    int64_t next_ns = -1;
+    for(int i = 0; i < loop->num_timers; i++){
+        EventTimer *timer = &loop->timers[i];
+        if(now >= timer->next_deadline_ns){
+            timer->callback(timer->arg);
+            timer->next_deadline_ns = now + timer->interval_ns;
+        }
+        int64_t remaining = (int64_t)(timer->next_deadline_ns - now);
+        if(next_ns < 0 || remaining < next_ns){
+            next_ns = remaining;
+        }
+    }
+    if(next_ns < 0){
+        return -1;
+    }
+    //round up, otherwise we would wake up just before the deadline and spin
+    return (int)((next_ns + 999999) / 1000000);
+}
+
+static void grow_spin(EventLoop *loop){
+    loop->spin_ns = loop->spin_ns * 2 + 1000;
+    if(loop->spin_ns > loop->max_spin_ns){
+        loop->spin_ns = loop->max_spin_ns;
+    }
+}
+
+//Returns the length of the next message and points *msg at it, or 0 after a blocking wait/timer so the caller can run its own checks
+//The message stays valid until the next call
+int event_loop_next_msg(EventLoop *loop, const char **msg){
+    if(loop->batch_pos < loop->batch_count){
+        *msg = loop->batch_bufs[loop->batch_pos];
+        return loop->batch_lens[loop->batch_pos++];
+    }
+
+    uint64_t spin_start = event_loop_now_ns();
+    int spun = 0;
+    while(1){
+        int n = receive_msg_batch(loop->fd, loop->batch_bufs, loop->buf_size, loop->batch_lens, IPC_BATCH_SIZE);
+        uint64_t now = event_loop_now_ns();
+        int block_ms = run_timers(loop, now);
+        if(n > 0){
+            if(spun){
+                loop->num_spin_hits++;
+                grow_spin(loop);
+            }
+            loop->num_batches++;
+            loop->num_msgs += n;
+            loop->batch_count = n;
+            loop->batch_pos = 1;
+            *msg = loop->batch_bufs[0];
+            return loop->batch_lens[0];
+        }
+        if(n < 0){
+            return 0;
+        }
+        if(now - spin_start < loop->spin_ns){
+            spun = 1;
+            cpu_relax();
+            continue;
+        }
+
+        if(loop->idle_callback != NULL){
+            loop->idle_callback(loop->idle_arg);
+        }
+        loop->num_blocks++;
+        int ready = ipc_wait(loop->fd, block_ms);
+        //A message that shows up right after we blocked would have been caught by a longer spin
+        if(ready > 0 && event_loop_now_ns() - now < loop->max_spin_ns){
+            grow_spin(loop);
+        } else{
+            loop->spin_ns /= 2;
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef EVENT_LOOP_H
+
+#define EVENT_LOOP_H
+#include <stddef.h>
+#include <stdint.h>
+#include "IPC.h"
+
+//Shared main loop of the Process_* binaries
+//When the socket/ring is empty we keep polling for a short spin window before blocking in ipc_wait (epoll or futex),
+//so a query that arrives right after a quiet period is picked up without a sleep interval in between
+//The spin window adapts: it grows while spinning catches messages and shrinks while we end up blocking anyway
+//Messages are drained in batches of up to IPC_BATCH_SIZE per receive call and handed out one at a time
+
+#define EVENT_LOOP_MAX_TIMERS 8
+#define EVENT_LOOP_DEFAULT_SPIN_US 50
+
+typedef void (*EventTimerCallback)(void *arg);
+typedef void (*EventIdleCallback)(void *arg);
+
+typedef struct{
+    uint64_t interval_ns;
+    uint64_t next_deadline_ns;
+    EventTimerCallback callback;
+    void *arg;
+} EventTimer;
+
+typedef struct{
+    int fd;
+    uint64_t max_spin_ns;
+    uint64_t spin_ns;
+    EventTimer timers[EVENT_LOOP_MAX_TIMERS];
+    int num_timers;
+    //runs right before the loop blocks, e.g. to send out what is still buffered
+    EventIdleCallback idle_callback;
+    void *idle_arg;
+    char *batch_bufs[IPC_BATCH_SIZE];
+    int batch_lens[IPC_BATCH_SIZE];
+    int batch_count;
+    int batch_pos;
+    size_t buf_size;
+    //statistics for the stats files
+    uint64_t num_spin_hits;
+    uint64_t num_blocks;
+    uint64_t num_batches;
+    uint64_t num_msgs;
+} EventLoop;
+
+uint64_t event_loop_now_ns();
+void event_loop_init(EventLoop *loop, int fd, size_t buf_size);
+int event_loop_add_timer(EventLoop *loop, uint64_t interval_us, EventTimerCallback callback, void *arg);
+void event_loop_set_idle(EventLoop *loop, EventIdleCallback callback, void *arg);
+int event_loop_next_msg(EventLoop *loop, const char **msg);
+
+#endif
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "histogram.h"
+
+static int bucket_of(uint64_t value){
+    if(value < HISTOGRAM_SUB_BUCKETS){
+        return (int)value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - (HISTOGRAM_SUB_BUCKET_BITS - 1);
+    int sub = (int)(value >> shift) - HISTOGRAM_HALF_SUB_BUCKETS;
+    return HISTOGRAM_SUB_BUCKETS + (exponent - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_HALF_SUB_BUCKETS + sub;
+}
+
+//Largest value that falls into the bucket, percentiles are reported as this upper bound
+static uint64_t bucket_high(int bucket){
+    if(bucket < HISTOGRAM_SUB_BUCKETS){
+        return bucket;
+    }
+    int k = bucket - HISTOGRAM_SUB_BUCKETS;
+    int exponent = HISTOGRAM_SUB_BUCKET_BITS + k / HISTOGRAM_HALF_SUB_BUCKETS;
+    int shift = exponent - (HISTOGRAM_SUB_BUCKET_BITS - 1);
+    uint64_t mantissa = HISTOGRAM_HALF_SUB_BUCKETS + k % HISTOGRAM_HALF_SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void histogram_init(Histogram *h){
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void histogram_record(Histogram *h, uint64_t value_ns){
+    h->counts[bucket_of(value_ns)]++;
+    h->total++;
+    h->sum += value_ns;
+    if(value_ns < h->min) h->min = value_ns;
+    if(value_ns > h->max) h->max = value_ns;
+}
+
+void histogram_merge(Histogram *dst, const Histogram *src){
+    for(int b = 0; b < HISTOGRAM_NUM_BUCKETS; b++){
+        dst->counts[b] += src->counts[b];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    dst->num_warmup += src->num_warmup;
+    if(src->min < dst->min) dst->min = src->min;
+    if(src->max > dst->max) dst->max = src->max;
+}
+
+//percentile in [0, 100], the exact maximum for 100
+uint64_t histogram_percentile(const Histogram *h, double percentile){
+    if(h->total == 0){
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * h->total + 0.5);
+    if(rank < 1) rank = 1;
+    if(rank >= h->total){
+        return h->max;
+    }
+    uint64_t seen = 0;
+    for(int b = 0; b < HISTOGRAM_NUM_BUCKETS; b++){
+        seen += h->counts[b];
+        if(seen >= rank){
+            uint64_t value = bucket_high(b);
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+double histogram_mean(const Histogram *h){
+    return h->total > 0 ? h->sum / h->total : 0;
+}
+
+uint64_t histogram_warmup_ns(){
+    const char *env = getenv("LATENCY_WARMUP_MS");
+    long warmup_ms = env != NULL ? atol(env) : 0;
+    return warmup_ms > 0 ? (uint64_t)warmup_ms * 1000000ULL : 0;
+}
+
+//1 (and counted) if a query that started at sample_start_ns is inside the warmup of a run that started at run_start_ns
+int histogram_in_warmup(Histogram *h, uint64_t run_start_ns, uint64_t sample_start_ns){
+    static __thread int64_t warmup_ns = -1;
+    if(warmup_ns < 0){
+        warmup_ns = (int64_t)histogram_warmup_ns();
+    }
+    if(sample_start_ns - run_start_ns < (uint64_t)warmup_ns){
+        h->num_warmup++;
+        return 1;
+    }
+    return 0;
+}
+
+void histogram_print(FILE *fp, const char *title, const Histogram *h){
+    static const double percentiles[] = {50.0, 90.0, 99.0, 99.9};
+    fprintf(fp, "%s (%llu samples", title, (unsigned long long)h->total);
+    if(h->num_warmup > 0){
+        fprintf(fp, ", %llu in warmup left out", (unsigned long long)h->num_warmup);
+    }
+    fprintf(fp, "):\n");
+    for(int i = 0; i < (int)(sizeof(percentiles) / sizeof(percentiles[0])); i++){
+        fprintf(fp, "  p%-5g %10.3f ms\n", percentiles[i], histogram_percentile(h, percentiles[i]) / 1000000.0);
+    }
+    fprintf(fp, "  %-6s %10.3f ms\n", "max", h->total > 0 ? h->max / 1000000.0 : 0);
+}
@@ -0,0 +1,41 @@
+#ifndef HISTOGRAM_H
+
+#define HISTOGRAM_H
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+//Log-bucketed latency histogram in the style of HdrHistogram, values in nanoseconds
+//Values below 2^HISTOGRAM_SUB_BUCKET_BITS are counted exactly, every power of two above that is split into
+//2^(HISTOGRAM_SUB_BUCKET_BITS - 1) linear sub-buckets, so a reported percentile is within 1/128 (0.8%) of the true value
+//from nanoseconds up to hours, in a fixed 60 KB array that can be merged by adding counts
+//Samples of the first LATENCY_WARMUP_MS milliseconds of a run (default 0) are left out, see histogram_in_warmup
+
+#define HISTOGRAM_SUB_BUCKET_BITS 8
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_HALF_SUB_BUCKETS (HISTOGRAM_SUB_BUCKETS / 2)
+#define HISTOGRAM_NUM_BUCKETS (HISTOGRAM_SUB_BUCKETS + (64 - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_HALF_SUB_BUCKETS)
+
+typedef struct{
+    uint64_t counts[HISTOGRAM_NUM_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+    uint64_t num_warmup;        //samples left out because they fell into the warmup
+} Histogram;
+
+static inline uint64_t timespec_to_ns(const struct timespec *ts){
+    return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+void histogram_init(Histogram *h);
+void histogram_record(Histogram *h, uint64_t value_ns);
+void histogram_merge(Histogram *dst, const Histogram *src);
+uint64_t histogram_percentile(const Histogram *h, double percentile);
+double histogram_mean(const Histogram *h);
+uint64_t histogram_warmup_ns();
+int histogram_in_warmup(Histogram *h, uint64_t run_start_ns, uint64_t sample_start_ns);
+void histogram_print(FILE *fp, const char *title, const Histogram *h);
+
+#endif
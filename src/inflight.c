@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "inflight.h"
+
+//Fibonacci hashing, request ids are mostly sequential and this spreads them over the whole array
+static inline uint32_t slot_of(const InflightTable *table, uint32_t request_id){
+    return (uint32_t)(request_id * 2654435761u) & table->mask;
+}
+
+int inflight_init(InflightTable *table, uint32_t capacity){
+    uint32_t size = 16;
+    while(size < capacity * 2){
+        size <<= 1;
+    }
+    table->slots = calloc(size, sizeof(InflightEntry));
+    if(table->slots == NULL){
+        fprintf(stderr, "[ERROR HAPPENED] : failed to allocate in-flight table of %u slots\n", size);
+        return -1;
+    }
+    table->mask = size - 1;
+    table->count = 0;
+    table->capacity = capacity;
+    table->num_full = 0;
+    return 0;
+}
+
+//Returns the entry for request_id with its fields zeroed, or NULL if the id is 0, already in flight or the table is full
+InflightEntry *inflight_insert(InflightTable *table, uint32_t request_id){
+    if(request_id == 0){
+        return NULL;
+    }
+    if(table->count >= table->capacity){
+        table->num_full++;
+        return NULL;
+    }
+    uint32_t i = slot_of(table, request_id);
+    while(table->slots[i].request_id != 0){
+        if(table->slots[i].request_id == request_id){
+            return NULL;
+        }
+        i = (i + 1) & table->mask;
+    }
+    memset(&table->slots[i], 0, sizeof(InflightEntry));
+    table->slots[i].request_id = request_id;
+    table->count++;
+    return &table->slots[i];
+}
+
+InflightEntry *inflight_find(InflightTable *table, uint32_t request_id){
+    if(request_id == 0 || table->slots == NULL){
+        return NULL;
+    }
+    uint32_t i = slot_of(table, request_id);
+    while(table->slots[i].request_id != 0){
+        if(table->slots[i].request_id == request_id){
+            return &table->slots[i];
+        }
+        i = (i + 1) & table->mask;
+    }
+    return NULL;
+}
+
+//Backward-shift deletion: every following entry of the probe run that may live in the hole moves into it
+void inflight_remove(InflightTable *table, InflightEntry *entry){
+    uint32_t hole = (uint32_t)(entry - table->slots);
+    uint32_t i = (hole + 1) & table->mask;
+    while(table->slots[i].request_id != 0){
+        uint32_t home = slot_of(table, table->slots[i].request_id);
+        //The entry can move if its home slot is not inside the (cyclic) range (hole, i]
+        if(((i - home) & table->mask) >= ((i - hole) & table->mask)){
+            table->slots[hole] = table->slots[i];
+            hole = i;
+        }
+        i = (i + 1) & table->mask;
+    }
+    table->slots[hole].request_id = 0;
+    table->count--;
+}
+
+void inflight_destroy(InflightTable *table){
+    free(table->slots);
+    table->slots = NULL;
+    table->count = 0;
+}
@@ -0,0 +1,38 @@
+#ifndef INFLIGHT_H
+
+#define INFLIGHT_H
+#include <stdint.h>
+
+//Requests that still wait for answers, keyed by request id (0 is never a valid id)
+//Open addressing with linear probing over a power-of-two array that is sized once, at least twice the capacity,
+//so a probe touches a few neighbouring slots; removing an entry shifts the following ones back instead of leaving tombstones
+
+//Peer queries a process tracks at once, beyond that a query is answered MSG_NOTFOUND without asking the peers
+#define INFLIGHT_PEER_QUERIES 4096
+
+typedef struct{
+    uint32_t request_id;        //0 = empty slot
+    int32_t owner;              //who asked and gets the answer
+    int32_t key;
+    int32_t remaining;          //answers still expected
+    int32_t found;
+    uint32_t tag;               //the owner's (the load generator keeps the rebuild epoch at send time)
+    uint64_t start_ns;          //when the request was sent
+    uint64_t due_ns;            //when it was scheduled to be sent (load generator)
+} InflightEntry;
+
+typedef struct{
+    InflightEntry *slots;
+    uint32_t mask;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t num_full;          //inserts refused because capacity entries were in flight
+} InflightTable;
+
+int inflight_init(InflightTable *table, uint32_t capacity);
+InflightEntry *inflight_insert(InflightTable *table, uint32_t request_id);
+InflightEntry *inflight_find(InflightTable *table, uint32_t request_id);
+void inflight_remove(InflightTable *table, InflightEntry *entry);
+void inflight_destroy(InflightTable *table);
+
+#endif
@@ -0,0 +1,134 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "IPC.h"
+#include "key_segment.h"
+
+static int inline_payloads(){
+    const char *env = getenv("IPC_INLINE_PAYLOADS");
+    return env != NULL && atoi(env) > 0;
+}
+
+//Lays out counts[p] keys for each of num_owners owners, writable until key_segment_seal
+int key_segment_create(KeySegment *segment, const char *name, int num_owners, const int *counts){
+    memset(segment, 0, sizeof(*segment));
+    segment->fd = -1;
+    if(num_owners < 0 || num_owners > MAX_PROCESSES){
+        fprintf(stderr, "[ERROR HAPPENED] : A key segment holds at most %d owners\n", MAX_PROCESSES);
+        return -1;
+    }
+    uint64_t total = 0;
+    for(int p = 0; p < num_owners; p++){
+        total += counts[p];
+    }
+    segment->size = sizeof(KeySegmentHeader) + total * sizeof(int32_t);
+
+    void *addr;
+    if(inline_payloads()){
+        addr = calloc(1, segment->size);
+        if(addr == NULL){
+            fprintf(stderr, "[ERROR HAPPENED] : Could not allocate a key segment of %zu bytes\n", segment->size);
+            return -1;
+        }
+    } else{
+        segment->fd = ipc_memfd_create(name, segment->size, &addr);
+        if(segment->fd < 0){
+            return -1;
+        }
+    }
+    segment->header = addr;
+    segment->keys = (int *)((char *)addr + sizeof(KeySegmentHeader));
+    segment->header->magic = KEY_SEGMENT_MAGIC;
+    segment->header->num_owners = num_owners;
+    uint64_t offset = 0;
+    for(int p = 0; p < num_owners; p++){
+        segment->header->offsets[p] = offset;
+        segment->header->counts[p] = counts[p];
+        offset += counts[p];
+    }
+    return 0;
+}
+
+int *key_segment_owner_keys(KeySegment *segment, int owner){
+    return segment->keys + segment->header->offsets[owner];
+}
+
+//Seals the memfd and maps it back read-only: the keys stay where the sender can read them, nobody can change them
+int key_segment_seal(KeySegment *segment){
+    if(segment->sealed || segment->fd < 0){
+        segment->sealed = 1;
+        return 0;
+    }
+    if(ipc_memfd_seal(segment->fd, segment->header, segment->size) < 0){
+        return -1;
+    }
+    void *addr = mmap(NULL, segment->size, PROT_READ, MAP_SHARED, segment->fd, 0);
+    if(addr == MAP_FAILED){
+        perror("[ERROR HAPPENED] : Could not map the key segment back");
+        segment->header = NULL;
+        segment->keys = NULL;
+        return -1;
+    }
+    segment->header = addr;
+    segment->keys = (int *)((char *)addr + sizeof(KeySegmentHeader));
+    segment->sealed = 1;
+    return 0;
+}
+
+//One frame per receiver with the descriptor (or, inline, the whole segment); seals the segment first if needed
+int send_key_segment(int sender_id, const int *receivers, int num_receivers, MsgType type, uint32_t request_id,
+                     KeySegment *segment){
+    if(key_segment_seal(segment) < 0){
+        return 0;
+    }
+    if(segment->fd < 0){
+        return send_frame_batch(sender_id, receivers, num_receivers, type, request_id, 0, segment->header, segment->size);
+    }
+    return send_fd_frame(sender_id, receivers, num_receivers, type, request_id, 0, segment->fd, MSG_FLAG_SHARED);
+}
+
+void key_segment_destroy(KeySegment *segment){
+    if(segment->header == NULL){
+        return;
+    }
+    if(segment->fd < 0){
+        free(segment->header);
+    } else{
+        munmap(segment->header, segment->size);
+        close(segment->fd);
+    }
+    memset(segment, 0, sizeof(*segment));
+    segment->fd = -1;
+}
+
+static const KeySegmentHeader *checked_header(const MsgHeader *hdr, const char *payload){
+    const KeySegmentHeader *header = (const KeySegmentHeader *)payload;
+    if(hdr->payload_len < sizeof(KeySegmentHeader) || header->magic != KEY_SEGMENT_MAGIC || header->num_owners < 0
+       || header->num_owners > MAX_PROCESSES){
+        return NULL;
+    }
+    return header;
+}
+
+int key_segment_owners(const MsgHeader *hdr, const char *payload){
+    const KeySegmentHeader *header = checked_header(hdr, payload);
+    return header != NULL ? header->num_owners : 0;
+}
+
+int key_segment_slice(const MsgHeader *hdr, const char *payload, int owner, const int **keys){
+    const KeySegmentHeader *header = checked_header(hdr, payload);
+    *keys = NULL;
+    if(header == NULL || owner < 0 || owner >= header->num_owners || header->counts[owner] < 0){
+        return 0;
+    }
+    uint64_t available = (hdr->payload_len - sizeof(KeySegmentHeader)) / sizeof(int32_t);
+    if(header->offsets[owner] > available || (uint64_t)header->counts[owner] > available - header->offsets[owner]){
+        fprintf(stderr, "[ERROR HAPPENED] : Key segment slice of owner %d is out of bounds\n", owner);
+        return 0;
+    }
+    *keys = (const int *)(payload + sizeof(KeySegmentHeader)) + header->offsets[owner];
+    return header->counts[owner];
+}
@@ -0,0 +1,43 @@
+#ifndef KEY_SEGMENT_H
+
+#define KEY_SEGMENT_H
+#include <stddef.h>
+#include <stdint.h>
+#include "IPC.h"
+
+//Key segment: the keys of every owner in one sealed memfd, a KeySegmentHeader followed by the keys owner by owner
+//The manager writes the keys straight into it, seals it and keeps reading it through a read-only mapping; one frame
+//per process passes the descriptor, and every process reads its own slice and the slices of the others in place
+//(dispatch_msg maps it for the handler), so handing out the keys costs P messages instead of P^2 key sets
+//With IPC_INLINE_PAYLOADS=1 the segment is a heap buffer that goes through the transport like any large message
+
+#define KEY_SEGMENT_MAGIC 0x4b455953u       //"KEYS"
+
+typedef struct{
+    uint32_t magic;
+    int32_t num_owners;
+    uint64_t offsets[MAX_PROCESSES];        //in keys from the first key
+    int32_t counts[MAX_PROCESSES];
+} KeySegmentHeader;
+
+//Sender side
+typedef struct{
+    KeySegmentHeader *header;
+    int *keys;                  //owner p's keys start at keys + header->offsets[p]
+    size_t size;
+    int fd;                     //-1 for an inline segment
+    int sealed;
+} KeySegment;
+
+int key_segment_create(KeySegment *segment, const char *name, int num_owners, const int *counts);
+int *key_segment_owner_keys(KeySegment *segment, int owner);
+int key_segment_seal(KeySegment *segment);
+int send_key_segment(int sender_id, const int *receivers, int num_receivers, MsgType type, uint32_t request_id,
+                     KeySegment *segment);
+void key_segment_destroy(KeySegment *segment);
+
+//Receiver side: the keys of owner in a received segment, 0 of them if the segment is malformed
+int key_segment_slice(const MsgHeader *hdr, const char *payload, int owner, const int **keys);
+int key_segment_owners(const MsgHeader *hdr, const char *payload);
+
+#endif
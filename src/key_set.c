@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "key_set.h"
+
+//Fibonacci hashing as in inflight.c, keys generated as a range (keygen.h) would otherwise fill neighbouring slots
+static inline uint32_t slot_of(const KeySet *set, int key){
+    return (uint32_t)((uint32_t)key * 2654435761u) & set->mask;
+}
+
+static int alloc_slots(KeySet *set, uint32_t size){
+    set->slots = malloc((size_t)size * sizeof(int64_t));
+    if(set->slots == NULL){
+        fprintf(stderr, "[ERROR HAPPENED] : failed to allocate key set of %u slots\n", size);
+        return -1;
+    }
+    for(uint32_t i = 0; i < size; i++){
+        set->slots[i] = KEY_SET_EMPTY;
+    }
+    set->mask = size - 1;
+    set->count = 0;
+    return 0;
+}
+
+int key_set_init(KeySet *set, uint32_t capacity){
+    uint32_t size = 16;
+    while(size < capacity * 2){
+        size <<= 1;
+    }
+    return alloc_slots(set, size);
+}
+
+//Doubles the array and puts the keys back, keeps the set at most half full
+static int grow(KeySet *set){
+    int64_t *old = set->slots;
+    uint32_t old_size = set->mask + 1;
+    if(alloc_slots(set, old_size * 2) != 0){
+        set->slots = old;
+        set->mask = old_size - 1;
+        return -1;
+    }
+    for(uint32_t i = 0; i < old_size; i++){
+        if(old[i] != KEY_SET_EMPTY){
+            key_set_add(set, (int)old[i]);
+        }
+    }
+    free(old);
+    return 0;
+}
+
+//Returns 1 if the key was added, 0 if it was there already, -1 if the array could not grow
+int key_set_add(KeySet *set, int key){
+    if((set->count + 1) * 2 > set->mask + 1){
+        uint32_t count = set->count;
+        if(grow(set) != 0){
+            set->count = count;
+            return -1;
+        }
+    }
+    uint32_t i = slot_of(set, key);
+    while(set->slots[i] != KEY_SET_EMPTY){
+        if(set->slots[i] == key){
+            return 0;
+        }
+        i = (i + 1) & set->mask;
+    }
+    set->slots[i] = key;
+    set->count++;
+    return 1;
+}
+
+int key_set_contains(const KeySet *set, int key){
+    if(set->slots == NULL){
+        return 0;
+    }
+    uint32_t i = slot_of(set, key);
+    while(set->slots[i] != KEY_SET_EMPTY){
+        if(set->slots[i] == key){
+            return 1;
+        }
+        i = (i + 1) & set->mask;
+    }
+    return 0;
+}
+
+//Backward-shift deletion as in inflight_remove, so lookups never walk over tombstones; returns 1 if the key was there
+int key_set_remove(KeySet *set, int key){
+    if(set->slots == NULL){
+        return 0;
+    }
+    uint32_t hole = slot_of(set, key);
+    while(set->slots[hole] != key){
+        if(set->slots[hole] == KEY_SET_EMPTY){
+            return 0;
+        }
+        hole = (hole + 1) & set->mask;
+    }
+    uint32_t i = (hole + 1) & set->mask;
+    while(set->slots[i] != KEY_SET_EMPTY){
+        uint32_t home = slot_of(set, (int)set->slots[i]);
+        if(((i - home) & set->mask) >= ((i - hole) & set->mask)){
+            set->slots[hole] = set->slots[i];
+            hole = i;
+        }
+        i = (i + 1) & set->mask;
+    }
+    set->slots[hole] = KEY_SET_EMPTY;
+    set->count--;
+    return 1;
+}
+
+void key_set_destroy(KeySet *set){
+    free(set->slots);
+    set->slots = NULL;
+    set->mask = 0;
+    set->count = 0;
+}
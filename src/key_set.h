@@ -0,0 +1,24 @@
+#ifndef KEY_SET_H
+
+#define KEY_SET_H
+#include <stdint.h>
+
+//A process's own keys, the table behind check_own_keys
+//Open addressing with linear probing like inflight.h, but keys can be removed (deletes phases) and the array doubles
+//when inserts fill it past half; hsearch_r could do neither
+
+typedef struct{
+    int64_t *slots;             //KEY_SET_EMPTY = empty slot, keys are ints so it never collides with one
+    uint32_t mask;
+    uint32_t count;
+} KeySet;
+
+#define KEY_SET_EMPTY INT64_MIN
+
+int key_set_init(KeySet *set, uint32_t capacity);
+int key_set_add(KeySet *set, int key);
+int key_set_remove(KeySet *set, int key);
+int key_set_contains(const KeySet *set, int key);
+void key_set_destroy(KeySet *set);
+
+#endif
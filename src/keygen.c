@@ -0,0 +1,145 @@
+#define _POSIX_C_SOURCE 199309L
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "keygen.h"
+
+#define KEYGEN_MIN_PER_THREAD 65536     //below this a thread costs more than it saves
+
+//splitmix64: the output for counter is independent of every other counter, so any thread can start anywhere
+uint64_t keygen_random(uint64_t seed, uint64_t counter){
+    uint64_t z = seed + (counter + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void key_permutation_init(KeyPermutation *perm, uint64_t n, uint64_t seed){
+    int bits = 2;
+    while(bits < 64 && (1ULL << bits) < n){
+        bits++;
+    }
+    perm->n = n;
+    perm->left_bits = bits - bits / 2;
+    perm->right_bits = bits / 2;
+    for(int r = 0; r < KEYGEN_ROUNDS; r++){
+        perm->round_keys[r] = keygen_random(seed, r);
+    }
+}
+
+//Unbalanced when the width is odd: the halves swap widths every round and are back in place after an even number
+//One multiply per round is enough mixing for a half of at most 32 bits, the round keys come from splitmix64
+static uint64_t feistel(const KeyPermutation *perm, uint64_t x){
+    int left_bits = perm->left_bits;
+    int right_bits = perm->right_bits;
+    uint64_t left = x >> right_bits;
+    uint64_t right = x & ((1ULL << right_bits) - 1);
+    for(int r = 0; r < KEYGEN_ROUNDS; r++){
+        uint64_t h = (right ^ perm->round_keys[r]) * 0x9e3779b97f4a7c15ULL;
+        uint64_t next = left ^ ((h ^ (h >> 32)) & ((1ULL << left_bits) - 1));
+        left = right;
+        right = next;
+        int swap = left_bits;
+        left_bits = right_bits;
+        right_bits = swap;
+    }
+    return (left << right_bits) | right;
+}
+
+//The i-th element of the permutation, i < n
+uint64_t key_permutation_at(const KeyPermutation *perm, uint64_t i){
+    uint64_t x = i;
+    do{
+        x = feistel(perm, x);
+    } while(x >= perm->n);
+    return x;
+}
+
+void keygen_config_from_env(KeyGen *gen){
+    const char *seed = getenv("KEYGEN_SEED");
+    const char *threads = getenv("KEYGEN_THREADS");
+    uint64_t value;
+    if(seed != NULL){
+        value = strtoull(seed, NULL, 0);
+    } else{
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        value = keygen_random((uint64_t)ts.tv_sec, (uint64_t)ts.tv_nsec ^ ((uint64_t)getpid() << 32));
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    keygen_init(gen, value, threads != NULL && atoi(threads) > 0 ? atoi(threads) : (cpus > 0 ? (int)cpus : 1));
+}
+
+void keygen_init(KeyGen *gen, uint64_t seed, int threads){
+    gen->seed = seed;
+    gen->threads = threads;
+    key_permutation_init(&gen->keys, KEYGEN_KEY_RANGE, seed);
+}
+
+typedef struct{
+    const KeyPermutation *perm;
+    int *keys;
+    uint64_t first_index;
+    uint64_t count;
+    int threaded;
+} FillRange;
+
+static void *fill_range(void *arg){
+    FillRange *range = arg;
+    for(uint64_t i = 0; i < range->count; i++){
+        range->keys[i] = (int)key_permutation_at(range->perm, range->first_index + i);
+    }
+    return NULL;
+}
+
+//Keys number first_index to first_index + count - 1 into keys, split between the threads
+void keygen_fill(const KeyGen *gen, int *keys, uint64_t first_index, uint64_t count){
+    if(first_index + count > KEYGEN_KEY_RANGE){
+        fprintf(stderr, "[ERROR HAPPENED] : Only %d distinct keys, key %llu was asked for\n", KEYGEN_KEY_RANGE,
+                (unsigned long long)(first_index + count - 1));
+        exit(1);
+    }
+    int threads = gen->threads;
+    if((uint64_t)threads > count / KEYGEN_MIN_PER_THREAD){
+        threads = (int)(count / KEYGEN_MIN_PER_THREAD);
+    }
+    if(threads <= 1){
+        FillRange range = {&gen->keys, keys, first_index, count, 0};
+        fill_range(&range);
+        return;
+    }
+
+    pthread_t *tids = malloc(threads * sizeof(pthread_t));
+    FillRange *ranges = malloc(threads * sizeof(FillRange));
+    if(tids == NULL || ranges == NULL){
+        fprintf(stderr, "[ERROR HAPPENED] : Could not allocate the key generation threads\n");
+        exit(1);
+    }
+    uint64_t offset = 0;
+    for(int t = 0; t < threads; t++){
+        uint64_t share = count / threads + ((uint64_t)t < count % threads);
+        ranges[t] = (FillRange){&gen->keys, keys + offset, first_index + offset, share, 1};
+        offset += share;
+        //Without a thread the range is filled here, the keys are the same either way
+        if(pthread_create(&tids[t], NULL, fill_range, &ranges[t]) != 0){
+            ranges[t].threaded = 0;
+            fill_range(&ranges[t]);
+        }
+    }
+    for(int t = 0; t < threads; t++){
+        if(ranges[t].threaded){
+            pthread_join(tids[t], NULL);
+        }
+    }
+    free(tids);
+    free(ranges);
+}
+
+void keygen_print(FILE *fp, const KeyGen *gen){
+    fprintf(fp, "Key seed: %llu (KEYGEN_SEED to repeat the run), %d key generation threads\n",
+            (unsigned long long)gen->seed, gen->threads);
+}
@@ -0,0 +1,39 @@
+#ifndef KEYGEN_H
+
+#define KEYGEN_H
+#include <stdio.h>
+#include <stdint.h>
+
+//Key generation for the manager: key number i (0, 1, 2, ... over the build keys and then the inserted keys) is a keyed
+//permutation of i over [0, KEYGEN_KEY_RANGE), so keys never repeat, and the same KEYGEN_SEED gives the same keys in
+//the same order however many threads (KEYGEN_THREADS, default the online CPUs) compute them
+//The permutation is a 4 round Feistel network on the next power of two with a multiply-xorshift round function;
+//values past the range walk the cycle again (under 2 steps on average)
+//Deletes draw their k of n keys through a permutation of [0, n) as well: k distinct picks in O(k), no table of n
+
+#define KEYGEN_KEY_RANGE 100000000      //queries that should miss ask for keys at or above it
+#define KEYGEN_ROUNDS 4
+
+typedef struct{
+    uint64_t n;
+    int left_bits;
+    int right_bits;
+    uint64_t round_keys[KEYGEN_ROUNDS];
+} KeyPermutation;
+
+typedef struct{
+    uint64_t seed;
+    int threads;
+    KeyPermutation keys;
+} KeyGen;
+
+uint64_t keygen_random(uint64_t seed, uint64_t counter);
+void key_permutation_init(KeyPermutation *perm, uint64_t n, uint64_t seed);
+uint64_t key_permutation_at(const KeyPermutation *perm, uint64_t i);
+
+void keygen_config_from_env(KeyGen *gen);
+void keygen_init(KeyGen *gen, uint64_t seed, int threads);
+void keygen_fill(const KeyGen *gen, int *keys, uint64_t first_index, uint64_t count);
+void keygen_print(FILE *fp, const KeyGen *gen);
+
+#endif
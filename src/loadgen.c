@@ -0,0 +1,489 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "IPC.h"
+#include "loadgen.h"
+#include "inflight.h"
+#include "workload.h"
+
+#define MAX_MSG_LEN 65536
+
+static uint64_t now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double env_double(const char *name, double fallback){
+    const char *env = getenv(name);
+    return env != NULL && atof(env) > 0 ? atof(env) : fallback;
+}
+
+void loadgen_config_from_env(LoadgenConfig *config){
+    const char *mode = getenv("LOADGEN_MODE");
+    const char *arrivals = getenv("LOADGEN_ARRIVALS");
+    config->mode = LOADGEN_PACED;
+    if(mode != NULL && strcmp(mode, "open") == 0){
+        config->mode = LOADGEN_OPEN;
+    } else if(mode != NULL && strcmp(mode, "closed") == 0){
+        config->mode = LOADGEN_CLOSED;
+    } else if(mode != NULL && strcmp(mode, "paced") != 0){
+        fprintf(stderr, "[ERROR HAPPENED] : unknown LOADGEN_MODE %s, using paced\n", mode);
+    }
+    config->arrivals = arrivals != NULL && strcmp(arrivals, "constant") == 0 ? LOADGEN_CONSTANT : LOADGEN_POISSON;
+    config->target_qps = env_double("LOADGEN_QPS", LOADGEN_DEFAULT_QPS);
+    config->outstanding = (int)env_double("LOADGEN_OUTSTANDING", LOADGEN_DEFAULT_OUTSTANDING);
+    config->query_timeout_ms = (int)env_double("LOADGEN_QUERY_TIMEOUT_MS", LOADGEN_DEFAULT_QUERY_TIMEOUT_MS);
+    config->clients = (int)env_double("LOADGEN_CLIENTS", LOADGEN_DEFAULT_CLIENTS);
+    config->next_gap = NULL;
+    config->first_request_id = 1;
+    config->rebuild_epoch = NULL;
+}
+
+const char *loadgen_mode_name(LoadgenMode mode){
+    switch(mode){
+        case LOADGEN_OPEN: return "open";
+        case LOADGEN_CLOSED: return "closed";
+        default: return "paced";
+    }
+}
+
+//Time to the next query of the open loop: exponential gaps give Poisson arrivals with the same mean rate
+static uint64_t next_gap_ns(const LoadgenConfig *config){
+    if(config->next_gap != NULL){
+        return config->next_gap();
+    }
+    double mean_ns = 1e9 / config->target_qps;
+    if(config->arrivals == LOADGEN_CONSTANT){
+        return (uint64_t)mean_ns;
+    }
+    double u = (workload_rand() + 1.0) / ((double)RAND_MAX + 2.0);
+    return (uint64_t)(-log(u) * mean_ns);
+}
+
+static void init_result(LoadgenResult *result){
+    memset(result, 0, sizeof(*result));
+    histogram_init(&result->latency);
+    histogram_init(&result->service);
+    histogram_init(&result->latency_rebuild);
+    histogram_init(&result->latency_steady);
+}
+
+typedef struct{
+    const LoadgenConfig *config;
+    LoadgenResult *result;
+    InflightTable queries;      //queries in flight, request id = first id + index
+    uint64_t start_ns;
+    int num_queries;
+    uint32_t oldest_id;         //no query with a smaller id is still in flight
+    uint32_t next_id;
+    int completed;
+} LoadgenRun;
+
+static uint32_t rebuild_epoch(const LoadgenRun *run){
+    return run->config->rebuild_epoch != NULL ? __atomic_load_n(run->config->rebuild_epoch, __ATOMIC_ACQUIRE) : 0;
+}
+
+//Records the latency of a query that was answered or timed out at now, and with a rebuild epoch which window it fell in
+//in_warmup comes from the one histogram_in_warmup call per query, which also counts it as left out
+static void record_latency(LoadgenRun *run, const InflightEntry *query, uint64_t now, int in_warmup){
+    if(in_warmup){
+        return;
+    }
+    histogram_record(&run->result->latency, now - query->due_ns);
+    if(run->config->rebuild_epoch != NULL){
+        int overlapped = (query->tag & 1) || rebuild_epoch(run) != query->tag;
+        histogram_record(overlapped ? &run->result->latency_rebuild : &run->result->latency_steady, now - query->due_ns);
+    }
+}
+
+static void record_answer(LoadgenRun *run, const char *buf, int len, uint64_t now){
+    MsgHeader hdr;
+    const char *payload;
+    if(decode_msg(buf, len, &hdr, &payload) < 0 || (hdr.type != MSG_FOUND && hdr.type != MSG_NOTFOUND)){
+        return;
+    }
+    InflightEntry *query = inflight_find(&run->queries, hdr.request_id);
+    if(query == NULL){
+        run->result->late++;
+        return;
+    }
+    run->completed++;
+    if(hdr.type == MSG_FOUND){
+        run->result->found++;
+    } else{
+        run->result->not_found++;
+    }
+    int in_warmup = histogram_in_warmup(&run->result->latency, run->start_ns, query->due_ns);
+    if(!in_warmup){
+        histogram_record(&run->result->service, now - query->start_ns);
+    }
+    record_latency(run, query, now, in_warmup);
+    inflight_remove(&run->queries, query);
+}
+
+//Ids are handed out in send order, so the queries that can time out first are the ones from oldest_id on
+//Returns the oldest query still in flight, or NULL
+static InflightEntry *expire_queries(LoadgenRun *run, uint64_t now){
+    uint64_t timeout_ns = (uint64_t)run->config->query_timeout_ms * 1000000ULL;
+    while(run->oldest_id < run->next_id){
+        InflightEntry *query = inflight_find(&run->queries, run->oldest_id);
+        if(query != NULL){
+            if(now - query->start_ns < timeout_ns){
+                return query;
+            }
+            run->completed++;
+            run->result->timed_out++;
+            //Its latency is at least this long, leaving it out would make the tail look better the more queries are lost
+            record_latency(run, query, now, histogram_in_warmup(&run->result->latency, run->start_ns, query->due_ns));
+            inflight_remove(&run->queries, query);
+        }
+        run->oldest_id++;
+    }
+    return NULL;
+}
+
+//Most queries that can be in flight: the closed loop keeps its window, the open loop sends for at most the timeout
+//before the first ones expire (with some room for Poisson bursts)
+static uint32_t table_capacity(const LoadgenConfig *config, int num_queries){
+    double capacity = config->outstanding;
+    if(config->mode == LOADGEN_OPEN){
+        capacity = config->target_qps * config->query_timeout_ms / 1000.0 * 1.25 + IPC_BATCH_SIZE;
+    }
+    return capacity < num_queries ? (uint32_t)capacity : (uint32_t)num_queries;
+}
+
+static int drain_answers(LoadgenRun *run, int fd, char *buf){
+    int received = 0;
+    int n;
+    while((n = receive_msg(fd, buf, MAX_MSG_LEN)) > 0){
+        record_answer(run, buf, n, now_ns());
+        received++;
+    }
+    return received;
+}
+
+//Runs num_queries queries from pick() in the open or closed loop of config, with request ids from first_id on
+//Memory is bounded by the queries in flight, not by num_queries
+static void run_client(const LoadgenConfig *config, int fd, int sender_id, uint32_t first_id, int num_queries,
+                       LoadgenPickQuery pick, LoadgenResult *result){
+    static __thread char buf[MAX_MSG_LEN] __attribute__((aligned(8)));
+    LoadgenRun run = {
+        .config = config,
+        .result = result,
+        .num_queries = num_queries,
+        .oldest_id = first_id,
+        .next_id = first_id,
+    };
+    init_result(result);
+    if(inflight_init(&run.queries, table_capacity(config, num_queries)) < 0){
+        exit(1);
+    }
+
+    uint64_t start = now_ns();
+    run.start_ns = start;
+    uint64_t next_send = start;
+    uint64_t last_send = start;
+    int sent = 0;
+
+    while(run.completed < num_queries){
+        uint64_t now = now_ns();
+        InflightEntry *oldest = expire_queries(&run, now);
+        uint64_t oldest_start = oldest != NULL ? oldest->start_ns : 0;
+
+        //A late open loop catches up with a burst, capped so answers are still read in between
+        //A full table or frames that wait for credits (a process that can't keep up) hold the open loop back like a slow
+        //send would, the due times keep that in the latency; queueing them instead would only grow the backlog without bound
+        int burst = 0;
+        while(sent < num_queries && burst < IPC_BATCH_SIZE && run.queries.count < run.queries.capacity && ipc_pending() == 0){
+            if(config->mode == LOADGEN_CLOSED ? (int)run.queries.count >= config->outstanding : now < next_send){
+                break;
+            }
+            int key, target;
+            result->num_by_kind[pick(&key, &target)]++;
+            uint32_t request_id = run.next_id++;
+            InflightEntry *query = inflight_insert(&run.queries, request_id);
+            query->key = key;
+            query->start_ns = now_ns();
+            query->due_ns = config->mode == LOADGEN_OPEN ? next_send : query->start_ns;
+            query->tag = rebuild_epoch(&run);
+            if(oldest_start == 0){
+                oldest_start = query->start_ns;
+            }
+            send_key_frame(sender_id, target, MSG_QUERY, request_id, 0, key);
+            last_send = query->start_ns;
+            sent++;
+            burst++;
+            next_send += next_gap_ns(config);
+        }
+        result->sent = sent;
+        if((int)run.queries.count > result->max_outstanding){
+            result->max_outstanding = run.queries.count;
+        }
+
+        if(drain_answers(&run, fd, buf) > 0 || burst == IPC_BATCH_SIZE){
+            continue;
+        }
+
+        //Nothing to read: block until an answer comes, the next query is due or the oldest query times out
+        now = now_ns();
+        uint64_t deadline = now + (uint64_t)config->query_timeout_ms * 1000000ULL;
+        if(run.queries.count > 0 && oldest_start != 0){
+            deadline = oldest_start + (uint64_t)config->query_timeout_ms * 1000000ULL;
+        }
+        if(config->mode == LOADGEN_OPEN && sent < num_queries && next_send < deadline && run.queries.count < run.queries.capacity
+           && ipc_pending() == 0){
+            deadline = next_send;
+        }
+        if(deadline <= now){
+            continue;
+        }
+        if(deadline - now < LOADGEN_POLL_WINDOW_NS){
+            //ipc_wait only has millisecond timeouts, so short gaps are polled; the yield leaves the CPU to the processes
+            sched_yield();
+        } else{
+            ipc_wait(fd, (int)((deadline - now) / 1000000ULL));
+        }
+    }
+
+    uint64_t end = now_ns();
+    result->duration_ms = (end - start) / 1000000.0;
+    result->send_duration_ms = (last_send - start) / 1000000.0;
+    //Answers to timed out queries that are still on their way would otherwise end up in the next phase's receive loop
+    drain_answers(&run, fd, buf);
+    inflight_destroy(&run.queries);
+}
+
+static void summarize_client(LoadgenClientSummary *summary, const LoadgenResult *result){
+    summary->sent = result->sent;
+    summary->answered = result->found + result->not_found;
+    summary->timed_out = result->timed_out;
+    summary->duration_ms = result->duration_ms;
+    summary->p99_ns = histogram_percentile(&result->latency, 99.0);
+}
+
+void loadgen_merge(LoadgenResult *dst, const LoadgenResult *src){
+    dst->sent += src->sent;
+    dst->found += src->found;
+    dst->not_found += src->not_found;
+    dst->timed_out += src->timed_out;
+    dst->late += src->late;
+    dst->max_outstanding += src->max_outstanding;
+    if(src->duration_ms > dst->duration_ms) dst->duration_ms = src->duration_ms;
+    if(src->send_duration_ms > dst->send_duration_ms) dst->send_duration_ms = src->send_duration_ms;
+    for(int k = 0; k < LOADGEN_QUERY_KINDS; k++){
+        dst->num_by_kind[k] += src->num_by_kind[k];
+    }
+    histogram_merge(&dst->latency, &src->latency);
+    histogram_merge(&dst->service, &src->service);
+    histogram_merge(&dst->latency_rebuild, &src->latency_rebuild);
+    histogram_merge(&dst->latency_steady, &src->latency_steady);
+}
+
+
+//What a client runs: its share of the queries under id client_id, its result goes to the shared mapping
+typedef struct{
+    const LoadgenConfig *config;
+    int inherited_fd;
+    int client_id;
+    int num_processes;          //the processes it queries are ids 0..num_processes-1
+    unsigned seed;
+    uint32_t first_id;
+    int num_queries;
+    LoadgenPickQuery pick;
+    LoadgenShared *shared;
+    LoadgenResult *result;
+    pthread_t thread;
+} LoadgenClient;
+
+//Filled by the clients, mapped before the fork so the manager sees it
+struct LoadgenShared{
+    int num_ready;              //clients that are listening under their own id
+    int go;
+    int num_done;               //clients that ran all their queries
+    LoadgenConfig config;       //of every client, kept here for the threads that read it until loadgen_finish
+    LoadgenClient clients[MAX_PROCESSES];
+    LoadgenResult results[];
+};
+
+//A forked client drops the manager's socket state and binds its own id, a thread starts out with fresh state
+//(IPC.c keeps it per thread); either way it draws its queries from a generator of its own (workload_rand)
+static void client_main(LoadgenClient *client, int in_process){
+    int fd;
+    workload_seed(client->seed);
+    if(in_process){
+        fd = initiate_communication(client->client_id);
+    } else{
+        fd = reinitiate_communication(client->client_id, client->inherited_fd);
+    }
+    //A client of an earlier phase had this id, the processes may still keep its credits and frames
+    ipc_rejoin(client->num_processes);
+    LoadgenShared *shared = client->shared;
+    __atomic_add_fetch(&shared->num_ready, 1, __ATOMIC_RELEASE);
+    while(!__atomic_load_n(&shared->go, __ATOMIC_ACQUIRE)){
+        usleep(100);
+    }
+    run_client(client->config, fd, client->client_id, client->first_id, client->num_queries, client->pick, client->result);
+    close_communication(client->client_id, fd);
+    __atomic_add_fetch(&shared->num_done, 1, __ATOMIC_RELEASE);
+}
+
+static void *client_thread(void *arg){
+    client_main(arg, 1);
+    return NULL;
+}
+
+//Clients that fit next to the manager's id, and no more than there are queries
+static int clamp_clients(int num_clients, int sender_id, int num_queries){
+    if(num_clients > MAX_PROCESSES - sender_id){
+        num_clients = MAX_PROCESSES - sender_id;
+        fprintf(stderr, "[ERROR HAPPENED] : Only %d load generator clients fit next to the manager's id %d\n", num_clients, sender_id);
+    }
+    if(num_clients > num_queries){
+        num_clients = num_queries;
+    }
+    return num_clients;
+}
+
+//Forks num_clients clients with ids sender_id + 1 on, gives each an even share of the queries and of the open loop's
+//rate, and starts them together once all of them listen
+void loadgen_start(const LoadgenConfig *config, int fd, int sender_id, int num_queries, LoadgenPickQuery pick,
+                   LoadgenBackground *background){
+    int num_clients = clamp_clients(config->clients > 1 ? config->clients : 1, sender_id, num_queries);
+    LoadgenConfig client_config = *config;
+    client_config.target_qps = config->target_qps / (num_clients > 0 ? num_clients : 1);
+    background->num_clients = num_clients;
+    background->in_process = ipc_in_process();
+    background->shared_size = sizeof(LoadgenShared) + (size_t)num_clients * sizeof(LoadgenResult);
+    LoadgenShared *shared = mmap(NULL, background->shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(shared == MAP_FAILED){
+        perror("[ERROR HAPPENED] : Could not map the load generator results");
+        exit(1);
+    }
+    background->shared = shared;
+    shared->config = client_config;
+    uint32_t first_id = config->first_request_id;
+    fflush(stdout);
+    fflush(stderr);
+    for(int c = 0; c < num_clients; c++){
+        int share = num_queries / num_clients + (c < num_queries % num_clients);
+        LoadgenClient *client = &shared->clients[c];
+        *client = (LoadgenClient){&shared->config, fd, sender_id + 1 + c, sender_id, workload_rand(), first_id, share, pick, shared, &shared->results[c]};
+        first_id += share;
+        if(background->in_process){
+            if(pthread_create(&client->thread, NULL, client_thread, client) != 0){
+                fprintf(stderr, "[ERROR HAPPENED] : Could not start a load generator client thread\n");
+                exit(1);
+            }
+            continue;
+        }
+        background->pids[c] = fork();
+        if(background->pids[c] < 0){
+            perror("[ERROR HAPPENED] : Could not fork a load generator client");
+            exit(1);
+        }
+        if(background->pids[c] == 0){
+            client_main(client, 0);
+            //The manager's stdio buffers and atexit handlers came with the fork, they are not ours to flush
+            _exit(0);
+        }
+    }
+    while(__atomic_load_n(&shared->num_ready, __ATOMIC_ACQUIRE) < num_clients){
+        usleep(100);
+    }
+    __atomic_store_n(&shared->go, 1, __ATOMIC_RELEASE);
+}
+
+//1 once every client ran all its queries (a client that died is only noticed by loadgen_finish)
+int loadgen_done(const LoadgenBackground *background){
+    return __atomic_load_n(&background->shared->num_done, __ATOMIC_ACQUIRE) >= background->num_clients;
+}
+
+//Waits for the clients and merges their results
+void loadgen_finish(LoadgenBackground *background, LoadgenResult *result){
+    LoadgenShared *shared = background->shared;
+    init_result(result);
+    for(int c = 0; c < background->num_clients; c++){
+        int status = 0;
+        if(background->in_process){
+            pthread_join(shared->clients[c].thread, NULL);
+        } else{
+            waitpid(background->pids[c], &status, 0);
+        }
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+            fprintf(stderr, "[ERROR HAPPENED] : Load generator client %d failed, its queries are missing\n", c);
+            init_result(&shared->results[c]);
+        }
+        loadgen_merge(result, &shared->results[c]);
+        summarize_client(&result->clients[c], &shared->results[c]);
+    }
+    result->num_clients = background->num_clients;
+    munmap(shared, background->shared_size);
+    background->shared = NULL;
+}
+
+//Runs num_queries queries from pick() in the open or closed loop of config, in the manager itself or spread over
+//config->clients clients (ids sender_id + 1 on, as many as fit under MAX_PROCESSES), and fills result
+void loadgen_run(const LoadgenConfig *config, int fd, int sender_id, int num_queries, LoadgenPickQuery pick, LoadgenResult *result){
+    if(config->clients <= 1 || num_queries <= 1){
+        run_client(config, fd, sender_id, config->first_request_id, num_queries, pick, result);
+        result->num_clients = 1;
+        summarize_client(&result->clients[0], result);
+        return;
+    }
+    LoadgenBackground background;
+    loadgen_start(config, fd, sender_id, num_queries, pick, &background);
+    loadgen_finish(&background, result);
+}
+
+void loadgen_print(FILE *fp, const LoadgenConfig *config, const LoadgenResult *result){
+    uint64_t answered = result->found + result->not_found;
+    double duration_s = result->duration_ms / 1000.0;
+    double send_duration_s = result->send_duration_ms / 1000.0;
+    fprintf(fp, "\nRESULTS:\n");
+    if(config->mode == LOADGEN_OPEN && config->next_gap != NULL){
+        fprintf(fp, "Load: open loop on a recorded schedule\n");
+    } else if(config->mode == LOADGEN_OPEN){
+        fprintf(fp, "Load: open loop, %s arrivals, target %.0f QPS\n", config->arrivals == LOADGEN_CONSTANT ? "constant" : "poisson", config->target_qps);
+    } else{
+        fprintf(fp, "Load: closed loop, %d outstanding\n", config->outstanding);
+    }
+    fprintf(fp, "Queries sent: %llu\n", (unsigned long long)result->sent);
+    fprintf(fp, "Queries answered: %llu (found %llu, not found %llu)\n", (unsigned long long)answered,
+            (unsigned long long)result->found, (unsigned long long)result->not_found);
+    fprintf(fp, "Queries timed out: %llu (after %d ms), late answers: %llu\n", (unsigned long long)result->timed_out,
+            config->query_timeout_ms, (unsigned long long)result->late);
+    fprintf(fp, "Offered load: %.0f QPS\n", send_duration_s > 0 ? result->sent / send_duration_s : 0);
+    fprintf(fp, "Throughput: %.0f QPS (%.1f ms)\n", duration_s > 0 ? answered / duration_s : 0, result->duration_ms);
+    fprintf(fp, "Max outstanding: %d\n", result->max_outstanding);
+    if(result->num_clients > 1){
+        fprintf(fp, "Clients: %d\n", result->num_clients);
+        for(int c = 0; c < result->num_clients; c++){
+            const LoadgenClientSummary *client = &result->clients[c];
+            fprintf(fp, "  client %d: %llu sent, %llu answered, %llu timed out, %.0f QPS, p99 %.3f ms\n", c,
+                    (unsigned long long)client->sent, (unsigned long long)client->answered, (unsigned long long)client->timed_out,
+                    client->duration_ms > 0 ? client->answered / (client->duration_ms / 1000.0) : 0, client->p99_ns / 1000000.0);
+        }
+    }
+    fprintf(fp, "Avg time: %.2f ms\n", histogram_mean(&result->latency) / 1000000.0);
+    fprintf(fp, "Min time: %.2f ms\n", result->latency.total > 0 ? result->latency.min / 1000000.0 : 0);
+    fprintf(fp, "Max time: %.2f ms\n", result->latency.max / 1000000.0);
+    if(config->mode == LOADGEN_OPEN){
+        histogram_print(fp, "Latency from scheduled send", &result->latency);
+        histogram_print(fp, "Service time from actual send", &result->service);
+    } else{
+        histogram_print(fp, "Latency", &result->latency);
+    }
+    if(config->rebuild_epoch != NULL){
+        histogram_print(fp, "Latency of queries that overlapped a rebuild", &result->latency_rebuild);
+        histogram_print(fp, "Latency of queries between rebuilds", &result->latency_steady);
+    }
+}
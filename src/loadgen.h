@@ -0,0 +1,124 @@
+#ifndef LOADGEN_H
+
+#define LOADGEN_H
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "histogram.h"
+#include "IPC.h"
+
+//Query load generator of the managers, selected with LOADGEN_MODE:
+//paced (default): the original loops, one query every usleep(100) with a drain every fifth query
+//open: queries leave at LOADGEN_QPS on a fixed schedule (LOADGEN_ARRIVALS=poisson, the default, or constant),
+//whether or not the earlier ones were answered, so a slow summary shows up as latency and a falling answer rate
+//closed: LOADGEN_OUTSTANDING queries are kept in flight, a new one leaves as soon as one is answered,
+//so the answer rate is the saturation throughput of the fleet
+//Every query carries its index + 1 as request id, which the processes echo in FOUND/NOTFOUND; answers are matched
+//through an open-addressing table of the queries in flight (inflight.h)
+//A query without an answer after LOADGEN_QUERY_TIMEOUT_MS counts as timed out and frees its slot
+//LOADGEN_CLIENTS > 1 forks that many clients once the keys are built, each with its own socket id above the manager's;
+//they read the key tables the manager built (shared copy-on-write, never written) and run the open or closed loop in
+//parallel on disjoint request ids, the processes answer the client that asked. The open loop's LOADGEN_QPS is split
+//between them, LOADGEN_OUTSTANDING holds per client. Their results come back through a shared mapping and are merged
+//With IPC_TRANSPORT=thread the clients are threads of the manager instead of forked processes
+//Latency is taken from the time a query was due, not from when it left: if the open loop falls behind,
+//the wait before sending is part of the latency, as it would be for a user (no coordinated omission);
+//"service" is measured from the actual send. The closed loop only sends when an answer came back, so its latency
+//is the service time at that concurrency and is best read together with its throughput
+//loadgen_start runs the clients in the background (at least one, the manager's own socket stays free for the barriers)
+//while the manager changes the summaries; with rebuild_epoch set, every query whose lifetime overlapped a rebuild
+//(the epoch was odd when it left, or changed before it was answered) also goes into latency_rebuild, the others into
+//latency_steady
+
+#define LOADGEN_DEFAULT_QPS 10000
+#define LOADGEN_DEFAULT_OUTSTANDING 16
+#define LOADGEN_DEFAULT_QUERY_TIMEOUT_MS 1000
+#define LOADGEN_DEFAULT_CLIENTS 1
+//Gaps to the next scheduled query shorter than this are spent polling (with sched_yield) instead of in ipc_wait
+#define LOADGEN_POLL_WINDOW_NS 1000000
+
+typedef enum{
+    LOADGEN_PACED = 0,
+    LOADGEN_OPEN,
+    LOADGEN_CLOSED
+} LoadgenMode;
+
+typedef enum{
+    LOADGEN_POISSON = 0,
+    LOADGEN_CONSTANT
+} LoadgenArrivals;
+
+//Time from the query just sent to the next one, for an open loop that follows a recorded schedule (trace.h)
+typedef uint64_t (*LoadgenNextGap)();
+
+typedef struct{
+    LoadgenMode mode;
+    LoadgenArrivals arrivals;
+    double target_qps;
+    int outstanding;
+    int query_timeout_ms;
+    int clients;
+    LoadgenNextGap next_gap;    //open loop: gaps from here instead of from LOADGEN_QPS and LOADGEN_ARRIVALS, NULL by default
+    uint32_t first_request_id;  //1 by default, runs one after another continue the ids so late answers can't match
+    const uint32_t *rebuild_epoch;  //shared with the manager, odd while the summaries are rebuilt; NULL by default
+} LoadgenConfig;
+
+//What pick() drew, the managers print the mix
+typedef enum{
+    LOADGEN_QUERY_LOCAL = 0,
+    LOADGEN_QUERY_REMOTE,
+    LOADGEN_QUERY_MISS,
+    LOADGEN_QUERY_KINDS
+} LoadgenQueryKind;
+
+typedef struct{
+    uint64_t sent;
+    uint64_t answered;
+    uint64_t timed_out;
+    double duration_ms;
+    uint64_t p99_ns;
+} LoadgenClientSummary;
+
+typedef struct{
+    uint64_t sent;
+    uint64_t found;
+    uint64_t not_found;
+    uint64_t timed_out;
+    uint64_t late;              //answers that came after their query timed out, or a second answer
+    int max_outstanding;        //with several clients the sum of their peaks
+    double duration_ms;         //first query sent to last query answered or timed out (slowest client)
+    double send_duration_ms;    //first to last query sent
+    uint64_t num_by_kind[LOADGEN_QUERY_KINDS];
+    Histogram latency;          //from the scheduled send time
+    Histogram service;          //from the actual send time
+    Histogram latency_rebuild;  //with rebuild_epoch: the queries that overlapped a rebuild
+    Histogram latency_steady;   //and the ones that did not
+    int num_clients;
+    LoadgenClientSummary clients[MAX_PROCESSES];
+} LoadgenResult;
+
+//Picks the next query: the key and the process it is sent to
+//With several clients it runs in each of them, so it may only read the manager's tables (and call workload_rand())
+typedef LoadgenQueryKind (*LoadgenPickQuery)(int *key, int *target_process);
+
+//Clients started by loadgen_start
+typedef struct LoadgenShared LoadgenShared;
+typedef struct{
+    LoadgenShared *shared;
+    size_t shared_size;
+    int num_clients;
+    int in_process;             //the clients are threads (IPC_TRANSPORT=thread), not processes
+    pid_t pids[MAX_PROCESSES];
+} LoadgenBackground;
+
+void loadgen_config_from_env(LoadgenConfig *config);
+const char *loadgen_mode_name(LoadgenMode mode);
+void loadgen_run(const LoadgenConfig *config, int fd, int sender_id, int num_queries, LoadgenPickQuery pick, LoadgenResult *result);
+void loadgen_start(const LoadgenConfig *config, int fd, int sender_id, int num_queries, LoadgenPickQuery pick,
+                   LoadgenBackground *background);
+int loadgen_done(const LoadgenBackground *background);
+void loadgen_finish(LoadgenBackground *background, LoadgenResult *result);
+void loadgen_merge(LoadgenResult *dst, const LoadgenResult *src);
+void loadgen_print(FILE *fp, const LoadgenConfig *config, const LoadgenResult *result);
+
+#endif
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <string.h>
+#include "IPC.h"
+#include "barrier.h"
+#include "key_segment.h"
+#include "manager_backend.h"
+
+//The keys of all processes go out as one key segment, a frame per process (MSG_KEY_SEGMENT); the build is over once
+//every process reported MSG_BUILT
+static void send_key_segment_and_wait(const ManagerFleet *fleet, MsgType type, KeySegment *keys, uint32_t id){
+    send_key_segment(fleet->num_processes, fleet->all_processes, fleet->num_processes, type, id, keys);
+    ipc_flush(fleet->fd, IPC_FLUSH_TIMEOUT_MS);
+    phase_barrier(fleet->fd, MSG_BUILT, id, fleet->num_processes);
+}
+
+//Bloom and counting Bloom: every process builds its filter from its own slice and broadcasts it, so queries start
+//once every process holds the filters of all peers (MSG_BROADCAST_DONE)
+static void build_own_keys(const ManagerFleet *fleet, KeySegment *keys){
+    phase_begin("build");
+    uint32_t build_id = phase_id();
+    send_key_segment_and_wait(fleet, MSG_KEY_SEGMENT, keys, build_id);
+    phase_end();
+
+    phase_begin("broadcast");
+    phase_barrier(fleet->fd, MSG_BROADCAST_DONE, build_id, fleet->num_processes);
+    phase_end();
+}
+
+//Every process applies the update and reports MSG_BUILT: a Bloom process its own slice, after which it rebuilds its
+//filter, a CQF process the slices of all owners to its CQF
+static void update_keys(const ManagerFleet *fleet, TraceOp op, KeySegment *keys, uint32_t id){
+    send_key_segment_and_wait(fleet, op == TRACE_DELETE ? MSG_DELETE_SEGMENT : MSG_INSERT_SEGMENT, keys, id);
+}
+
+//A rebuilt Bloom filter replaces the one every peer holds, so the update also waits for MSG_BROADCAST_DONE under its id
+static void update_own_keys(const ManagerFleet *fleet, TraceOp op, KeySegment *keys, uint32_t id){
+    update_keys(fleet, op, keys, id);
+    phase_barrier(fleet->fd, MSG_BROADCAST_DONE, id, fleet->num_processes);
+}
+
+//CQF: every process builds its hash table from its own slice and one CQF over the slices of all processes with
+//the owner as value. There is nothing to broadcast, queries start once all of them reported MSG_BUILT
+static void build_all_keys(const ManagerFleet *fleet, KeySegment *keys){
+    phase_begin("build");
+    printf("\nManager distributing all keys to all processes\n");
+    send_key_segment_and_wait(fleet, MSG_KEY_SEGMENT, keys, phase_id());
+    phase_end();
+}
+
+static const ManagerBackend backends[] = {
+    {"bloom", "./process_bloom", bloom_process_main, build_own_keys, update_own_keys},
+    //process_counting_bloom handles no update messages
+    {"counting_bloom", "./process_counting_bloom", counting_bloom_process_main, build_own_keys, NULL},
+    {"cqf", "./process_cqf", cqf_process_main, build_all_keys, update_keys},
+};
+
+const ManagerBackend *manager_backend_find(const char *name){
+    for(size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++){
+        if(strcmp(backends[i].name, name) == 0){
+            return &backends[i];
+        }
+    }
+    return NULL;
+}
+
+void manager_backend_list(FILE *fp){
+    for(size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++){
+        fprintf(fp, "%s%s", i > 0 ? "|" : "", backends[i].name);
+    }
+}
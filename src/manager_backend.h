@@ -0,0 +1,42 @@
+#ifndef MANAGER_BACKEND_H
+
+#define MANAGER_BACKEND_H
+#include <stdio.h>
+#include <stdint.h>
+#include "IPC.h"
+#include "key_segment.h"
+#include "trace.h"
+
+//What the manager has to know about a summary structure: how its processes get their keys and how they take updates
+//Everything else (startup, queries, key and update sampling, timing) is the same for every structure and lives in
+//Manager.c, so a fix there applies to all of them and they run exactly the same scenario
+
+//The processes the manager talks to, its own id is num_processes
+typedef struct{
+    int fd;
+    int num_processes;
+    int all_processes[MAX_PROCESSES];   //ids 0..num_processes-1, the receiver list for messages that go to every process
+} ManagerFleet;
+
+typedef struct{
+    const char *name;
+    const char *process_binary;         //default of PROCESS_BINARY
+    //main of that binary, linked into the manager for IPC_TRANSPORT=thread where every process is one of its threads
+    int (*process_main)(int argc, char *argv[]);
+    //Sends every process the key segment (key_segment.h) and returns once the summaries can be queried (the build
+    //phase, and the broadcast phase for structures that exchange their filters)
+    void (*build)(const ManagerFleet *fleet, KeySegment *keys);
+    //Update path, NULL if the processes have none: sends the keys each owner deletes or inserts as one segment with
+    //request id `id` and waits until every process applied them (and for Bloom, holds the rebuilt filters of all peers)
+    void (*update)(const ManagerFleet *fleet, TraceOp op, KeySegment *keys, uint32_t id);
+} ManagerBackend;
+
+//The Process_* files, built with PROCESS_IN_MANAGER
+int bloom_process_main(int argc, char *argv[]);
+int counting_bloom_process_main(int argc, char *argv[]);
+int cqf_process_main(int argc, char *argv[]);
+
+const ManagerBackend *manager_backend_find(const char *name);
+void manager_backend_list(FILE *fp);
+
+#endif
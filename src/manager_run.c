@@ -0,0 +1,81 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "manager_run.h"
+
+//Runs ./manager with argv, its output in log, and returns its exit status (-1 if it did not exit)
+//The rest of the environment (transport, load generator, KEYGEN_SEED, ...) is passed on
+int manager_run(char *const argv[], const char *csv, const char *json, const char *log){
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid < 0){
+        perror("[ERROR HAPPENED] : Could not fork the manager");
+        return -1;
+    }
+    if(pid == 0){
+        int fd = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd >= 0){
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        setenv("RESULTS_CSV", csv, 1);
+        setenv("RESULTS_FILE", json, 1);
+        execv("./manager", argv);
+        perror("[ERROR HAPPENED] : Could not start ./manager");
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int split_row(CsvRow *row){
+    int n = 0;
+    row->line[strcspn(row->line, "\r\n")] = '\0';
+    for(char *field = strtok(row->line, ","); field != NULL && n < CSV_MAX_COLUMNS; field = strtok(NULL, ",")){
+        row->fields[n++] = field;
+    }
+    row->num_fields = n;
+    return n;
+}
+
+//Reads the header and up to max_rows rows of a RESULTS_CSV table, returns the number of rows or -1
+int csv_read(const char *path, CsvRow *header, CsvRow *rows, int max_rows){
+    FILE *fp = fopen(path, "r");
+    if(fp == NULL){
+        fprintf(stderr, "[ERROR HAPPENED] : No run wrote %s\n", path);
+        return -1;
+    }
+    if(fgets(header->line, sizeof(header->line), fp) == NULL){
+        fprintf(stderr, "[ERROR HAPPENED] : %s is empty\n", path);
+        fclose(fp);
+        return -1;
+    }
+    split_row(header);
+    int num_rows = 0;
+    while(num_rows < max_rows && fgets(rows[num_rows].line, sizeof(rows[num_rows].line), fp) != NULL){
+        split_row(&rows[num_rows]);
+        num_rows++;
+    }
+    fclose(fp);
+    return num_rows;
+}
+
+//Index of the column called name, -1 if the table has none (an older manager)
+int csv_column(const CsvRow *header, const char *name){
+    for(int c = 0; c < header->num_fields; c++){
+        if(strcmp(header->fields[c], name) == 0){
+            return c;
+        }
+    }
+    return -1;
+}
+
+double csv_value(const CsvRow *row, int column){
+    return column >= 0 && column < row->num_fields ? atof(row->fields[column]) : 0.0;
+}
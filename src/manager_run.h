@@ -0,0 +1,23 @@
+#ifndef MANAGER_RUN_H
+
+#define MANAGER_RUN_H
+#include <stdio.h>
+
+//What the drivers (./compare, ./sweep) share: running one ./manager with its output in a log and its results in
+//a JSON record and a RESULTS_CSV table (results.h), and reading that table back
+
+#define CSV_MAX_COLUMNS 64
+#define CSV_LINE 4096
+
+typedef struct{
+    char line[CSV_LINE];
+    char *fields[CSV_MAX_COLUMNS];
+    int num_fields;
+} CsvRow;
+
+int manager_run(char *const argv[], const char *csv, const char *json, const char *log);
+int csv_read(const char *path, CsvRow *header, CsvRow *rows, int max_rows);
+int csv_column(const CsvRow *header, const char *name);
+double csv_value(const CsvRow *row, int column);
+
+#endif
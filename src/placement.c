@@ -0,0 +1,201 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "placement.h"
+
+typedef struct{
+    int cpu;
+    int package;
+    int core;
+    int thread;                 //hyperthread index within its core
+    int core_rank;              //index of its core within its package
+} CpuInfo;
+
+static const char *policy_names[] = {
+    [PLACEMENT_NONE] = "none",
+    [PLACEMENT_COMPACT] = "compact",
+    [PLACEMENT_SPREAD] = "spread",
+    [PLACEMENT_ISOLATED] = "isolated",
+};
+
+const char *placement_policy_name(PlacementPolicy policy){
+    return policy_names[policy];
+}
+
+static int read_topology(int cpu, const char *name){
+    char path[128];
+    int value = -1;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE *fp = fopen(path, "r");
+    if(fp != NULL){
+        if(fscanf(fp, "%d", &value) != 1){
+            value = -1;
+        }
+        fclose(fp);
+    }
+    return value;
+}
+
+//The CPUs the manager may run on, with their place in the topology
+static int load_cpus(CpuInfo *cpus){
+    cpu_set_t set;
+    if(sched_getaffinity(0, sizeof(set), &set) < 0){
+        perror("[ERROR HAPPENED] : Could not read the manager's CPUs");
+        return 0;
+    }
+    int n = 0;
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+        if(!CPU_ISSET(cpu, &set)){
+            continue;
+        }
+        CpuInfo *info = &cpus[n++];
+        info->cpu = cpu;
+        info->package = read_topology(cpu, "physical_package_id");
+        info->core = read_topology(cpu, "core_id");
+        if(info->package < 0){
+            info->package = 0;
+        }
+        if(info->core < 0){
+            //A core of its own, clear of the ids the kernel hands out
+            info->core = CPU_SETSIZE + cpu;
+        }
+    }
+    for(int i = 0; i < n; i++){
+        cpus[i].thread = 0;
+        for(int j = 0; j < i; j++){
+            cpus[i].thread += cpus[j].package == cpus[i].package && cpus[j].core == cpus[i].core;
+        }
+    }
+    //Every lower core of the package counted once, through its first hyperthread
+    for(int i = 0; i < n; i++){
+        cpus[i].core_rank = 0;
+        for(int j = 0; j < n; j++){
+            cpus[i].core_rank += cpus[j].package == cpus[i].package && cpus[j].core < cpus[i].core && cpus[j].thread == 0;
+        }
+    }
+    return n;
+}
+
+static int compare_compact(const void *a, const void *b){
+    const CpuInfo *x = a, *y = b;
+    if(x->package != y->package) return x->package - y->package;
+    if(x->core != y->core) return x->core - y->core;
+    return x->thread - y->thread;
+}
+
+static int compare_spread(const void *a, const void *b){
+    const CpuInfo *x = a, *y = b;
+    if(x->thread != y->thread) return x->thread - y->thread;
+    if(x->core_rank != y->core_rank) return x->core_rank - y->core_rank;
+    return x->package - y->package;
+}
+
+//Reads PLACEMENT and works out the CPU of the manager and of every process
+void placement_init(Placement *placement, int num_processes){
+    static CpuInfo cpus[CPU_SETSIZE];
+    memset(placement, 0, sizeof(*placement));
+    placement->num_processes = num_processes;
+    placement->manager_cpu = -1;
+    for(int p = 0; p < MAX_PROCESSES; p++){
+        placement->process_cpus[p] = -1;
+    }
+    const char *policy = getenv("PLACEMENT");
+    if(policy != NULL){
+        for(int i = 0; i < (int)(sizeof(policy_names) / sizeof(policy_names[0])); i++){
+            if(strcmp(policy, policy_names[i]) == 0){
+                placement->policy = (PlacementPolicy)i;
+                break;
+            }
+        }
+        if(strcmp(policy, policy_names[placement->policy]) != 0){
+            fprintf(stderr, "[ERROR HAPPENED] : unknown PLACEMENT %s, the processes are not pinned\n", policy);
+        }
+    }
+    int n = load_cpus(cpus);
+    placement->num_cpus = n;
+    if(placement->policy == PLACEMENT_NONE || n == 0){
+        placement->policy = PLACEMENT_NONE;
+        return;
+    }
+
+    qsort(cpus, n, sizeof(CpuInfo), placement->policy == PLACEMENT_SPREAD ? compare_spread : compare_compact);
+    placement->manager_cpu = cpus[0].cpu;
+    const CpuInfo *process_cpus = cpus + 1;
+    int num_process_cpus = n - 1;
+    if(placement->policy == PLACEMENT_ISOLATED){
+        //Past the manager's core in compact order, then spread over what is left
+        int first = 1;
+        while(first < n && cpus[first].package == cpus[0].package && cpus[first].core == cpus[0].core){
+            first++;
+        }
+        if(first < n){
+            qsort(cpus + first, n - first, sizeof(CpuInfo), compare_spread);
+            process_cpus = cpus + first;
+            num_process_cpus = n - first;
+        } else{
+            fprintf(stderr, "[ERROR HAPPENED] : Only one core, the processes share it with the manager\n");
+        }
+    }
+    if(num_process_cpus <= 0){
+        process_cpus = cpus;
+        num_process_cpus = n;
+    }
+    for(int p = 0; p < num_processes && p < MAX_PROCESSES; p++){
+        placement->process_cpus[p] = process_cpus[p % num_process_cpus].cpu;
+    }
+}
+
+//Pins the calling process to cpu, nothing for -1
+int placement_pin(int cpu){
+    if(cpu < 0){
+        return 0;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if(sched_setaffinity(0, sizeof(set), &set) < 0){
+        fprintf(stderr, "[ERROR HAPPENED] : Could not pin to CPU %d\n", cpu);
+        return -1;
+    }
+    return 0;
+}
+
+static int num_shared(const Placement *placement){
+    int shared = 0;
+    for(int p = 0; p < placement->num_processes; p++){
+        for(int q = 0; q < p; q++){
+            if(placement->process_cpus[q] == placement->process_cpus[p]){
+                shared++;
+                break;
+            }
+        }
+    }
+    return shared;
+}
+
+void placement_print(FILE *fp, const Placement *placement){
+    if(placement->policy == PLACEMENT_NONE){
+        fprintf(fp, "Placement: none (%d CPUs, not pinned)\n", placement->num_cpus);
+        return;
+    }
+    fprintf(fp, "Placement: %s over %d CPUs, manager on CPU %d, processes on CPUs", placement_policy_name(placement->policy),
+            placement->num_cpus, placement->manager_cpu);
+    for(int p = 0; p < placement->num_processes; p++){
+        fprintf(fp, "%s%d", p > 0 ? "," : " ", placement->process_cpus[p]);
+    }
+    if(num_shared(placement) > 0){
+        fprintf(fp, " (%d processes share a CPU with an earlier one)", num_shared(placement));
+    }
+    fprintf(fp, "\n");
+}
+
+void placement_print_json(FILE *fp, const Placement *placement){
+    fprintf(fp, "{\"policy\": \"%s\", \"cpus\": %d, \"manager_cpu\": %d, \"process_cpus\": [",
+            placement_policy_name(placement->policy), placement->num_cpus, placement->manager_cpu);
+    for(int p = 0; p < placement->num_processes; p++){
+        fprintf(fp, "%s%d", p > 0 ? ", " : "", placement->process_cpus[p]);
+    }
+    fprintf(fp, "]}");
+}
@@ -0,0 +1,41 @@
+#ifndef PLACEMENT_H
+
+#define PLACEMENT_H
+#include <stdio.h>
+#include "IPC.h"
+
+//CPU placement of the manager and the processes, selected with PLACEMENT and applied with sched_setaffinity:
+//none (default): no pinning, the scheduler places and migrates everything as before
+//compact: the manager and then process 0, 1, ... each on one CPU, filling the hyperthreads of a core before the next
+//core (and a package before the next), so the fleet shares as few cores and caches as possible
+//spread: the same, but one hyperthread of every physical core first, round robin over the packages, the second
+//hyperthreads only once every core has a process
+//isolated: the manager alone on the first core (its hyperthread siblings stay idle), the processes spread over the rest
+//Only the CPUs the manager was started on count (taskset, cgroups); with more processes than CPUs they wrap around.
+//The topology comes from /sys/devices/system/cpu/cpu<n>/topology, a CPU without it counts as a core of its own
+//Each process pins itself between fork and exec (a process thread when it starts, IPC_TRANSPORT=thread); the manager
+//pins itself once the keys are generated, so key generation still uses every CPU. Load generator clients inherit the
+//manager's CPU. The policy and the CPUs go into the results record (results.h)
+
+typedef enum{
+    PLACEMENT_NONE = 0,
+    PLACEMENT_COMPACT,
+    PLACEMENT_SPREAD,
+    PLACEMENT_ISOLATED
+} PlacementPolicy;
+
+typedef struct{
+    PlacementPolicy policy;
+    int num_cpus;                       //that the manager may run on
+    int manager_cpu;                    //-1 when not pinned
+    int num_processes;
+    int process_cpus[MAX_PROCESSES];    //-1 when not pinned
+} Placement;
+
+void placement_init(Placement *placement, int num_processes);
+const char *placement_policy_name(PlacementPolicy policy);
+int placement_pin(int cpu);
+void placement_print(FILE *fp, const Placement *placement);
+void placement_print_json(FILE *fp, const Placement *placement);
+
+#endif
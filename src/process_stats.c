@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include "IPC.h"
+#include "process_stats.h"
+
+//The fields in file order; one table for the writer and the reader keeps both sides in step
+typedef struct{
+    const char *name;
+    size_t offset;
+    int is_double;
+} StatsField;
+
+static const StatsField fields[] = {
+    {"summary_bytes", offsetof(ProcessStats, summary_bytes), 0},
+    {"num_keys", offsetof(ProcessStats, num_keys), 0},
+    {"own_lookups", offsetof(ProcessStats, own_lookups), 0},
+    {"own_lookup_ms", offsetof(ProcessStats, own_lookup_ms), 1},
+    {"query_rounds", offsetof(ProcessStats, query_rounds), 0},
+    {"summary_checks", offsetof(ProcessStats, summary_checks), 0},
+    {"summary_check_ms", offsetof(ProcessStats, summary_check_ms), 1},
+    {"updates", offsetof(ProcessStats, updates), 0},
+    {"update_ms", offsetof(ProcessStats, update_ms), 1},
+    {"frames_sent", offsetof(ProcessStats, frames_sent), 0},
+    {"frames_received", offsetof(ProcessStats, frames_received), 0},
+    {"syscalls", offsetof(ProcessStats, syscalls), 0},
+};
+
+#define NUM_FIELDS (sizeof(fields) / sizeof(fields[0]))
+
+//Fills in the transport counters and writes the file, called from the signal handlers
+void process_stats_write(int process_id, const char *structure, ProcessStats *stats){
+    IPCStats ipc;
+    ipc_get_stats(&ipc);
+    stats->frames_sent = ipc.frames_sent;
+    stats->frames_received = ipc.frames_received;
+    stats->syscalls = ipc.syscalls;
+
+    char path[256];
+    snprintf(path, sizeof(path), PROCESS_STATS_PATH, process_id);
+    FILE *fp = fopen(path, "w");
+    if(fp == NULL){
+        return;
+    }
+    fprintf(fp, "{\"process\": %d, \"structure\": \"%s\", \"transport\": \"%s\", ", process_id, structure, ipc.transport);
+    process_stats_print_json(fp, stats);
+    fprintf(fp, "}\n");
+    fclose(fp);
+}
+
+//The numeric fields as "name": value pairs, without the braces, so the manager can add them to its own objects
+void process_stats_print_json(FILE *fp, const ProcessStats *stats){
+    for(size_t i = 0; i < NUM_FIELDS; i++){
+        const char *field = (const char *)stats + fields[i].offset;
+        if(fields[i].is_double){
+            fprintf(fp, "%s\"%s\": %.6f", i > 0 ? ", " : "", fields[i].name, *(const double *)field);
+        } else{
+            fprintf(fp, "%s\"%s\": %llu", i > 0 ? ", " : "", fields[i].name, (unsigned long long)*(const uint64_t *)field);
+        }
+    }
+}
+
+//Reads back what process_stats_write wrote, returns -1 if the process left no file
+int process_stats_read(int process_id, ProcessStats *stats){
+    char path[256];
+    char buf[4096];
+    memset(stats, 0, sizeof(*stats));
+    snprintf(path, sizeof(path), PROCESS_STATS_PATH, process_id);
+    FILE *fp = fopen(path, "r");
+    if(fp == NULL){
+        return -1;
+    }
+    size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[len] = '\0';
+    for(size_t i = 0; i < NUM_FIELDS; i++){
+        char key[64];
+        snprintf(key, sizeof(key), "\"%s\":", fields[i].name);
+        const char *at = strstr(buf, key);
+        if(at == NULL){
+            continue;
+        }
+        char *field = (char *)stats + fields[i].offset;
+        if(fields[i].is_double){
+            *(double *)field = strtod(at + strlen(key), NULL);
+        } else{
+            *(uint64_t *)field = strtoull(at + strlen(key), NULL, 10);
+        }
+    }
+    return 0;
+}
+
+void process_stats_remove(int num_processes){
+    char path[256];
+    for(int p = 0; p < num_processes; p++){
+        snprintf(path, sizeof(path), PROCESS_STATS_PATH, p);
+        unlink(path);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef PROCESS_STATS_H
+
+#define PROCESS_STATS_H
+#include <stdio.h>
+#include <stdint.h>
+
+//Machine-readable stats of a process: next to its text stats file every process writes PROCESS_STATS_PATH as one
+//flat JSON object when it is terminated, and the manager reads them back into its results record (results.h)
+//The manager removes the files of the last run before it starts the processes, so a process that died leaves no stale one
+
+#define PROCESS_STATS_PATH "/tmp/process_%d_stats.json"
+
+typedef struct{
+    uint64_t summary_bytes;             //the process's own Bloom filter / counting Bloom filter / CQF
+    uint64_t num_keys;
+    uint64_t own_lookups;
+    double own_lookup_ms;
+    uint64_t query_rounds;              //queries that went to the summaries
+    uint64_t summary_checks;            //single peer filter (or CQF) lookups
+    double summary_check_ms;
+    uint64_t updates;
+    double update_ms;
+    uint64_t frames_sent;
+    uint64_t frames_received;
+    uint64_t syscalls;
+} ProcessStats;
+
+void process_stats_write(int process_id, const char *structure, ProcessStats *stats);
+void process_stats_print_json(FILE *fp, const ProcessStats *stats);
+int process_stats_read(int process_id, ProcessStats *stats);
+void process_stats_remove(int num_processes);
+
+#endif
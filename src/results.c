@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "IPC.h"
+#include "barrier.h"
+#include "histogram.h"
+#include "process_stats.h"
+#include "results.h"
+
+typedef struct{
+    const char *phase;
+    uint64_t sent;
+    uint64_t found;
+    uint64_t not_found;
+    uint64_t timed_out;
+    double duration_ms;
+    Histogram latency;
+    int has_windows;            //churn: latency split by whether an update round was in progress
+    Histogram latency_rebuild;
+    Histogram latency_steady;
+} QueryPhaseResult;
+
+static QueryPhaseResult query_phases[RESULTS_MAX_QUERY_PHASES];
+static int num_query_phases = 0;
+
+//Called at the end of every query phase with what the manager printed for it
+void results_query_phase(const char *phase, uint64_t sent, uint64_t found, uint64_t not_found, uint64_t timed_out,
+                         double duration_ms, const Histogram *latency){
+    if(num_query_phases >= RESULTS_MAX_QUERY_PHASES){
+        return;
+    }
+    QueryPhaseResult *result = &query_phases[num_query_phases++];
+    result->phase = phase;
+    result->sent = sent;
+    result->found = found;
+    result->not_found = not_found;
+    result->timed_out = timed_out;
+    result->duration_ms = duration_ms;
+    histogram_init(&result->latency);
+    histogram_merge(&result->latency, latency);
+    result->has_windows = 0;
+}
+
+//Attaches the latency windows of a churn phase to the query phase recorded last
+void results_query_windows(const Histogram *rebuild, const Histogram *steady){
+    if(num_query_phases == 0){
+        return;
+    }
+    QueryPhaseResult *result = &query_phases[num_query_phases - 1];
+    result->has_windows = 1;
+    histogram_init(&result->latency_rebuild);
+    histogram_merge(&result->latency_rebuild, rebuild);
+    histogram_init(&result->latency_steady);
+    histogram_merge(&result->latency_steady, steady);
+}
+
+static void print_string(FILE *fp, const char *s){
+    fputc('"', fp);
+    for(; s != NULL && *s != '\0'; s++){
+        if(*s == '"' || *s == '\\'){
+            fputc('\\', fp);
+        }
+        fputc(*s >= ' ' ? *s : ' ', fp);
+    }
+    fputc('"', fp);
+}
+
+static double ns_to_ms(uint64_t ns){
+    return ns / 1000000.0;
+}
+
+static void print_latency_json(FILE *fp, const Histogram *h){
+    fprintf(fp, "\"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p90_ms\": %.4f, \"p99_ms\": %.4f, \"p999_ms\": %.4f, \"max_ms\": %.4f",
+            histogram_mean(h) / 1000000.0, ns_to_ms(histogram_percentile(h, 50.0)), ns_to_ms(histogram_percentile(h, 90.0)),
+            ns_to_ms(histogram_percentile(h, 99.0)), ns_to_ms(histogram_percentile(h, 99.9)), ns_to_ms(h->max));
+}
+
+static double answered_qps(uint64_t answered, double duration_ms){
+    return duration_ms > 0 ? answered * 1000.0 / duration_ms : 0.0;
+}
+
+static void write_json(const char *path, const ResultsConfig *config, const IPCStats *ipc, const ProcessStats *processes,
+                       const int *has_stats){
+    FILE *fp = fopen(path, "w");
+    if(fp == NULL){
+        perror("[ERROR HAPPENED] : Could not write the results");
+        return;
+    }
+    fprintf(fp, "{\n  \"structure\": ");
+    print_string(fp, config->structure);
+    fprintf(fp, ", \"processes\": %d, \"keys_per_process\": %d, \"scenario\": ", config->num_processes, config->keys_per_process);
+    print_string(fp, config->scenario);
+    fprintf(fp, ", \"seed\": %llu, \"transport\": ", (unsigned long long)config->seed);
+    print_string(fp, ipc->transport);
+    fprintf(fp, ", \"loadgen\": ");
+    print_string(fp, config->loadgen_mode);
+    fprintf(fp, ", \"clients\": %d, \"placement\": ", config->clients);
+    placement_print_json(fp, config->placement);
+    fprintf(fp, ",\n");
+
+    const PhaseTiming *phases;
+    int num_phases = phase_timings(&phases);
+    fprintf(fp, "  \"phases\": [");
+    for(int i = 0; i < num_phases; i++){
+        fprintf(fp, "%s\n    {\"name\": ", i > 0 ? "," : "");
+        print_string(fp, phases[i].name);
+        fprintf(fp, ", \"ms\": %.3f, \"acked\": %d, \"expected\": %d}", phases[i].elapsed_ms, phases[i].acked, phases[i].expected);
+    }
+    fprintf(fp, "\n  ],\n  \"queries\": [");
+    for(int i = 0; i < num_query_phases; i++){
+        const QueryPhaseResult *q = &query_phases[i];
+        fprintf(fp, "%s\n    {\"phase\": ", i > 0 ? "," : "");
+        print_string(fp, q->phase);
+        fprintf(fp, ", \"sent\": %llu, \"found\": %llu, \"not_found\": %llu, \"timed_out\": %llu, \"duration_ms\": %.3f, \"qps\": %.1f, ",
+                (unsigned long long)q->sent, (unsigned long long)q->found, (unsigned long long)q->not_found,
+                (unsigned long long)q->timed_out, q->duration_ms, answered_qps(q->found + q->not_found, q->duration_ms));
+        print_latency_json(fp, &q->latency);
+        if(q->has_windows){
+            fprintf(fp, ", \"rebuild\": {\"queries\": %llu, ", (unsigned long long)q->latency_rebuild.total);
+            print_latency_json(fp, &q->latency_rebuild);
+            fprintf(fp, "}, \"steady\": {\"queries\": %llu, ", (unsigned long long)q->latency_steady.total);
+            print_latency_json(fp, &q->latency_steady);
+            fprintf(fp, "}");
+        }
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n  ],\n  \"messages\": {\"frames_sent\": %llu, \"frames_received\": %llu, \"syscalls\": %llu},\n",
+            (unsigned long long)ipc->frames_sent, (unsigned long long)ipc->frames_received, (unsigned long long)ipc->syscalls);
+    fprintf(fp, "  \"process_stats\": [");
+    for(int p = 0; p < config->num_processes; p++){
+        fprintf(fp, "%s\n    ", p > 0 ? "," : "");
+        if(has_stats[p]){
+            fprintf(fp, "{\"process\": %d, ", p);
+            process_stats_print_json(fp, &processes[p]);
+            fprintf(fp, "}");
+        } else{
+            fprintf(fp, "null");
+        }
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    fclose(fp);
+    printf("Results written to %s\n", path);
+}
+
+static double phase_ms(const PhaseTiming *phases, int num_phases, const char *a, const char *b, const char *c){
+    double total = 0;
+    for(int i = 0; i < num_phases; i++){
+        const char *name = phases[i].name;
+        if(strcmp(name, a) == 0 || (b != NULL && strcmp(name, b) == 0) || (c != NULL && strcmp(name, c) == 0)){
+            total += phases[i].elapsed_ms;
+        }
+    }
+    return total;
+}
+
+//The headline numbers: the query phases and the processes are summed up, latencies are over all query phases
+static void append_csv(const char *path, const ResultsConfig *config, const IPCStats *ipc, const ProcessStats *processes){
+    int is_new = access(path, F_OK) != 0;
+    FILE *fp = fopen(path, "a");
+    if(fp == NULL){
+        perror("[ERROR HAPPENED] : Could not append to the results table");
+        return;
+    }
+    if(is_new){
+        fprintf(fp, "structure,processes,keys_per_process,transport,loadgen,clients,placement,cpus,scenario,seed,build_ms,broadcast_ms,"
+                    "update_ms,query_ms,queries,answered,timed_out,qps,mean_ms,p50_ms,p99_ms,p999_ms,max_ms,"
+                    "manager_frames,process_frames,summary_bytes,own_lookups,own_lookup_us,summary_checks,summary_check_us,"
+                    "p99_rebuild_ms,p99_steady_ms\n");
+    }
+    const PhaseTiming *phases;
+    int num_phases = phase_timings(&phases);
+    static Histogram latency, rebuild, steady;
+    histogram_init(&latency);
+    histogram_init(&rebuild);
+    histogram_init(&steady);
+    uint64_t sent = 0, answered = 0, timed_out = 0;
+    double duration_ms = 0;
+    for(int i = 0; i < num_query_phases; i++){
+        sent += query_phases[i].sent;
+        answered += query_phases[i].found + query_phases[i].not_found;
+        timed_out += query_phases[i].timed_out;
+        duration_ms += query_phases[i].duration_ms;
+        histogram_merge(&latency, &query_phases[i].latency);
+        if(query_phases[i].has_windows){
+            histogram_merge(&rebuild, &query_phases[i].latency_rebuild);
+            histogram_merge(&steady, &query_phases[i].latency_steady);
+        }
+    }
+    ProcessStats total;
+    memset(&total, 0, sizeof(total));
+    for(int p = 0; p < config->num_processes; p++){
+        total.summary_bytes += processes[p].summary_bytes;
+        total.own_lookups += processes[p].own_lookups;
+        total.own_lookup_ms += processes[p].own_lookup_ms;
+        total.summary_checks += processes[p].summary_checks;
+        total.summary_check_ms += processes[p].summary_check_ms;
+        total.frames_sent += processes[p].frames_sent;
+    }
+
+    fprintf(fp, "%s,%d,%d,%s,%s,%d,%s,%d,", config->structure, config->num_processes, config->keys_per_process, ipc->transport,
+            config->loadgen_mode, config->clients, placement_policy_name(config->placement->policy), config->placement->num_cpus);
+    //A path with a comma would shift the columns
+    for(const char *s = config->scenario; s != NULL && *s != '\0'; s++){
+        fputc(*s == ',' ? ';' : *s, fp);
+    }
+    fprintf(fp, ",%llu,%.1f,%.1f,%.1f,%.1f,", (unsigned long long)config->seed, phase_ms(phases, num_phases, "build", NULL, NULL),
+            phase_ms(phases, num_phases, "broadcast", NULL, NULL), phase_ms(phases, num_phases, "deletes", "inserts", NULL),
+            phase_ms(phases, num_phases, "queries", "specific", "trace") + phase_ms(phases, num_phases, "churn", NULL, NULL));
+    fprintf(fp, "%llu,%llu,%llu,%.1f,%.4f,%.4f,%.4f,%.4f,%.4f,", (unsigned long long)sent, (unsigned long long)answered,
+            (unsigned long long)timed_out, answered_qps(answered, duration_ms), histogram_mean(&latency) / 1000000.0,
+            ns_to_ms(histogram_percentile(&latency, 50.0)), ns_to_ms(histogram_percentile(&latency, 99.0)),
+            ns_to_ms(histogram_percentile(&latency, 99.9)), ns_to_ms(latency.max));
+    fprintf(fp, "%llu,%llu,%llu,%llu,%.3f,%llu,%.3f,",  (unsigned long long)(ipc->frames_sent + ipc->frames_received),
+            (unsigned long long)total.frames_sent, (unsigned long long)total.summary_bytes, (unsigned long long)total.own_lookups,
+            total.own_lookups > 0 ? total.own_lookup_ms * 1000.0 / total.own_lookups : 0.0,
+            (unsigned long long)total.summary_checks,
+            total.summary_checks > 0 ? total.summary_check_ms * 1000.0 / total.summary_checks : 0.0);
+    fprintf(fp, "%.4f,%.4f\n", ns_to_ms(histogram_percentile(&rebuild, 99.0)), ns_to_ms(histogram_percentile(&steady, 99.0)));
+    fclose(fp);
+}
+
+//Called once the processes are gone and have written their stats
+void results_write(const ResultsConfig *config){
+    static ProcessStats processes[MAX_PROCESSES];
+    int has_stats[MAX_PROCESSES];
+    for(int p = 0; p < config->num_processes; p++){
+        has_stats[p] = process_stats_read(p, &processes[p]) == 0;
+    }
+    IPCStats ipc;
+    ipc_get_stats(&ipc);
+
+    const char *path = getenv("RESULTS_FILE");
+    write_json(path != NULL && path[0] != '\0' ? path : RESULTS_DEFAULT_FILE, config, &ipc, processes, has_stats);
+    const char *csv = getenv("RESULTS_CSV");
+    if(csv != NULL && csv[0] != '\0'){
+        append_csv(csv, config, &ipc, processes);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef RESULTS_H
+
+#define RESULTS_H
+#include <stdio.h>
+#include <stdint.h>
+#include "histogram.h"
+#include "placement.h"
+
+//Results record of a manager run: RESULTS_FILE (default /tmp/manager_results.json) gets one JSON object with the
+//configuration (with the CPU placement of placement.h), the phase timings of barrier.h, every query phase (counts,
+//throughput, latency percentiles), the manager's message counts and the stats every process wrote when it was
+//terminated (process_stats.h)
+//With RESULTS_CSV set, one row of headline numbers is appended to that file as well (the header goes in when the file
+//is new), so runs of different structures and builds line up in one table; ./compare runs a scenario against every
+//structure that way and prints the table
+//A churn phase also reports the latencies of the queries that overlapped an update round and of the rest (p99 of
+//both in the CSV)
+
+#define RESULTS_DEFAULT_FILE "/tmp/manager_results.json"
+#define RESULTS_MAX_QUERY_PHASES 32
+
+typedef struct{
+    const char *structure;
+    int num_processes;
+    int keys_per_process;
+    const char *scenario;
+    uint64_t seed;
+    const char *loadgen_mode;
+    int clients;
+    const Placement *placement;
+} ResultsConfig;
+
+void results_query_phase(const char *phase, uint64_t sent, uint64_t found, uint64_t not_found, uint64_t timed_out,
+                         double duration_ms, const Histogram *latency);
+void results_query_windows(const Histogram *rebuild, const Histogram *steady);
+void results_write(const ResultsConfig *config);
+
+#endif
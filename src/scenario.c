@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scenario.h"
+
+#define SCENARIO_DEFAULT_LOCAL 30
+#define SCENARIO_DEFAULT_REMOTE 40
+#define SCENARIO_DEFAULT_MISS 30
+
+static const char *phase_names[] = {
+    [SCENARIO_QUERIES] = "queries",
+    [SCENARIO_SPECIFIC] = "specific",
+    [SCENARIO_TRACE] = "trace",
+    [SCENARIO_DELETES] = "deletes",
+    [SCENARIO_INSERTS] = "inserts",
+    [SCENARIO_CHURN] = "churn",
+};
+
+const char *scenario_phase_name(ScenarioPhaseType type){
+    return phase_names[type];
+}
+
+static ScenarioPhase *add_phase(Scenario *scenario, ScenarioPhaseType type, int count, const int *mix){
+    if(scenario->num_phases >= SCENARIO_MAX_PHASES){
+        return NULL;
+    }
+    ScenarioPhase *phase = &scenario->phases[scenario->num_phases++];
+    memset(phase, 0, sizeof(*phase));
+    phase->type = type;
+    phase->count = count;
+    phase->pct_local = mix[0];
+    phase->pct_remote = mix[1];
+    phase->pct_miss = mix[2];
+    return phase;
+}
+
+//What the managers ran before there were scenarios (the counting Bloom manager skips the updates)
+void scenario_default(Scenario *scenario){
+    int mix[3] = {SCENARIO_DEFAULT_LOCAL, SCENARIO_DEFAULT_REMOTE, SCENARIO_DEFAULT_MISS};
+    memset(scenario, 0, sizeof(*scenario));
+    scenario->name = "default";
+    add_phase(scenario, SCENARIO_QUERIES, 100000, mix);
+    add_phase(scenario, SCENARIO_DELETES, 20000, mix);
+    add_phase(scenario, SCENARIO_INSERTS, 20000, mix);
+}
+
+//Reads the scenario file (see scenario.h), returns -1 and names the line if it can't be used
+int scenario_load(Scenario *scenario, const char *path){
+    int mix[3] = {SCENARIO_DEFAULT_LOCAL, SCENARIO_DEFAULT_REMOTE, SCENARIO_DEFAULT_MISS};
+    memset(scenario, 0, sizeof(*scenario));
+    scenario->name = path;
+    FILE *fp = fopen(path, "r");
+    if(fp == NULL){
+        perror("[ERROR HAPPENED] : Could not open the scenario");
+        return -1;
+    }
+
+    char line[512];
+    int line_number = 0;
+    while(fgets(line, sizeof(line), fp) != NULL){
+        line_number++;
+        char *comment = strchr(line, '#');
+        if(comment != NULL){
+            *comment = '\0';
+        }
+        char word[32];
+        char arg[SCENARIO_MAX_PATH];
+        int consumed;
+        if(sscanf(line, "%31s%n", word, &consumed) != 1){
+            continue;
+        }
+        const char *rest = line + consumed;
+        int ok = 0;
+        if(strcmp(word, "mix") == 0){
+            int local, remote, miss;
+            if(sscanf(rest, "%d %d %d", &local, &remote, &miss) == 3 && local >= 0 && remote >= 0 && miss >= 0
+               && local + remote + miss == 100){
+                mix[0] = local;
+                mix[1] = remote;
+                mix[2] = miss;
+                ok = 1;
+            }
+        } else if(strcmp(word, "trace") == 0){
+            ScenarioPhase *phase;
+            if(sscanf(rest, "%255s", arg) == 1 && (phase = add_phase(scenario, SCENARIO_TRACE, 0, mix)) != NULL){
+                strcpy(phase->path, arg);
+                ok = 1;
+            }
+        } else if(strcmp(word, "churn") == 0){
+            int count, rate;
+            ScenarioPhase *phase;
+            if(sscanf(rest, "%d %d", &count, &rate) == 2 && count > 0 && rate >= 0
+               && (phase = add_phase(scenario, SCENARIO_CHURN, count, mix)) != NULL){
+                phase->update_rate = rate;
+                ok = 1;
+            }
+        } else{
+            for(int t = 0; t < (int)(sizeof(phase_names) / sizeof(phase_names[0])); t++){
+                int count;
+                if(t != SCENARIO_TRACE && t != SCENARIO_CHURN && strcmp(word, phase_names[t]) == 0 && sscanf(rest, "%d", &count) == 1 && count > 0){
+                    ok = add_phase(scenario, (ScenarioPhaseType)t, count, mix) != NULL;
+                }
+            }
+        }
+        if(!ok){
+            fprintf(stderr, "[ERROR HAPPENED] : %s:%d: can't use \"%s\" (see scenario.h, at most %d phases, the mix adds up to 100)\n",
+                    path, line_number, word, SCENARIO_MAX_PHASES);
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+    if(scenario->num_phases == 0){
+        fprintf(stderr, "[ERROR HAPPENED] : Scenario %s has no phases\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+void scenario_print(FILE *fp, const Scenario *scenario){
+    fprintf(fp, "Scenario %s:", scenario->name);
+    for(int i = 0; i < scenario->num_phases; i++){
+        const ScenarioPhase *phase = &scenario->phases[i];
+        switch(phase->type){
+            case SCENARIO_TRACE:
+                fprintf(fp, " trace %s", phase->path);
+                break;
+            case SCENARIO_QUERIES:
+                fprintf(fp, " queries %d (%d/%d/%d)", phase->count, phase->pct_local, phase->pct_remote, phase->pct_miss);
+                break;
+            case SCENARIO_CHURN:
+                fprintf(fp, " churn %d (%d/%d/%d) at %d keys/s", phase->count, phase->pct_local, phase->pct_remote,
+                        phase->pct_miss, phase->update_rate);
+                break;
+            default:
+                fprintf(fp, " %s %d", phase_names[phase->type], phase->count);
+        }
+        fprintf(fp, i + 1 < scenario->num_phases ? "," : "\n");
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef SCENARIO_H
+
+#define SCENARIO_H
+#include <stdio.h>
+
+//What the manager runs once the keys are built, read from the scenario file given after its arguments
+//One phase per line, run in order; empty lines and anything after # are ignored:
+//  mix <local %> <remote %> <miss %>   query mix of the query phases that follow (default 30 40 30)
+//  queries <n>                         n queries of the mix, with the load generator of loadgen.h (TRACE_FILE replays
+//                                      that trace instead, as before)
+//  specific <n>                        n queries of existing keys, never sent to the process that holds the key
+//  trace <file>                        replays a binary trace (trace.h)
+//  deletes <n>                         every process deletes n of its keys
+//  inserts <n>                         every process gets n new keys
+//  churn <n> <keys per second>         n queries of the mix while keys are deleted and inserted at that rate across
+//                                      all processes (0: one update round after the other), see run_churn in Manager.c
+//Without a file the manager runs the default scenario: queries 100000, deletes 20000, inserts 20000
+
+#define SCENARIO_MAX_PHASES 32
+#define SCENARIO_MAX_PATH 256
+
+//Keys per process each churn round deletes and inserts, CHURN_BATCH overrides it
+#define CHURN_DEFAULT_BATCH 1000
+
+typedef enum{
+    SCENARIO_QUERIES = 0,
+    SCENARIO_SPECIFIC,
+    SCENARIO_TRACE,
+    SCENARIO_DELETES,
+    SCENARIO_INSERTS,
+    SCENARIO_CHURN
+} ScenarioPhaseType;
+
+typedef struct{
+    ScenarioPhaseType type;
+    int count;                  //queries, or updates per process
+    int update_rate;            //churn: keys deleted and inserted per second
+    int pct_local;              //the mix in effect for a query phase
+    int pct_remote;
+    int pct_miss;
+    char path[SCENARIO_MAX_PATH];
+} ScenarioPhase;
+
+typedef struct{
+    const char *name;           //the file, "default" without one
+    int num_phases;
+    ScenarioPhase phases[SCENARIO_MAX_PHASES];
+} Scenario;
+
+void scenario_default(Scenario *scenario);
+int scenario_load(Scenario *scenario, const char *path);
+const char *scenario_phase_name(ScenarioPhaseType type);
+void scenario_print(FILE *fp, const Scenario *scenario);
+
+#endif
@@ -0,0 +1,245 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "manager_run.h"
+
+//Runs a scenario over a grid of process counts and keys per process for several structures, one ./manager per point,
+//and prints how the costs scale: one table per structure and metric with a row per process count and a column per
+//key count, where every step along either axis that grows faster than linear is marked
+//Usage: ./sweep <process counts> <keys per process> [scenario file], e.g. ./sweep 2,4,8,16 100000,1000000
+//SWEEP_STRUCTURES picks the structures (default "bloom,counting_bloom,cqf"), SWEEP_CSV gets the RESULTS_CSV rows of
+//all points (default /tmp/sweep_results.csv, started over on every run) and SWEEP_CURVES every step with its
+//exponent (default /tmp/sweep_curves.csv). Every point writes /tmp/sweep_<structure>_<processes>_<keys>.json and .log;
+//the rest of the environment is passed on as with ./compare
+//The exponent of a step from x1 to x2 is log(v2 / v1) / log(x2 / x1). Totals (build, broadcast, update time) and
+//latencies are superlinear above 1, costs per key or per lookup above 0 (their total grows faster than the keys or
+//lookups); SWEEP_TOLERANCE (default 0.15) is added to both so noise between runs does not mark a step
+
+#define SWEEP_DEFAULT_STRUCTURES "bloom,counting_bloom,cqf"
+#define SWEEP_DEFAULT_CSV "/tmp/sweep_results.csv"
+#define SWEEP_DEFAULT_CURVES "/tmp/sweep_curves.csv"
+#define SWEEP_DEFAULT_TOLERANCE 0.15
+#define SWEEP_MAX_STRUCTURES 8
+#define SWEEP_MAX_VALUES 16
+#define SWEEP_MAX_RUNS (SWEEP_MAX_STRUCTURES * SWEEP_MAX_VALUES * SWEEP_MAX_VALUES)
+
+typedef enum{
+    METRIC_TOTAL = 0,           //linear growth is expected
+    METRIC_PER_UNIT             //flat is expected
+} MetricKind;
+
+typedef struct{
+    const char *name;
+    const char *column;         //of the RESULTS_CSV row, NULL for bytes_per_key
+    MetricKind kind;
+} SweepMetric;
+
+static const SweepMetric metrics[] = {
+    {"build_ms", "build_ms", METRIC_TOTAL},
+    {"broadcast_ms", "broadcast_ms", METRIC_TOTAL},
+    {"update_ms", "update_ms", METRIC_TOTAL},
+    {"bytes_per_key", NULL, METRIC_PER_UNIT},
+    {"own_lookup_us", "own_lookup_us", METRIC_PER_UNIT},
+    {"summary_check_us", "summary_check_us", METRIC_PER_UNIT},
+    {"p50_ms", "p50_ms", METRIC_TOTAL},
+    {"p99_ms", "p99_ms", METRIC_TOTAL},
+    {"p999_ms", "p999_ms", METRIC_TOTAL},
+};
+
+#define NUM_METRICS (int)(sizeof(metrics) / sizeof(metrics[0]))
+
+typedef struct{
+    int has_value;
+    double values[NUM_METRICS];
+} SweepPoint;
+
+static int parse_list(const char *arg, int *values, const char *what){
+    char buf[1024];
+    int n = 0;
+    snprintf(buf, sizeof(buf), "%s", arg);
+    for(char *item = strtok(buf, ","); item != NULL; item = strtok(NULL, ",")){
+        if(n >= SWEEP_MAX_VALUES){
+            fprintf(stderr, "[ERROR HAPPENED] : At most %d %s, %s and later are left out\n", SWEEP_MAX_VALUES, what, item);
+            break;
+        }
+        values[n] = atoi(item);
+        if(values[n] <= 0){
+            fprintf(stderr, "[ERROR HAPPENED] : Invalid %s %s\n", what, item);
+            exit(1);
+        }
+        n++;
+    }
+    return n;
+}
+
+//Exponent of the step, NAN if either end is missing or not positive
+static double step_exponent(const SweepPoint *a, const SweepPoint *b, int metric, int x1, int x2){
+    if(!a->has_value || !b->has_value || a->values[metric] <= 0 || b->values[metric] <= 0 || x1 == x2){
+        return NAN;
+    }
+    return log(b->values[metric] / a->values[metric]) / log((double)x2 / x1);
+}
+
+static int is_superlinear(int metric, double exponent, double tolerance){
+    return !isnan(exponent) && exponent > (metrics[metric].kind == METRIC_TOTAL ? 1.0 : 0.0) + tolerance;
+}
+
+static void fill_point(SweepPoint *point, const CsvRow *header, const CsvRow *row){
+    int processes = (int)csv_value(row, csv_column(header, "processes"));
+    int keys = (int)csv_value(row, csv_column(header, "keys_per_process"));
+    point->has_value = 1;
+    for(int m = 0; m < NUM_METRICS; m++){
+        if(metrics[m].column != NULL){
+            point->values[m] = csv_value(row, csv_column(header, metrics[m].column));
+        } else{
+            point->values[m] = csv_value(row, csv_column(header, "summary_bytes")) / ((double)processes * keys);
+        }
+    }
+}
+
+int main(int argc, char *argv[]){
+    if(argc < 3){
+        fprintf(stderr, "Usage: %s <process counts> <keys per process> [scenario file], e.g. %s 2,4,8 100000,1000000\n",
+                argv[0], argv[0]);
+        exit(1);
+    }
+    int process_counts[SWEEP_MAX_VALUES], key_counts[SWEEP_MAX_VALUES];
+    int num_process_counts = parse_list(argv[1], process_counts, "process counts");
+    int num_key_counts = parse_list(argv[2], key_counts, "key counts");
+    const char *structures_env = getenv("SWEEP_STRUCTURES");
+    const char *csv_env = getenv("SWEEP_CSV");
+    const char *curves_env = getenv("SWEEP_CURVES");
+    const char *tolerance_env = getenv("SWEEP_TOLERANCE");
+    char structure_list[512];
+    snprintf(structure_list, sizeof(structure_list), "%s", structures_env != NULL ? structures_env : SWEEP_DEFAULT_STRUCTURES);
+    const char *csv = csv_env != NULL ? csv_env : SWEEP_DEFAULT_CSV;
+    const char *curves = curves_env != NULL ? curves_env : SWEEP_DEFAULT_CURVES;
+    double tolerance = tolerance_env != NULL ? atof(tolerance_env) : SWEEP_DEFAULT_TOLERANCE;
+    char *structures[SWEEP_MAX_STRUCTURES];
+    int num_structures = 0;
+    for(char *structure = strtok(structure_list, ","); structure != NULL; structure = strtok(NULL, ",")){
+        if(num_structures >= SWEEP_MAX_STRUCTURES){
+            fprintf(stderr, "[ERROR HAPPENED] : At most %d structures, %s is left out\n", SWEEP_MAX_STRUCTURES, structure);
+            break;
+        }
+        structures[num_structures++] = structure;
+    }
+    unlink(csv);
+
+    int num_points = num_structures * num_process_counts * num_key_counts;
+    int point = 0;
+    for(int s = 0; s < num_structures; s++){
+        for(int pi = 0; pi < num_process_counts; pi++){
+            for(int ki = 0; ki < num_key_counts; ki++){
+                char processes[16], keys[16], json[256], log[256];
+                snprintf(processes, sizeof(processes), "%d", process_counts[pi]);
+                snprintf(keys, sizeof(keys), "%d", key_counts[ki]);
+                snprintf(json, sizeof(json), "/tmp/sweep_%s_%s_%s.json", structures[s], processes, keys);
+                snprintf(log, sizeof(log), "/tmp/sweep_%s_%s_%s.log", structures[s], processes, keys);
+                char *manager_argv[] = {"./manager", structures[s], processes, keys, argc > 3 ? argv[3] : NULL, NULL};
+                struct timespec start, end;
+                printf("[%d/%d] %s, %s processes, %s keys each ... ", ++point, num_points, structures[s], processes, keys);
+                fflush(stdout);
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                int status = manager_run(manager_argv, csv, json, log);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                printf("%s in %.1f s\n", status == 0 ? "done" : "FAILED",
+                       (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+            }
+        }
+    }
+
+    static CsvRow header;
+    static CsvRow rows[SWEEP_MAX_RUNS];
+    int num_rows = csv_read(csv, &header, rows, SWEEP_MAX_RUNS);
+    if(num_rows < 0){
+        exit(1);
+    }
+    //A failed point has no row, so rows are matched by their configuration rather than their position
+    static SweepPoint points[SWEEP_MAX_STRUCTURES][SWEEP_MAX_VALUES][SWEEP_MAX_VALUES];
+    int structure_column = csv_column(&header, "structure");
+    int processes_column = csv_column(&header, "processes");
+    int keys_column = csv_column(&header, "keys_per_process");
+    for(int r = 0; r < num_rows; r++){
+        for(int s = 0; s < num_structures; s++){
+            if(structure_column < 0 || structure_column >= rows[r].num_fields
+               || strcmp(rows[r].fields[structure_column], structures[s]) != 0){
+                continue;
+            }
+            for(int pi = 0; pi < num_process_counts; pi++){
+                for(int ki = 0; ki < num_key_counts; ki++){
+                    if((int)csv_value(&rows[r], processes_column) == process_counts[pi]
+                       && (int)csv_value(&rows[r], keys_column) == key_counts[ki]){
+                        fill_point(&points[s][pi][ki], &header, &rows[r]);
+                    }
+                }
+            }
+        }
+    }
+
+    FILE *fp = fopen(curves, "w");
+    if(fp == NULL){
+        perror("[ERROR HAPPENED] : Could not write the scaling curves");
+    } else{
+        fprintf(fp, "structure,metric,axis,fixed,from,to,value_from,value_to,exponent,superlinear\n");
+    }
+    int num_superlinear = 0;
+    for(int s = 0; s < num_structures; s++){
+        for(int m = 0; m < NUM_METRICS; m++){
+            printf("\n%s %s (%s), rows: processes, columns: keys per process, ! = superlinear step from the left or above\n",
+                   structures[s], metrics[m].name, metrics[m].kind == METRIC_TOTAL ? "linear expected" : "flat expected");
+            printf("%10s", "");
+            for(int ki = 0; ki < num_key_counts; ki++){
+                printf(" %14d", key_counts[ki]);
+            }
+            printf("\n");
+            for(int pi = 0; pi < num_process_counts; pi++){
+                printf("%10d", process_counts[pi]);
+                for(int ki = 0; ki < num_key_counts; ki++){
+                    const SweepPoint *here = &points[s][pi][ki];
+                    int marked = 0;
+                    //Along the keys, at a fixed process count
+                    if(ki > 0){
+                        const SweepPoint *left = &points[s][pi][ki - 1];
+                        double exponent = step_exponent(left, here, m, key_counts[ki - 1], key_counts[ki]);
+                        marked |= is_superlinear(m, exponent, tolerance);
+                        if(fp != NULL && !isnan(exponent)){
+                            fprintf(fp, "%s,%s,keys_per_process,%d,%d,%d,%.6g,%.6g,%.3f,%d\n", structures[s], metrics[m].name,
+                                    process_counts[pi], key_counts[ki - 1], key_counts[ki], left->values[m], here->values[m],
+                                    exponent, is_superlinear(m, exponent, tolerance));
+                        }
+                    }
+                    //Along the processes, at a fixed key count
+                    if(pi > 0){
+                        const SweepPoint *above = &points[s][pi - 1][ki];
+                        double exponent = step_exponent(above, here, m, process_counts[pi - 1], process_counts[pi]);
+                        marked |= is_superlinear(m, exponent, tolerance);
+                        if(fp != NULL && !isnan(exponent)){
+                            fprintf(fp, "%s,%s,processes,%d,%d,%d,%.6g,%.6g,%.3f,%d\n", structures[s], metrics[m].name,
+                                    key_counts[ki], process_counts[pi - 1], process_counts[pi], above->values[m],
+                                    here->values[m], exponent, is_superlinear(m, exponent, tolerance));
+                        }
+                    }
+                    if(here->has_value){
+                        printf(" %13.4g%c", here->values[m], marked ? '!' : ' ');
+                    } else{
+                        printf(" %14s", "-");
+                    }
+                    num_superlinear += marked;
+                }
+                printf("\n");
+            }
+        }
+    }
+    if(fp != NULL){
+        fclose(fp);
+    }
+    printf("\n%d of %d table cells (points times metrics) marked superlinear\n", num_superlinear, num_points * NUM_METRICS);
+    printf("Rows in %s, steps with their exponents in %s, records in /tmp/sweep_<structure>_<processes>_<keys>.json\n",
+           csv, curves);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#!/bin/sh
+#Several query phases, each with its own load generator clients under the same ids (see loadgen_start)
+#A client that leaves has to hand back what it owes the processes (credits, connections, shm regions), otherwise the
+#answers to the next phase's clients get stuck and their queries time out
+#Usage: tests/multi_client_phases.sh [transport...], from src/ after make; defaults to every transport
+
+cd "$(dirname "$0")/.." || exit 1
+PHASES=6
+TRANSPORTS=${*:-"unix shm tcp uring thread"}
+SCENARIO=$(mktemp /tmp/multi_client_phases.XXXXXX)
+trap 'rm -f "$SCENARIO" "$SCENARIO.log"' EXIT
+
+i=0
+while [ $i -lt $PHASES ]; do
+    echo "queries 1001" >> "$SCENARIO"
+    i=$((i + 1))
+done
+
+failed=0
+for transport in $TRANSPORTS; do
+    for mode in closed open; do
+        IPC_TRANSPORT=$transport KEYGEN_SEED=1 LOADGEN_MODE=$mode LOADGEN_CLIENTS=2 LOADGEN_QPS=20000 \
+            timeout 120 ./manager bloom 3 2000 "$SCENARIO" > "$SCENARIO.log" 2>&1
+        status=$?
+        phases=$(grep -c "^Queries timed out:" "$SCENARIO.log")
+        timed_out=$(grep "^Queries timed out:" "$SCENARIO.log" | awk '{sum += $4} END {print sum + 0}')
+        if [ $status -ne 0 ] || [ "$phases" -ne $PHASES ] || [ "$timed_out" -ne 0 ]; then
+            echo "FAIL $transport $mode: exit $status, $phases/$PHASES phases, $timed_out queries timed out"
+            failed=1
+        else
+            echo "ok   $transport $mode"
+        fi
+    done
+done
+exit $failed
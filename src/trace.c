@@ -0,0 +1,275 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "IPC.h"
+#include "trace.h"
+
+static uint64_t now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void trace_config_from_env(TraceConfig *config){
+    const char *speed = getenv("TRACE_SPEED");
+    const char *batch = getenv("TRACE_UPDATE_BATCH");
+    config->speed = speed != NULL && atof(speed) >= 0 ? atof(speed) : TRACE_DEFAULT_SPEED;
+    config->update_batch = batch != NULL && atoi(batch) > 0 ? atoi(batch) : TRACE_DEFAULT_UPDATE_BATCH;
+}
+
+//Maps the trace and checks its header, returns -1 (and says why) if it can't be replayed
+int trace_open(Trace *trace, const char *path){
+    memset(trace, 0, sizeof(*trace));
+    trace->path = path;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        perror("[ERROR HAPPENED] : Could not open the trace");
+        return -1;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(TraceHeader)){
+        fprintf(stderr, "[ERROR HAPPENED] : Trace %s is shorter than its header\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        perror("[ERROR HAPPENED] : Could not map the trace");
+        return -1;
+    }
+    const TraceHeader *header = map;
+    if(memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 || header->record_size < sizeof(TraceRecord)){
+        fprintf(stderr, "[ERROR HAPPENED] : %s is not a trace (magic %s, records of %u bytes)\n", path, TRACE_MAGIC,
+                (unsigned)sizeof(TraceRecord));
+        munmap(map, st.st_size);
+        return -1;
+    }
+    uint64_t available = (st.st_size - sizeof(TraceHeader)) / header->record_size;
+    trace->map = map;
+    trace->map_size = st.st_size;
+    trace->records = (const char *)map + sizeof(TraceHeader);
+    trace->record_size = header->record_size;
+    trace->num_records = header->num_records;
+    if(available < trace->num_records){
+        fprintf(stderr, "[ERROR HAPPENED] : Trace %s is cut off, replaying %llu of %llu records\n", path,
+                (unsigned long long)available, (unsigned long long)trace->num_records);
+        trace->num_records = available;
+    }
+    //Read once front to back: the kernel can read ahead and drop what was replayed
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void trace_close(Trace *trace){
+    if(trace->map != NULL){
+        munmap(trace->map, trace->map_size);
+        trace->map = NULL;
+    }
+}
+
+static const TraceRecord *record_at(const Trace *trace, uint64_t i){
+    return (const TraceRecord *)(trace->records + i * trace->record_size);
+}
+
+//Where the loadgen callbacks are in the trace, they take no arguments
+static struct{
+    const Trace *trace;
+    uint64_t cursor;            //next record to look at
+    uint64_t end;               //end of the current segment
+    uint64_t last_ns;           //timestamp of the get sent last
+    double speed;
+    int num_processes;
+} replay;
+
+static LoadgenQueryKind pick_trace_get(int *key, int *target_process){
+    const TraceRecord *record = record_at(replay.trace, replay.cursor++);
+    while(record->op != TRACE_GET){
+        record = record_at(replay.trace, replay.cursor++);
+    }
+    *key = record->key;
+    *target_process = record->node % replay.num_processes;
+    replay.last_ns = record->timestamp_ns;
+    //The node a get came in at is its local cache, whether or not it holds the key
+    return LOADGEN_QUERY_LOCAL;
+}
+
+static uint64_t next_trace_gap(){
+    for(uint64_t i = replay.cursor; i < replay.end; i++){
+        const TraceRecord *record = record_at(replay.trace, i);
+        if(record->op == TRACE_GET){
+            if(replay.speed <= 0 || record->timestamp_ns <= replay.last_ns){
+                return 0;
+            }
+            return (uint64_t)((record->timestamp_ns - replay.last_ns) / replay.speed);
+        }
+    }
+    return 0;
+}
+
+//Records from `from` up to the one that fills the update batch (or the end), returns the end of the segment
+static uint64_t scan_segment(const Trace *trace, uint64_t from, int update_batch, int *num_gets, int *num_updates,
+                             uint64_t *first_get_ns, TraceResult *result){
+    uint64_t i = from;
+    *num_gets = 0;
+    *num_updates = 0;
+    while(i < trace->num_records && *num_updates < update_batch){
+        const TraceRecord *record = record_at(trace, i++);
+        if(record->op >= TRACE_OPS){
+            continue;
+        }
+        result->num_by_op[record->op]++;
+        if(record->op != TRACE_GET){
+            (*num_updates)++;
+        } else if((*num_gets)++ == 0){
+            *first_get_ns = record->timestamp_ns;
+        }
+    }
+    return i;
+}
+
+//Hands the updates of [from, end) to the manager, a key segment per op grouped by node with a counting sort
+static void apply_updates(const Trace *trace, uint64_t from, uint64_t end, int num_processes, const TraceUpdater *updater){
+    int counts[TRACE_OPS][MAX_PROCESSES];
+    int *cursor[TRACE_OPS][MAX_PROCESSES];
+    KeySegment segments[TRACE_OPS];
+    memset(counts, 0, sizeof(counts));
+    for(uint64_t i = from; i < end; i++){
+        const TraceRecord *record = record_at(trace, i);
+        if(record->op == TRACE_INSERT || record->op == TRACE_DELETE){
+            counts[record->op][record->node % num_processes]++;
+        }
+    }
+    for(int op = TRACE_INSERT; op < TRACE_OPS; op++){
+        if(key_segment_create(&segments[op], "trace_updates", num_processes, counts[op]) < 0){
+            exit(1);
+        }
+        for(int p = 0; p < num_processes; p++){
+            cursor[op][p] = key_segment_owner_keys(&segments[op], p);
+        }
+    }
+    for(uint64_t i = from; i < end; i++){
+        const TraceRecord *record = record_at(trace, i);
+        if(record->op == TRACE_INSERT || record->op == TRACE_DELETE){
+            *cursor[record->op][record->node % num_processes]++ = record->key;
+        }
+    }
+
+    TraceOp order[] = {TRACE_DELETE, TRACE_INSERT};
+    for(int o = 0; o < 2; o++){
+        TraceOp op = order[o];
+        int total = 0;
+        for(int p = 0; p < num_processes; p++){
+            total += counts[op][p];
+        }
+        if(total > 0){
+            updater->apply(op, &segments[op]);
+        }
+    }
+    key_segment_destroy(&segments[TRACE_INSERT]);
+    key_segment_destroy(&segments[TRACE_DELETE]);
+}
+
+static void sleep_until(uint64_t deadline_ns){
+    uint64_t now;
+    while((now = now_ns()) < deadline_ns){
+        uint64_t wait_us = (deadline_ns - now) / 1000;
+        usleep(wait_us < 100000 ? (useconds_t)wait_us : 100000);
+    }
+}
+
+//Replays the whole trace: the gets between two update batches are one open loop run of loadgen (one client, the
+//records are read in order), the batch is applied after its gets were answered or timed out
+void trace_replay(const Trace *trace, const TraceConfig *config, const LoadgenConfig *loadgen, int fd, int sender_id,
+                  int num_processes, const TraceUpdater *updater, TraceResult *result){
+    static LoadgenResult segment;
+    LoadgenConfig segment_config = *loadgen;
+    segment_config.mode = LOADGEN_OPEN;
+    segment_config.clients = 1;
+    segment_config.next_gap = next_trace_gap;
+
+    memset(result, 0, sizeof(*result));
+    histogram_init(&result->queries.latency);
+    histogram_init(&result->queries.service);
+    result->queries.num_clients = 1;
+    result->num_records = trace->num_records;
+
+    replay.trace = trace;
+    replay.speed = config->speed;
+    replay.num_processes = num_processes;
+
+    uint64_t start = now_ns();
+    uint64_t wall_origin = start;
+    uint64_t trace_origin = trace->num_records > 0 ? record_at(trace, 0)->timestamp_ns : 0;
+    uint32_t next_request_id = loadgen->first_request_id;
+    uint64_t from = 0;
+    while(from < trace->num_records){
+        int num_gets, num_updates;
+        uint64_t first_get_ns = 0;
+        uint64_t end = scan_segment(trace, from, config->update_batch, &num_gets, &num_updates, &first_get_ns, result);
+
+        if(num_gets > 0){
+            if(config->speed > 0 && first_get_ns > trace_origin){
+                sleep_until(wall_origin + (uint64_t)((first_get_ns - trace_origin) / config->speed));
+            }
+            replay.cursor = from;
+            replay.end = end;
+            segment_config.first_request_id = next_request_id;
+            loadgen_run(&segment_config, fd, sender_id, num_gets, pick_trace_get, &segment);
+            next_request_id += num_gets;
+            //The segments run one after another: their times add up and the peak is the largest one
+            double duration_ms = result->queries.duration_ms + segment.duration_ms;
+            double send_duration_ms = result->queries.send_duration_ms + segment.send_duration_ms;
+            int max_outstanding = result->queries.max_outstanding;
+            loadgen_merge(&result->queries, &segment);
+            result->queries.duration_ms = duration_ms;
+            result->queries.send_duration_ms = send_duration_ms;
+            result->queries.max_outstanding = max_outstanding > segment.max_outstanding ? max_outstanding : segment.max_outstanding;
+        }
+
+        if(num_updates > 0 && updater == NULL){
+            result->num_skipped += num_updates;
+        } else if(num_updates > 0){
+            uint64_t update_start = now_ns();
+            apply_updates(trace, from, end, num_processes, updater);
+            uint64_t pause = now_ns() - update_start;
+            result->update_ms += pause / 1000000.0;
+            result->num_batches++;
+            wall_origin += pause;
+        }
+        from = end;
+    }
+    result->replay_ms = (now_ns() - start) / 1000000.0;
+    result->queries.clients[0].sent = result->queries.sent;
+    result->queries.clients[0].answered = result->queries.found + result->queries.not_found;
+    result->queries.clients[0].timed_out = result->queries.timed_out;
+    result->queries.clients[0].duration_ms = result->queries.duration_ms;
+    result->queries.clients[0].p99_ns = histogram_percentile(&result->queries.latency, 99.0);
+}
+
+void trace_print(FILE *fp, const TraceConfig *config, const LoadgenConfig *loadgen, const TraceResult *result){
+    LoadgenConfig replay_config = *loadgen;
+    replay_config.mode = LOADGEN_OPEN;
+    replay_config.next_gap = next_trace_gap;
+    fprintf(fp, "Trace: %llu records (%llu gets, %llu inserts, %llu deletes), ", (unsigned long long)result->num_records,
+            (unsigned long long)result->num_by_op[TRACE_GET], (unsigned long long)result->num_by_op[TRACE_INSERT],
+            (unsigned long long)result->num_by_op[TRACE_DELETE]);
+    if(config->speed > 0){
+        fprintf(fp, "replayed at %.2fx in %.1f ms\n", config->speed, result->replay_ms);
+    } else{
+        fprintf(fp, "replayed as fast as possible in %.1f ms\n", result->replay_ms);
+    }
+    fprintf(fp, "Update batches: %d of up to %d updates, %.1f ms applying them", result->num_batches, config->update_batch,
+            result->update_ms);
+    if(result->num_skipped > 0){
+        fprintf(fp, ", %llu updates skipped (no update path)", (unsigned long long)result->num_skipped);
+    }
+    fprintf(fp, "\n");
+    loadgen_print(fp, &replay_config, &result->queries);
+}
@@ -0,0 +1,84 @@
+#ifndef TRACE_H
+
+#define TRACE_H
+#include <stdio.h>
+#include <stdint.h>
+#include "loadgen.h"
+#include "key_segment.h"
+
+//Trace replay, selected with TRACE_FILE: the query phase replays a recorded request log instead of the synthetic mix
+//The file is a TraceHeader followed by num_records TraceRecords (little endian, trace_convert writes it from text)
+//It is mmapped read only and streamed front to back, so a trace does not have to fit in memory
+//Gets are sent to the node the record names (node % num_processes) through the open loop of loadgen.h, at the gaps
+//between their timestamps divided by TRACE_SPEED (default 1, the original timing; 0 replays as fast as the fleet answers)
+//Inserts and deletes are collected and, every TRACE_UPDATE_BATCH (default 10000) of them, applied through the same
+//messages as the insert and delete phases: the replay waits for the gets sent so far, hands the batch to the manager
+//and waits at the MSG_BUILT barrier, the summaries are rebuilt per batch and not per key. The replay clock stops while
+//a batch is applied, so the gets after it keep their gaps and the rebuild is reported on its own
+//Within a batch the deletes are applied before the inserts
+
+#define TRACE_MAGIC "DCTRACE1"
+#define TRACE_VERSION 1
+#define TRACE_DEFAULT_SPEED 1.0
+#define TRACE_DEFAULT_UPDATE_BATCH 10000
+
+typedef enum{
+    TRACE_GET = 0,
+    TRACE_INSERT,
+    TRACE_DELETE,
+    TRACE_OPS
+} TraceOp;
+
+typedef struct{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;       //sizeof(TraceRecord), larger records of a later version are read by their prefix
+    uint64_t num_records;
+} TraceHeader;
+
+typedef struct{
+    uint64_t timestamp_ns;      //non decreasing, only the differences count
+    int32_t key;
+    uint16_t node;              //the client node the request came in at
+    uint8_t op;                 //TraceOp
+    uint8_t reserved;
+} TraceRecord;
+
+typedef struct{
+    const char *path;
+    void *map;
+    size_t map_size;
+    const char *records;
+    uint32_t record_size;
+    uint64_t num_records;
+} Trace;
+
+typedef struct{
+    double speed;
+    int update_batch;
+} TraceConfig;
+
+//How a manager applies a batch: apply once per op that had keys, with the keys of every node in one key segment
+//(key_segment.h), it returns once the processes applied them. A NULL updater skips the updates (and counts them)
+typedef struct{
+    void (*apply)(TraceOp op, KeySegment *keys);
+} TraceUpdater;
+
+typedef struct{
+    uint64_t num_records;
+    uint64_t num_by_op[TRACE_OPS];
+    uint64_t num_skipped;       //updates without an updater
+    int num_batches;
+    double update_ms;           //time spent applying batches
+    double replay_ms;
+    LoadgenResult queries;
+} TraceResult;
+
+void trace_config_from_env(TraceConfig *config);
+int trace_open(Trace *trace, const char *path);
+void trace_close(Trace *trace);
+void trace_replay(const Trace *trace, const TraceConfig *config, const LoadgenConfig *loadgen, int fd, int sender_id,
+                  int num_processes, const TraceUpdater *updater, TraceResult *result);
+void trace_print(FILE *fp, const TraceConfig *config, const LoadgenConfig *loadgen, const TraceResult *result);
+
+#endif
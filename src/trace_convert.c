@@ -0,0 +1,86 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+//Writes a binary trace (trace.h) from a text log with one request per line:
+//<timestamp in microseconds> <get|insert|delete> <key> <node>
+//Empty lines and lines starting with # are skipped, timestamps that go backwards are clamped to the one before
+//Usage: ./trace_convert <text log> <trace file>   ("-" reads the log from stdin)
+
+static int parse_op(const char *op){
+    if(strcmp(op, "get") == 0 || strcmp(op, "g") == 0) return TRACE_GET;
+    if(strcmp(op, "insert") == 0 || strcmp(op, "i") == 0) return TRACE_INSERT;
+    if(strcmp(op, "delete") == 0 || strcmp(op, "d") == 0) return TRACE_DELETE;
+    return -1;
+}
+
+int main(int argc, char *argv[]){
+    if(argc < 3){
+        fprintf(stderr, "Usage: %s <text log> <trace file>\n", argv[0]);
+        exit(1);
+    }
+    FILE *in = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "r");
+    if(in == NULL){
+        perror("[ERROR HAPPENED] : Could not open the log");
+        exit(1);
+    }
+    FILE *out = fopen(argv[2], "wb");
+    if(out == NULL){
+        perror("[ERROR HAPPENED] : Could not create the trace");
+        exit(1);
+    }
+
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    fwrite(&header, sizeof(header), 1, out);
+
+    char line[256];
+    uint64_t line_number = 0;
+    uint64_t last_ns = 0;
+    uint64_t skipped = 0;
+    while(fgets(line, sizeof(line), in) != NULL){
+        line_number++;
+        unsigned long long timestamp_us;
+        char op[16];
+        int key, node;
+        if(line[0] == '#' || line[0] == '\n'){
+            continue;
+        }
+        if(sscanf(line, "%llu %15s %d %d", &timestamp_us, op, &key, &node) != 4 || parse_op(op) < 0 || node < 0 || node > UINT16_MAX){
+            fprintf(stderr, "[ERROR HAPPENED] : Skipping line %llu: %s", (unsigned long long)line_number, line);
+            skipped++;
+            continue;
+        }
+        TraceRecord record;
+        memset(&record, 0, sizeof(record));
+        record.timestamp_ns = (uint64_t)timestamp_us * 1000;
+        if(record.timestamp_ns < last_ns){
+            record.timestamp_ns = last_ns;
+        }
+        last_ns = record.timestamp_ns;
+        record.key = key;
+        record.node = (uint16_t)node;
+        record.op = (uint8_t)parse_op(op);
+        fwrite(&record, sizeof(record), 1, out);
+        header.num_records++;
+    }
+
+    //The record count goes in last, a trace cut off while writing is read up to its last whole record
+    fseek(out, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, out);
+    if(fclose(out) != 0){
+        perror("[ERROR HAPPENED] : Could not write the trace");
+        exit(1);
+    }
+    if(in != stdin){
+        fclose(in);
+    }
+    printf("Wrote %llu records to %s (%llu lines skipped)\n", (unsigned long long)header.num_records, argv[2],
+           (unsigned long long)skipped);
+    return 0;
+}
@@ -0,0 +1,140 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "workload.h"
+
+static uint64_t now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double env_double(const char *name, double fallback){
+    const char *env = getenv(name);
+    return env != NULL && atof(env) > 0 ? atof(env) : fallback;
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b){
+    while(b != 0){
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+//splitmix64, a thread that was never seeded starts like one seeded with 1 (as rand() without srand)
+static __thread uint64_t rng_state = 1;
+
+void workload_seed(uint64_t seed){
+    rng_state = seed;
+}
+
+int workload_rand(){
+    uint64_t z = (rng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return (int)((z >> 33) & RAND_MAX);
+}
+
+long workload_random(void){
+    return workload_rand();
+}
+
+//Uniform in [0, n), with two workload_rand() calls once n is past RAND_MAX
+static uint64_t uniform_below(uint64_t n){
+    uint64_t r = (uint64_t)workload_rand();
+    if(n > (uint64_t)RAND_MAX){
+        r = r * ((uint64_t)RAND_MAX + 1) + (uint64_t)workload_rand();
+    }
+    return r % n;
+}
+
+void workload_init(Workload *w, uint64_t num_keys){
+    const char *dist = getenv("WORKLOAD_DIST");
+    memset(w, 0, sizeof(*w));
+    w->dist = WORKLOAD_UNIFORM;
+    if(dist != NULL && strcmp(dist, "zipf") == 0){
+        w->dist = WORKLOAD_ZIPF;
+    } else if(dist != NULL && strcmp(dist, "hotspot") == 0){
+        w->dist = WORKLOAD_HOTSPOT;
+    } else if(dist != NULL && strcmp(dist, "uniform") != 0){
+        fprintf(stderr, "[ERROR HAPPENED] : unknown WORKLOAD_DIST %s, using uniform\n", dist);
+    }
+    w->zipf_s = env_double("WORKLOAD_ZIPF_S", WORKLOAD_DEFAULT_ZIPF_S);
+    w->hot_fraction = env_double("WORKLOAD_HOT_FRACTION", WORKLOAD_DEFAULT_HOT_FRACTION);
+    w->hot_probability = env_double("WORKLOAD_HOT_PROBABILITY", WORKLOAD_DEFAULT_HOT_PROBABILITY);
+    if(w->hot_fraction > 1) w->hot_fraction = 1;
+    if(w->hot_probability > 1) w->hot_probability = 1;
+    w->shift_ms = (int)env_double("WORKLOAD_SHIFT_MS", 0);
+    w->num_keys = num_keys > 0 ? num_keys : 1;
+    w->hot_keys = (uint64_t)(w->hot_fraction * w->num_keys);
+    if(w->hot_keys < 1) w->hot_keys = 1;
+
+    //Golden ratio stride: neighbouring ranks land far apart, and so on different processes
+    w->stride = ((uint64_t)(w->num_keys * 0.6180339887) | 1);
+    while(gcd(w->stride, w->num_keys) != 1){
+        w->stride += 2;
+    }
+    w->stride %= w->num_keys;
+    if(w->stride == 0) w->stride = 1;
+
+    if(w->dist == WORKLOAD_ZIPF){
+        w->zipf = create_zipfian(w->zipf_s, (long)w->num_keys, workload_random);
+    }
+    w->start_ns = now_ns();
+}
+
+//Index into the key table of the next query that should hit
+uint64_t workload_pick(const Workload *w){
+    uint64_t rank;
+    switch(w->dist){
+        case WORKLOAD_ZIPF:
+            rank = (uint64_t)zipfian_gen(w->zipf);
+            break;
+        case WORKLOAD_HOTSPOT:
+            if(w->hot_keys >= w->num_keys || workload_rand() < w->hot_probability * ((double)RAND_MAX + 1)){
+                rank = uniform_below(w->hot_keys < w->num_keys ? w->hot_keys : w->num_keys);
+            } else{
+                rank = w->hot_keys + uniform_below(w->num_keys - w->hot_keys);
+            }
+            break;
+        default:
+            return (uint64_t)workload_rand() % w->num_keys;
+    }
+    uint64_t offset = 0;
+    if(w->shift_ms > 0){
+        uint64_t epoch = (now_ns() - w->start_ns) / ((uint64_t)w->shift_ms * 1000000ULL);
+        offset = epoch * w->hot_keys % w->num_keys;
+    }
+    return (unsigned __int128)((rank + offset) % w->num_keys) * w->stride % w->num_keys;
+}
+
+void workload_print(FILE *fp, const Workload *w){
+    switch(w->dist){
+        case WORKLOAD_ZIPF:
+            fprintf(fp, "Workload: zipf, s = %.2f over %llu keys", w->zipf_s, (unsigned long long)w->num_keys);
+            break;
+        case WORKLOAD_HOTSPOT:
+            fprintf(fp, "Workload: hotspot, %.0f%% of the hits on %llu of %llu keys", w->hot_probability * 100,
+                    (unsigned long long)w->hot_keys, (unsigned long long)w->num_keys);
+            break;
+        default:
+            fprintf(fp, "Workload: uniform over %llu keys\n", (unsigned long long)w->num_keys);
+            return;
+    }
+    if(w->shift_ms > 0){
+        fprintf(fp, ", hot set moves by %llu keys every %d ms", (unsigned long long)w->hot_keys, w->shift_ms);
+    }
+    fprintf(fp, "\n");
+}
+
+void workload_destroy(Workload *w){
+    if(w->zipf != NULL){
+        destroy_zipfian(w->zipf);
+        w->zipf = NULL;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef WORKLOAD_H
+
+#define WORKLOAD_H
+#include <stdio.h>
+#include <stdint.h>
+#include "../cqf/include/zipf.h"
+
+//Which of the existing keys a query that should hit asks for, selected with WORKLOAD_DIST:
+//uniform (default): every key alike, workload_rand() % num_keys
+//zipf: key of rank k with probability ~ 1/k^WORKLOAD_ZIPF_S (default 0.99), drawn with the generator of cqf/src/zipf.c
+//hotspot: WORKLOAD_HOT_PROBABILITY (default 0.9) of the queries go to a hot set of WORKLOAD_HOT_FRACTION (default 0.01)
+//of the keys, the rest to the other keys uniformly
+//Ranks are spread over the key table with a fixed stride, so the hot keys are scattered over all processes instead of
+//all belonging to process 0. With WORKLOAD_SHIFT_MS set the hot set moves on by its own size every that many
+//milliseconds: keys that were hot turn cold and the summaries and hash tables see a new working set
+
+#define WORKLOAD_DEFAULT_ZIPF_S 0.99
+#define WORKLOAD_DEFAULT_HOT_FRACTION 0.01
+#define WORKLOAD_DEFAULT_HOT_PROBABILITY 0.9
+
+typedef enum{
+    WORKLOAD_UNIFORM = 0,
+    WORKLOAD_ZIPF,
+    WORKLOAD_HOTSPOT
+} WorkloadDist;
+
+typedef struct{
+    WorkloadDist dist;
+    double zipf_s;
+    double hot_fraction;
+    double hot_probability;
+    int shift_ms;
+    uint64_t num_keys;
+    uint64_t hot_keys;          //size of the hot set, also the step of a shift
+    uint64_t stride;            //coprime with num_keys, so rank -> index is a permutation
+    uint64_t start_ns;
+    ZIPFIAN zipf;
+} Workload;
+
+//The query generators draw from a generator of their own thread instead of rand(): load generator clients that are
+//threads of the manager (IPC_TRANSPORT=thread) would otherwise race on its state and none of their runs would repeat
+//workload_rand is uniform in [0, RAND_MAX] like rand(), workload_random is the same for create_zipfian
+void workload_seed(uint64_t seed);
+int workload_rand();
+long workload_random(void);
+
+void workload_init(Workload *w, uint64_t num_keys);
+uint64_t workload_pick(const Workload *w);
+void workload_print(FILE *fp, const Workload *w);
+void workload_destroy(Workload *w);
+
+#endif